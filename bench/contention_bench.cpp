@@ -0,0 +1,372 @@
+/* write throughput of the trees shared between threads
+ *
+ * every thread churns the same prefilled tree: it inserts a fresh key and
+ * erases it again, so the size of the tree stays put; the keys of different
+ * threads never collide, so every run ends with the prefilled tree and the
+ * checksums can be cross-checked between the containers
+ *
+ * mutex (an rb_tree behind a std::mutex) is the baseline for combining
+ * (SEE: flat_combining_tree)
+ *
+ * the results are written as CSV (default) or JSON
+ *
+ * usage: contention_bench [--format=csv|json] [--output=FILE]
+ *                         [--threads=1,2,4,8,16,32,64] [--size=N]
+ *                         [--ops=N] [--repetitions=N]
+ *                         [--containers=mutex,combining] [--seed=N] */
+
+#include "flat_combining_tree.h"
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Key = std::uint64_t;
+
+struct Options {
+    std::string              format{"csv"};
+    std::string              output;
+    std::vector<std::size_t> threads{1, 2, 4, 8, 16, 32, 64};
+    std::size_t              size{100000};
+    std::size_t              ops{100000}; // per thread
+    std::size_t              repetitions{1};
+    std::uint64_t            seed{42};
+    std::vector<std::string> containers{"mutex", "combining"};
+};
+
+struct Result {
+    std::string   container;
+    std::size_t   threads;
+    std::size_t   ops;
+    double        ns_total;
+    std::uint64_t checksum;
+};
+
+// the low 16 bits tell the threads' keys apart; the prefilled ones have all
+// of them set
+constexpr Key make_key(std::uint64_t random, std::size_t tag) noexcept
+{
+    return random << 16 | tag;
+}
+
+constexpr std::size_t prefill_tag{0xffff};
+
+class Timer
+{
+  public:
+    Timer()
+        : start_{Clock::now()}
+    {
+    }
+
+    [[nodiscard]] double elapsed_ns() const
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start_)
+            .count();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start_;
+};
+
+// the baseline: every update takes the lock
+class MutexTree
+{
+  public:
+    class writer
+    {
+      public:
+        explicit writer(MutexTree& tree)
+            : tree_{&tree}
+        {
+        }
+
+        void insert(Key key)
+        {
+            std::lock_guard<std::mutex> lock{tree_->mutex_};
+            tree_->tree_.insert(key);
+        }
+
+        std::size_t erase(Key key)
+        {
+            std::lock_guard<std::mutex> lock{tree_->mutex_};
+
+            auto [it, last] = tree_->tree_.equal_range(key);
+
+            std::size_t erased = 0;
+            for (; it != last; ++erased) it = tree_->tree_.erase(it);
+            return erased;
+        }
+
+      private:
+        MutexTree* tree_;
+    };
+
+    writer make_writer() { return writer{*this}; }
+
+    template <typename Visitor>
+    decltype(auto) read(Visitor&& visit) const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return std::forward<Visitor>(visit)(tree_);
+    }
+
+    template <typename Update>
+    void update(Update&& update)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::forward<Update>(update)(tree_);
+    }
+
+  private:
+    rb_tree<Key>       tree_;
+    mutable std::mutex mutex_;
+};
+
+using CombiningTree = flat_combining_tree<Key>;
+
+template <typename Tree>
+Result run_once(const std::string& name,
+                std::size_t        threads,
+                const Options&     opts)
+{
+    Tree tree;
+
+    std::vector<Key> prefill;
+    prefill.reserve(opts.size);
+
+    std::mt19937_64 gen{opts.seed};
+    for (std::size_t i = 0; i < opts.size; ++i) {
+        prefill.push_back(make_key(gen() >> 16, prefill_tag));
+    }
+    std::sort(prefill.begin(), prefill.end());
+
+    tree.update([&prefill](auto& t) {
+        t.assign_sorted(prefill.begin(), prefill.end());
+    });
+
+    std::atomic<bool>          go{false};
+    std::atomic<std::uint64_t> erased{0};
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&tree, &go, &erased, &opts, t] {
+            auto            writer = tree.make_writer();
+            std::mt19937_64 gen{opts.seed + 1 + t};
+
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            std::uint64_t n = 0;
+            for (std::size_t i = 0; i < opts.ops; i += 2) {
+                Key key = make_key(gen() >> 16, t);
+                writer.insert(key);
+                if (i + 1 < opts.ops) n += writer.erase(key);
+            }
+
+            erased.fetch_add(n, std::memory_order_relaxed);
+        });
+    }
+
+    Timer timer;
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) worker.join();
+    double ns = timer.elapsed_ns();
+
+    // the prefilled keys plus whatever an odd ops left behind
+    std::uint64_t checksum = erased.load(std::memory_order_relaxed);
+    tree.read([&checksum](const auto& t) {
+        for (Key key : t) checksum += key;
+    });
+
+    return {name, threads, threads * opts.ops, ns, checksum};
+}
+
+template <typename Tree>
+Result run(const std::string& name, std::size_t threads, const Options& opts)
+{
+    Result best = run_once<Tree>(name, threads, opts);
+
+    for (std::size_t rep = 1; rep < opts.repetitions; ++rep) {
+        Result again  = run_once<Tree>(name, threads, opts);
+        best.ns_total = std::min(best.ns_total, again.ns_total);
+    }
+
+    return best;
+}
+
+double ops_per_second(const Result& r)
+{
+    if (r.ns_total == 0.0) return 0.0;
+    return static_cast<double>(r.ops) * 1e9 / r.ns_total;
+}
+
+void write_csv(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "container,threads,ops,ns_total,ops_per_sec,checksum\n";
+    for (const auto& r : results) {
+        os << r.container << ',' << r.threads << ',' << r.ops << ','
+           << r.ns_total << ',' << ops_per_second(r) << ',' << r.checksum
+           << '\n';
+    }
+}
+
+void write_json(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "  {\"container\": \"" << r.container << "\", "
+           << "\"threads\": " << r.threads << ", "
+           << "\"ops\": " << r.ops << ", "
+           << "\"ns_total\": " << r.ns_total << ", "
+           << "\"ops_per_sec\": " << ops_per_second(r) << ", "
+           << "\"checksum\": " << r.checksum << "}"
+           << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "]\n";
+}
+
+std::vector<std::string> split(std::string_view list)
+{
+    std::vector<std::string> items;
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        items.emplace_back(list.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+[[noreturn]] void usage(const char* prog)
+{
+    std::cerr << "usage: " << prog
+              << " [--format=csv|json] [--output=FILE]"
+                 " [--threads=1,2,4,8,16,32,64] [--size=N]"
+                 " [--ops=N] [--repetitions=N]"
+                 " [--containers=mutex,combining] [--seed=N]\n";
+    std::exit(2);
+}
+
+Options parse(int argc, char** argv)
+{
+    Options opts;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        auto             eq = arg.find('=');
+        if (arg.substr(0, 2) != "--" || eq == std::string_view::npos) {
+            usage(argv[0]);
+        }
+
+        std::string_view key   = arg.substr(2, eq - 2);
+        std::string      value{arg.substr(eq + 1)};
+
+        if (key == "format" && (value == "csv" || value == "json")) {
+            opts.format = value;
+        } else if (key == "output") {
+            opts.output = value;
+        } else if (key == "threads") {
+            opts.threads.clear();
+            for (const auto& n : split(value)) {
+                std::size_t threads = std::stoull(n);
+                // the threads' keys are tagged with their index
+                if (threads == 0 || threads > prefill_tag) usage(argv[0]);
+                opts.threads.push_back(threads);
+            }
+        } else if (key == "size") {
+            opts.size = std::stoull(value);
+        } else if (key == "ops") {
+            opts.ops = std::stoull(value);
+        } else if (key == "repetitions") {
+            opts.repetitions = std::max<std::size_t>(1, std::stoull(value));
+        } else if (key == "seed") {
+            opts.seed = std::stoull(value);
+        } else if (key == "containers") {
+            opts.containers = split(value);
+            for (const auto& name : opts.containers) {
+                if (name != "mutex" && name != "combining") usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    return opts;
+}
+
+// the checksums of every container must agree for the same thread count
+bool cross_check(const std::vector<Result>& results)
+{
+    std::map<std::size_t, std::pair<std::string, std::uint64_t>> expected;
+
+    bool ok = true;
+    for (const auto& r : results) {
+        auto [it, fresh] =
+            expected.try_emplace(r.threads, r.container, r.checksum);
+        if (!fresh && it->second.second != r.checksum) {
+            std::cerr << "checksum mismatch: " << r.container << " vs "
+                      << it->second.first << " on " << r.threads
+                      << " threads\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts = parse(argc, argv);
+
+    std::vector<Result> results;
+
+    for (std::size_t threads : opts.threads) {
+        for (const auto& name : opts.containers) {
+            std::cerr << name << ' ' << threads << '\n';
+
+            if (name == "mutex") {
+                results.push_back(run<MutexTree>(name, threads, opts));
+            } else if (name == "combining") {
+                results.push_back(run<CombiningTree>(name, threads, opts));
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!opts.output.empty()) file.open(opts.output);
+    std::ostream& os = opts.output.empty() ? std::cout : file;
+
+    if (opts.format == "json") {
+        write_json(os, results);
+    } else {
+        write_csv(os, results);
+    }
+
+    return cross_check(results) ? 0 : 1;
+}
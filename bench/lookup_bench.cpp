@@ -0,0 +1,414 @@
+/* lookup throughput of the trees that are built once and then only read
+ *
+ * every container is built from the same random keys and then probed with
+ * find and lower_bound (half of the probes miss) and iterated over; the scan
+ * rows walk the elements with a cursor where the container has one (SEE:
+ * bst::scan), in full and in runs of range_length from lower_bound; rb_tree
+ * (the pointer tree frozen_tree is built from) is the baseline, b_tree is its
+ * counterpart with many elements per node, and std::multiset is there for
+ * reference
+ *
+ * the results are written as CSV (default) or JSON; each row carries a
+ * checksum which is cross-checked between the containers
+ *
+ * usage: lookup_bench [--format=csv|json] [--output=FILE]
+ *                     [--min-size=N] [--max-size=N] [--queries=N]
+ *                     [--repetitions=N]
+ *                     [--containers=rb_tree,frozen,b_tree,multiset]
+ *                     [--seed=N] */
+
+#include "b_tree.h"
+#include "frozen_tree.h"
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Key = std::uint64_t;
+
+// the elements every range scan visits (if there are that many)
+constexpr std::size_t range_length{64};
+
+struct Options {
+    std::string              format{"csv"};
+    std::string              output;
+    std::size_t              min_size{1000};
+    std::size_t              max_size{10000000};
+    std::size_t              queries{1000000};
+    std::size_t              repetitions{1};
+    std::uint64_t            seed{42};
+    std::vector<std::string> containers{"rb_tree",
+                                        "frozen",
+                                        "b_tree",
+                                        "multiset"};
+};
+
+struct Result {
+    std::string   container;
+    std::size_t   size;
+    std::string   operation;
+    double        ns_total;
+    std::size_t   ops;
+    std::uint64_t checksum;
+};
+
+class Timer
+{
+  public:
+    Timer()
+        : start_{Clock::now()}
+    {
+    }
+
+    [[nodiscard]] double elapsed_ns() const
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start_)
+            .count();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start_;
+};
+
+// the containers are built from a sorted vector; the build row of frozen
+// includes building the rb_tree it is frozen from
+template <typename Tree>
+struct Builder {
+    static Tree build(const std::vector<Key>& sorted)
+    {
+        Tree tree;
+        tree.assign_sorted(sorted.begin(), sorted.end());
+        return tree;
+    }
+};
+
+template <>
+struct Builder<frozen_tree<Key>> {
+    static frozen_tree<Key> build(const std::vector<Key>& sorted)
+    {
+        return frozen_tree<Key>{Builder<rb_tree<Key>>::build(sorted)};
+    }
+};
+
+template <>
+struct Builder<std::multiset<Key>> {
+    // the range constructor is linear for sorted input
+    static std::multiset<Key> build(const std::vector<Key>& sorted)
+    {
+        return std::multiset<Key>(sorted.begin(), sorted.end());
+    }
+};
+
+// the keys are even; so the odd probes miss
+std::vector<Key> make_keys(std::size_t n, std::uint64_t seed)
+{
+    std::mt19937_64  gen{seed};
+    std::vector<Key> keys;
+    keys.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) keys.push_back(gen() << 1);
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+std::vector<Key> make_queries(const std::vector<Key>& keys,
+                              std::size_t             n,
+                              std::uint64_t           seed)
+{
+    std::mt19937_64  gen{seed};
+    std::vector<Key> queries;
+    queries.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        Key key = keys[gen() % keys.size()];
+        queries.push_back(i % 2 == 0 ? key : key + 1);
+    }
+    return queries;
+}
+
+template <typename Tree>
+void run_once(const std::string&      name,
+              const std::vector<Key>& sorted,
+              const std::vector<Key>& queries,
+              std::vector<Result>&    out)
+{
+    auto record = [&](std::string   operation,
+                      double        ns,
+                      std::size_t   ops,
+                      std::uint64_t checksum) {
+        out.push_back(
+            {name, sorted.size(), std::move(operation), ns, ops, checksum});
+    };
+
+    Tree tree = [&record, &sorted] {
+        Timer timer;
+        Tree  tree = Builder<Tree>::build(sorted);
+        record("build", timer.elapsed_ns(), sorted.size(), tree.size());
+        return tree;
+    }();
+
+    {
+        std::uint64_t acc{0};
+        Timer         timer;
+        for (Key key : queries) {
+            auto it = tree.find(key);
+            if (it != tree.end()) acc += *it;
+        }
+        record("find", timer.elapsed_ns(), queries.size(), acc);
+    }
+
+    {
+        std::uint64_t acc{0};
+        Timer         timer;
+        for (Key key : queries) {
+            auto it = tree.lower_bound(key);
+            if (it != tree.end()) acc += *it;
+        }
+        record("lower_bound", timer.elapsed_ns(), queries.size(), acc);
+    }
+
+    {
+        std::uint64_t acc{0};
+        Timer         timer;
+        for (Key key : tree) acc += key;
+        record("iterate", timer.elapsed_ns(), tree.size(), acc);
+    }
+
+    {
+        std::uint64_t acc{0};
+        Timer         timer;
+        if constexpr (requires { tree.scan(); }) {
+            for (auto it = tree.scan(); it; ++it) acc += *it;
+        } else {
+            for (Key key : tree) acc += key;
+        }
+        record("scan", timer.elapsed_ns(), tree.size(), acc);
+    }
+
+    {
+        std::uint64_t acc{0};
+        std::size_t   ops{0};
+        Timer         timer;
+        for (std::size_t i = 0; i < queries.size(); i += range_length) {
+            if constexpr (requires { tree.scan(tree.begin()); }) {
+                auto it = tree.scan(tree.lower_bound(queries[i]));
+                for (std::size_t k = 0; k < range_length && it; ++k, ++it) {
+                    acc += *it;
+                    ++ops;
+                }
+            } else {
+                auto it = tree.lower_bound(queries[i]);
+                for (std::size_t k = 0; k < range_length && it != tree.end();
+                     ++k, ++it) {
+                    acc += *it;
+                    ++ops;
+                }
+            }
+        }
+        record("range_scan", timer.elapsed_ns(), ops, acc);
+    }
+}
+
+template <typename Tree>
+void run(const std::string&      name,
+         const std::vector<Key>& sorted,
+         const std::vector<Key>& queries,
+         std::size_t             repetitions,
+         std::vector<Result>&    out)
+{
+    std::vector<Result> best;
+    run_once<Tree>(name, sorted, queries, best);
+
+    for (std::size_t rep = 1; rep < repetitions; ++rep) {
+        std::vector<Result> again;
+        run_once<Tree>(name, sorted, queries, again);
+        for (std::size_t i = 0; i < best.size(); ++i) {
+            best[i].ns_total = std::min(best[i].ns_total, again[i].ns_total);
+        }
+    }
+
+    for (auto& result : best) out.push_back(std::move(result));
+}
+
+double ns_per_op(const Result& r)
+{
+    if (r.ops == 0) return 0.0;
+    return r.ns_total / static_cast<double>(r.ops);
+}
+
+void write_csv(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "container,size,operation,ns_total,ns_per_op,checksum\n";
+    for (const auto& r : results) {
+        os << r.container << ',' << r.size << ',' << r.operation << ','
+           << r.ns_total << ',' << ns_per_op(r) << ',' << r.checksum << '\n';
+    }
+}
+
+void write_json(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "  {\"container\": \"" << r.container << "\", "
+           << "\"size\": " << r.size << ", "
+           << "\"operation\": \"" << r.operation << "\", "
+           << "\"ns_total\": " << r.ns_total << ", "
+           << "\"ns_per_op\": " << ns_per_op(r) << ", "
+           << "\"checksum\": " << r.checksum << "}"
+           << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "]\n";
+}
+
+std::vector<std::string> split(std::string_view list)
+{
+    std::vector<std::string> items;
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        items.emplace_back(list.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+[[noreturn]] void usage(const char* prog)
+{
+    std::cerr << "usage: " << prog
+              << " [--format=csv|json] [--output=FILE]"
+                 " [--min-size=N] [--max-size=N] [--queries=N]"
+                 " [--repetitions=N]"
+                 " [--containers=rb_tree,frozen,b_tree,multiset]"
+                 " [--seed=N]\n";
+    std::exit(2);
+}
+
+Options parse(int argc, char** argv)
+{
+    Options opts;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        auto             eq = arg.find('=');
+        if (arg.substr(0, 2) != "--" || eq == std::string_view::npos) {
+            usage(argv[0]);
+        }
+
+        std::string_view key   = arg.substr(2, eq - 2);
+        std::string      value{arg.substr(eq + 1)};
+
+        if (key == "format" && (value == "csv" || value == "json")) {
+            opts.format = value;
+        } else if (key == "output") {
+            opts.output = value;
+        } else if (key == "min-size") {
+            opts.min_size = std::max<std::size_t>(1, std::stoull(value));
+        } else if (key == "max-size") {
+            opts.max_size = std::stoull(value);
+        } else if (key == "queries") {
+            opts.queries = std::stoull(value);
+        } else if (key == "repetitions") {
+            opts.repetitions = std::max<std::size_t>(1, std::stoull(value));
+        } else if (key == "seed") {
+            opts.seed = std::stoull(value);
+        } else if (key == "containers") {
+            opts.containers = split(value);
+            for (const auto& name : opts.containers) {
+                if (name != "rb_tree" && name != "frozen" && name != "b_tree"
+                    && name != "multiset") {
+                    usage(argv[0]);
+                }
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    return opts;
+}
+
+// the operation checksums of every container must agree with the baseline
+bool cross_check(const std::vector<Result>& results)
+{
+    std::map<std::tuple<std::size_t, std::string>,
+             std::pair<std::string, std::uint64_t>>
+        expected;
+
+    bool ok = true;
+    for (const auto& r : results) {
+        auto [it, fresh] = expected.try_emplace(
+            std::make_tuple(r.size, r.operation), r.container, r.checksum);
+        if (!fresh && it->second.second != r.checksum) {
+            std::cerr << "checksum mismatch: " << r.container << " vs "
+                      << it->second.first << " on " << r.size << '/'
+                      << r.operation << '\n';
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts = parse(argc, argv);
+
+    std::vector<Result> results;
+
+    for (std::size_t n = opts.min_size; n <= opts.max_size; n *= 10) {
+        std::vector<Key> sorted  = make_keys(n, opts.seed);
+        std::vector<Key> queries = make_queries(sorted, opts.queries,
+                                                opts.seed + 1);
+
+        for (const auto& name : opts.containers) {
+            std::cerr << name << ' ' << n << '\n';
+
+            if (name == "rb_tree") {
+                run<rb_tree<Key>>(name, sorted, queries, opts.repetitions,
+                                  results);
+            } else if (name == "frozen") {
+                run<frozen_tree<Key>>(name, sorted, queries, opts.repetitions,
+                                      results);
+            } else if (name == "b_tree") {
+                run<b_tree<Key>>(name, sorted, queries, opts.repetitions,
+                                 results);
+            } else if (name == "multiset") {
+                run<std::multiset<Key>>(name, sorted, queries,
+                                        opts.repetitions, results);
+            }
+        }
+        if (n > std::numeric_limits<std::size_t>::max() / 10) break;
+    }
+
+    std::ofstream file;
+    if (!opts.output.empty()) file.open(opts.output);
+    std::ostream& os = opts.output.empty() ? std::cout : file;
+
+    if (opts.format == "json") {
+        write_json(os, results);
+    } else {
+        write_csv(os, results);
+    }
+
+    return cross_check(results) ? 0 : 1;
+}
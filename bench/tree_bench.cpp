@@ -0,0 +1,945 @@
+/* benchmark suite for the trees in src/
+ *
+ * every container is run through the same scenario (insert, insert_hint,
+ * find, iterate, scan, parallel_visit, copy, modify, erase, clear, the bulk
+ * loads and insert_many) over a set of key streams; std::multiset is the
+ * baseline
+ *
+ * insert_hint inserts the keys into a tree of its own with end() as the hint
+ * (the idiom for appending a stream that is mostly in order); containers
+ * without hinted inserts insert them without one
+ *
+ * scan walks the elements with a cursor where the container has one (SEE:
+ * bst::scan), and with its iterators otherwise
+ *
+ * parallel_visit sums the elements on a pool of one thread per core where the
+ * container can split its walk into tasks (SEE: bst::parallel_inorder_from),
+ * and iterates over them otherwise
+ *
+ * insert_many inserts the queries as one unsorted batch into the tree the
+ * bulk loads left behind (SEE: bst::insert_many); containers without batched
+ * inserts insert them one at a time
+ *
+ * persistent_tree shares its nodes between copies, so its copy row measures
+ * taking a snapshot; its modify row then includes copying the shared paths
+ *
+ * the results are written as CSV (default) or JSON so that they can be diffed
+ * between releases; each row also carries a checksum of the operation's
+ * result which is cross-checked between the containers
+ *
+ * the keys are 64-bit integers, or strings sharing a long prefix (so that
+ * every comparison has to look at most of the string); both are derived from
+ * the same integer streams and keep their order
+ *
+ * usage: tree_bench [--format=csv|json] [--output=FILE]
+ *                   [--min-size=N] [--max-size=N] [--repetitions=N]
+ *                   [--containers=bst,rb_tree,persistent,b_tree,compact,
+ *                                 multiset]
+ *                   [--distributions=sorted,reverse,random,zipf]
+ *                   [--keys=integer,string]
+ *                   [--degenerate-limit=N] [--seed=N] */
+
+#include "b_tree.h"
+#include "bst.h"
+#include "compact_rb_tree.h"
+#include "persistent_tree.h"
+#include "rb_tree.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Key = std::uint64_t;
+
+enum class Distribution { sorted, reverse, random, zipf };
+
+constexpr std::string_view to_string(Distribution dist) noexcept
+{
+    switch (dist) {
+    case Distribution::sorted: return "sorted";
+    case Distribution::reverse: return "reverse";
+    case Distribution::random: return "random";
+    case Distribution::zipf: return "zipf";
+    }
+    return "unknown";
+}
+
+/* samples ranks in [1, n] with P(k) proportional to 1 / k^s
+ *
+ * SEE: W. Hormann and G. Derflinger, "Rejection-inversion to generate variates
+ * from monotone discrete distributions"; this needs no table, so it is usable
+ * for the largest sizes */
+class ZipfDistribution
+{
+  public:
+    ZipfDistribution(std::uint64_t n, double s)
+        : n_{static_cast<double>(n)}
+        , s_{s}
+        , h_integral_x1_{h_integral(1.5) - 1.0}
+        , h_integral_n_{h_integral(n_ + 0.5)}
+        , threshold_{2.0 - h_integral_inverse(h_integral(2.5) - h(2.0))}
+    {
+    }
+
+    template <typename Generator>
+    std::uint64_t operator()(Generator& gen)
+    {
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+
+        while (true) {
+            double u = h_integral_n_
+                       + uniform(gen) * (h_integral_x1_ - h_integral_n_);
+            double x = h_integral_inverse(u);
+            double k = std::clamp(std::floor(x + 0.5), 1.0, n_);
+
+            if (k - x <= threshold_ || u >= h_integral(k + 0.5) - h(k)) {
+                return static_cast<std::uint64_t>(k);
+            }
+        }
+    }
+
+  private:
+    double n_;
+    double s_;
+    double h_integral_x1_;
+    double h_integral_n_;
+    double threshold_;
+
+    [[nodiscard]] double h(double x) const
+    {
+        return std::exp(-s_ * std::log(x));
+    }
+
+    [[nodiscard]] double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return helper2((1.0 - s_) * log_x) * log_x;
+    }
+
+    [[nodiscard]] double h_integral_inverse(double x) const
+    {
+        double t = std::max(x * (1.0 - s_), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+    // log1p(x) / x with the limit at 0
+    static double helper1(double x)
+    {
+        if (std::abs(x) > 1e-8) return std::log1p(x) / x;
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x with the limit at 0
+    static double helper2(double x)
+    {
+        if (std::abs(x) > 1e-8) return std::expm1(x) / x;
+        return 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+};
+
+// bijective on 64-bit integers; scatters the popular zipf ranks over the key
+// space so that they are not also the smallest keys
+constexpr Key scramble(std::uint64_t x) noexcept
+{
+    return x * 0x9E3779B97F4A7C15ULL;
+}
+
+std::vector<Key> make_keys(Distribution dist, std::size_t n, std::uint64_t seed)
+{
+    std::vector<Key> keys(n);
+    std::mt19937_64  gen{seed};
+
+    switch (dist) {
+    case Distribution::sorted:
+        for (std::size_t i = 0; i < n; ++i) keys[i] = i;
+        break;
+    case Distribution::reverse:
+        for (std::size_t i = 0; i < n; ++i) keys[i] = n - 1 - i;
+        break;
+    case Distribution::random:
+        for (auto& key : keys) key = gen();
+        break;
+    case Distribution::zipf: {
+        ZipfDistribution zipf{n, 0.99};
+        for (auto& key : keys) key = scramble(zipf(gen));
+        break;
+    }
+    }
+
+    return keys;
+}
+
+// the key types a scenario can be run with; see KeyTraits
+enum class KeyType { integer, string };
+
+constexpr std::string_view to_string(KeyType type) noexcept
+{
+    switch (type) {
+    case KeyType::integer: return "integer";
+    case KeyType::string: return "string";
+    }
+    return "unknown";
+}
+
+/* make builds a key from an integer of the generated streams (preserving
+ * their order), next yields the key a modify step moves an element to and
+ * checksum folds a key into the row checksums */
+template <typename K>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<Key> {
+    static Key make(Key x) noexcept { return x; }
+    static Key next(Key key) noexcept { return key + 1; }
+    static std::uint64_t checksum(Key key) noexcept { return key; }
+};
+
+template <>
+struct KeyTraits<std::string> {
+    // zero padded so that the lexicographic order is the numeric one
+    static std::string make(Key x)
+    {
+        std::string digits = std::to_string(x);
+        return std::string{"tenant/region/shard/"}
+               + std::string(20 - digits.size(), '0') + digits;
+    }
+
+    static std::string next(const std::string& key) { return key + '+'; }
+
+    static std::uint64_t checksum(const std::string& key) noexcept
+    {
+        return std::hash<std::string>{}(key);
+    }
+};
+
+template <typename K>
+std::vector<K> make_keys(const std::vector<Key>& from)
+{
+    std::vector<K> keys;
+    keys.reserve(from.size());
+    for (Key x : from) keys.push_back(KeyTraits<K>::make(x));
+    return keys;
+}
+
+struct Options {
+    std::string              format{"csv"};
+    std::string              output;
+    std::size_t              min_size{1000};
+    std::size_t              max_size{10000000};
+    std::size_t              repetitions{1};
+    std::size_t              degenerate_limit{20000};
+    std::uint64_t            seed{42};
+    std::vector<std::string> containers{"bst",
+                                        "rb_tree",
+                                        "persistent",
+                                        "b_tree",
+                                        "compact",
+                                        "multiset"};
+    std::vector<KeyType>     key_types{KeyType::integer};
+    std::vector<Distribution> distributions{Distribution::sorted,
+                                            Distribution::reverse,
+                                            Distribution::random,
+                                            Distribution::zipf};
+};
+
+// one timed operation of a scenario
+struct Sample {
+    std::string   operation;
+    double        ns_total;
+    std::size_t   ops;
+    std::uint64_t checksum;
+    std::size_t   bytes;
+};
+
+struct Result {
+    std::string   container;
+    KeyType       key_type;
+    Distribution  distribution;
+    std::size_t   size;
+    Sample        sample;
+};
+
+// the bytes currently held through CountingAllocator
+std::atomic<std::size_t> live_bytes{0}; // NOLINT
+
+/* forwards to std::allocator and keeps track of the live bytes; every
+ * container is instantiated with it so that their footprints (which are
+ * dominated by the node layouts) can be compared */
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& /*that*/) noexcept // NOLINT
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        live_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept
+    {
+        live_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+        std::allocator<T>{}.deallocate(ptr, n);
+    }
+
+    template <typename U>
+    friend bool operator==(const CountingAllocator& /*lhs*/,
+                           const CountingAllocator<U>& /*rhs*/) noexcept
+    {
+        return true;
+    }
+};
+
+template <typename K>
+using Bst = bst<K, std::less<K>, CountingAllocator<K>>;
+
+template <typename K>
+using RbTree = rb_tree<K, std::less<K>, CountingAllocator<K>>;
+
+template <typename K>
+using Persistent = persistent_tree<K, std::less<K>, CountingAllocator<K>>;
+
+template <typename K>
+using BTree = b_tree<K, std::less<K>, CountingAllocator<K>>;
+
+template <typename K>
+using Compact = compact_rb_tree<K, std::less<K>, CountingAllocator<K>>;
+
+template <typename K>
+using Multiset = std::multiset<K, std::less<K>, CountingAllocator<K>>;
+
+class Timer
+{
+  public:
+    Timer()
+        : start_{Clock::now()}
+    {
+    }
+
+    [[nodiscard]] double elapsed_ns() const
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start_)
+            .count();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start_;
+};
+
+// the adapters hide the few places where the trees and std::multiset differ
+template <typename Tree>
+struct Adapter {
+    using K = typename Tree::value_type;
+
+    static void
+    modify(Tree& tree, typename Tree::const_iterator pos, const K& key)
+    {
+        tree.modify(pos, key);
+    }
+
+    static void assign_sorted(Tree& tree, const std::vector<K>& sorted)
+    {
+        tree.assign_sorted(sorted.begin(), sorted.end());
+    }
+
+    static void assign(Tree& tree, const std::vector<K>& keys)
+    {
+        tree.assign(keys.begin(),
+                    keys.end(),
+                    std::thread::hardware_concurrency());
+    }
+};
+
+template <typename T, typename Compare, typename Allocator>
+struct Adapter<std::multiset<T, Compare, Allocator>> {
+    using Tree = std::multiset<T, Compare, Allocator>;
+
+    static void
+    modify(Tree& tree, typename Tree::const_iterator pos, const T& key)
+    {
+        auto handle    = tree.extract(pos);
+        handle.value() = key;
+        tree.insert(std::move(handle));
+    }
+
+    // the range constructor is linear for sorted input
+    static void assign_sorted(Tree& tree, const std::vector<T>& sorted)
+    {
+        tree = Tree(sorted.begin(), sorted.end());
+    }
+
+    static void assign(Tree& tree, const std::vector<T>& keys)
+    {
+        std::vector<T> sorted{keys};
+        std::sort(sorted.begin(), sorted.end());
+        tree = Tree(sorted.begin(), sorted.end());
+    }
+};
+
+template <typename T, typename Compare, typename Allocator>
+struct Adapter<persistent_tree<T, Compare, Allocator>> {
+    using Tree = persistent_tree<T, Compare, Allocator>;
+
+    static void
+    modify(Tree& tree, typename Tree::const_iterator pos, const T& key)
+    {
+        tree.modify(pos, key);
+    }
+
+    static void assign_sorted(Tree& tree, const std::vector<T>& sorted)
+    {
+        tree.assign_sorted(sorted.begin(), sorted.end());
+    }
+
+    static void assign(Tree& tree, const std::vector<T>& keys)
+    {
+        tree.assign(keys.begin(), keys.end());
+    }
+};
+
+template <typename T, typename Compare, typename Allocator>
+struct Adapter<b_tree<T, Compare, Allocator>> {
+    using Tree = b_tree<T, Compare, Allocator>;
+
+    static void
+    modify(Tree& tree, typename Tree::const_iterator pos, const T& key)
+    {
+        tree.modify(pos, key);
+    }
+
+    static void assign_sorted(Tree& tree, const std::vector<T>& sorted)
+    {
+        tree.assign_sorted(sorted.begin(), sorted.end());
+    }
+
+    static void assign(Tree& tree, const std::vector<T>& keys)
+    {
+        tree.assign(keys.begin(), keys.end());
+    }
+};
+
+template <typename T, typename Compare, typename Allocator>
+struct Adapter<compact_rb_tree<T, Compare, Allocator>> {
+    using Tree = compact_rb_tree<T, Compare, Allocator>;
+
+    static void
+    modify(Tree& tree, typename Tree::const_iterator pos, const T& key)
+    {
+        tree.modify(pos, key);
+    }
+
+    static void assign_sorted(Tree& tree, const std::vector<T>& sorted)
+    {
+        tree.assign_sorted(sorted.begin(), sorted.end());
+    }
+
+    static void assign(Tree& tree, const std::vector<T>& keys)
+    {
+        tree.assign(keys.begin(), keys.end());
+    }
+};
+
+template <typename Tree>
+std::uint64_t sum(const Tree& tree)
+{
+    using K = typename Tree::value_type;
+
+    std::uint64_t acc{0};
+    for (const auto& key : tree) acc += KeyTraits<K>::checksum(key);
+    return acc;
+}
+
+// one worker per hardware thread, shared by every run; it is started the
+// first time it is needed, before that step reads the clock
+work_stealing_pool& shared_pool()
+{
+    static work_stealing_pool pool;
+    return pool;
+}
+
+// the same sum, split across shared_pool() where the container can split its
+// walk (SEE: bst::parallel_inorder_from)
+template <typename Tree>
+std::uint64_t parallel_sum(const Tree& tree, work_stealing_pool& pool)
+{
+    using K = typename Tree::value_type;
+
+    auto visit = [](const K& key, std::uint64_t& acc) {
+        acc += KeyTraits<K>::checksum(key);
+    };
+
+    if constexpr (requires {
+                      tree.parallel_inorder_from(tree.root(),
+                                                 pool,
+                                                 std::uint64_t{0},
+                                                 visit,
+                                                 std::plus<std::uint64_t>{});
+                  }) {
+        return tree.parallel_inorder_from(tree.root(),
+                                          pool,
+                                          std::uint64_t{0},
+                                          visit,
+                                          std::plus<std::uint64_t>{});
+    } else {
+        return sum(tree);
+    }
+}
+
+template <typename Tree>
+std::uint64_t scan_sum(const Tree& tree)
+{
+    using K = typename Tree::value_type;
+
+    std::uint64_t acc{0};
+    if constexpr (requires { tree.scan(); }) {
+        for (auto it = tree.scan(); it; ++it) {
+            acc += KeyTraits<K>::checksum(*it);
+        }
+    } else {
+        acc = sum(tree);
+    }
+    return acc;
+}
+
+/* runs the full scenario once
+ *
+ * the modify and clear steps run on the copy so that the erase step still sees
+ * the keys that were inserted; the cleared copy is then bulk loaded */
+template <typename Tree, typename K = typename Tree::value_type>
+std::vector<Sample> run_scenario(const std::vector<K>& keys,
+                                 const std::vector<K>& queries,
+                                 const std::vector<K>& sorted)
+{
+    std::vector<Sample> samples;
+
+    // NOTE: the checksums are computed after the clock is read
+    auto record = [&samples](std::string   name,
+                             double        ns,
+                             std::size_t   ops,
+                             std::uint64_t checksum) {
+        samples.push_back({std::move(name),
+                           ns,
+                           ops,
+                           checksum,
+                           live_bytes.load(std::memory_order_relaxed)});
+    };
+
+    Tree tree;
+
+    {
+        Timer timer;
+        for (const K& key : keys) tree.insert(key);
+        record("insert", timer.elapsed_ns(), keys.size(), tree.size());
+    }
+
+    {
+        Tree  hinted;
+        Timer timer;
+        for (const K& key : keys) {
+            if constexpr (requires { hinted.insert(hinted.end(), key); }) {
+                hinted.insert(hinted.end(), key);
+            } else {
+                hinted.insert(key);
+            }
+        }
+        double ns = timer.elapsed_ns();
+        record("insert_hint", ns, keys.size(), sum(hinted));
+    }
+
+    {
+        std::uint64_t acc{0};
+        Timer         timer;
+        for (const K& key : queries) {
+            auto it = tree.find(key);
+            if (it != tree.end()) acc += KeyTraits<K>::checksum(*it);
+        }
+        record("find", timer.elapsed_ns(), queries.size(), acc);
+    }
+
+    {
+        Timer         timer;
+        std::uint64_t acc = sum(tree);
+        record("iterate", timer.elapsed_ns(), tree.size(), acc);
+    }
+
+    {
+        Timer         timer;
+        std::uint64_t acc = scan_sum(tree);
+        record("scan", timer.elapsed_ns(), tree.size(), acc);
+    }
+
+    {
+        work_stealing_pool& pool = shared_pool();
+
+        Timer         timer;
+        std::uint64_t acc = parallel_sum(tree, pool);
+        record("parallel_visit", timer.elapsed_ns(), tree.size(), acc);
+    }
+
+    Tree copy = [&record, &tree] {
+        Timer timer;
+        Tree  copy{tree};
+        record("copy", timer.elapsed_ns(), tree.size(), copy.size());
+        return copy;
+    }();
+
+    {
+        Timer timer;
+        for (const K& key : queries) {
+            Adapter<Tree>::modify(copy, copy.find(key), KeyTraits<K>::next(key));
+        }
+        record("modify", timer.elapsed_ns(), queries.size(), sum(copy));
+    }
+
+    {
+        std::uint64_t erased{0};
+        Timer         timer;
+        for (const K& key : queries) {
+            auto it = tree.find(key);
+            if (it != tree.end()) {
+                tree.erase(it);
+                ++erased;
+            }
+        }
+        record("erase", timer.elapsed_ns(), queries.size(), erased);
+    }
+
+    {
+        std::size_t n = copy.size();
+        Timer       timer;
+        copy.clear();
+        record("clear", timer.elapsed_ns(), n, copy.size());
+    }
+
+    {
+        Timer timer;
+        Adapter<Tree>::assign_sorted(copy, sorted);
+        record("assign_sorted", timer.elapsed_ns(), sorted.size(), sum(copy));
+    }
+
+    {
+        Timer timer;
+        Adapter<Tree>::assign(copy, keys);
+        record("assign", timer.elapsed_ns(), keys.size(), sum(copy));
+    }
+
+    {
+        Timer timer;
+        if constexpr (requires { copy.insert_many(queries.begin(),
+                                                  queries.end()); }) {
+            copy.insert_many(queries.begin(), queries.end());
+        } else {
+            for (const K& key : queries) copy.insert(key);
+        }
+        record("insert_many", timer.elapsed_ns(), queries.size(), sum(copy));
+    }
+
+    return samples;
+}
+
+template <typename Tree, typename K = typename Tree::value_type>
+void run(const std::string&    name,
+         KeyType               key_type,
+         Distribution          dist,
+         const std::vector<K>& keys,
+         const std::vector<K>& queries,
+         const std::vector<K>& sorted,
+         std::size_t           repetitions,
+         std::vector<Result>&  out)
+{
+    auto best = run_scenario<Tree>(keys, queries, sorted);
+
+    for (std::size_t rep = 1; rep < repetitions; ++rep) {
+        auto again = run_scenario<Tree>(keys, queries, sorted);
+        for (std::size_t i = 0; i < best.size(); ++i) {
+            best[i].ns_total = std::min(best[i].ns_total, again[i].ns_total);
+        }
+    }
+
+    for (auto& sample : best) {
+        out.push_back({name, key_type, dist, keys.size(), std::move(sample)});
+    }
+}
+
+double ns_per_op(const Sample& sample)
+{
+    if (sample.ops == 0) return 0.0;
+    return sample.ns_total / static_cast<double>(sample.ops);
+}
+
+// NOTE: bytes are the live bytes held by the containers after the operation
+void write_csv(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "container,keys,distribution,size,operation,ns_total,ns_per_op,"
+          "checksum,bytes\n";
+    for (const auto& r : results) {
+        os << r.container << ',' << to_string(r.key_type) << ','
+           << to_string(r.distribution) << ',' << r.size
+           << ',' << r.sample.operation << ',' << r.sample.ns_total << ','
+           << ns_per_op(r.sample) << ',' << r.sample.checksum << ','
+           << r.sample.bytes << '\n';
+    }
+}
+
+void write_json(std::ostream& os, const std::vector<Result>& results)
+{
+    os << std::fixed << std::setprecision(3);
+    os << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "  {\"container\": \"" << r.container << "\", "
+           << "\"keys\": \"" << to_string(r.key_type) << "\", "
+           << "\"distribution\": \"" << to_string(r.distribution) << "\", "
+           << "\"size\": " << r.size << ", "
+           << "\"operation\": \"" << r.sample.operation << "\", "
+           << "\"ns_total\": " << r.sample.ns_total << ", "
+           << "\"ns_per_op\": " << ns_per_op(r.sample) << ", "
+           << "\"checksum\": " << r.sample.checksum << ", "
+           << "\"bytes\": " << r.sample.bytes << "}"
+           << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "]\n";
+}
+
+std::vector<std::string> split(std::string_view list)
+{
+    std::vector<std::string> items;
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        items.emplace_back(list.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+[[noreturn]] void usage(const char* prog)
+{
+    std::cerr << "usage: " << prog
+              << " [--format=csv|json] [--output=FILE]"
+                 " [--min-size=N] [--max-size=N] [--repetitions=N]"
+                 " [--containers=bst,rb_tree,persistent,b_tree,compact,"
+                 "multiset]"
+                 " [--distributions=sorted,reverse,random,zipf]"
+                 " [--keys=integer,string]"
+                 " [--degenerate-limit=N] [--seed=N]\n";
+    std::exit(2);
+}
+
+Options parse(int argc, char** argv)
+{
+    Options opts;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        auto             eq = arg.find('=');
+        if (arg.substr(0, 2) != "--" || eq == std::string_view::npos) {
+            usage(argv[0]);
+        }
+
+        std::string_view key   = arg.substr(2, eq - 2);
+        std::string      value{arg.substr(eq + 1)};
+
+        if (key == "format" && (value == "csv" || value == "json")) {
+            opts.format = value;
+        } else if (key == "output") {
+            opts.output = value;
+        } else if (key == "min-size") {
+            opts.min_size = std::stoull(value);
+        } else if (key == "max-size") {
+            opts.max_size = std::stoull(value);
+        } else if (key == "repetitions") {
+            opts.repetitions = std::max<std::size_t>(1, std::stoull(value));
+        } else if (key == "degenerate-limit") {
+            opts.degenerate_limit = std::stoull(value);
+        } else if (key == "seed") {
+            opts.seed = std::stoull(value);
+        } else if (key == "containers") {
+            opts.containers = split(value);
+            for (const auto& name : opts.containers) {
+                if (name != "bst" && name != "rb_tree" && name != "persistent"
+                    && name != "b_tree" && name != "compact"
+                    && name != "multiset") {
+                    usage(argv[0]);
+                }
+            }
+        } else if (key == "distributions") {
+            opts.distributions.clear();
+            for (const auto& name : split(value)) {
+                if (name == "sorted") {
+                    opts.distributions.push_back(Distribution::sorted);
+                } else if (name == "reverse") {
+                    opts.distributions.push_back(Distribution::reverse);
+                } else if (name == "random") {
+                    opts.distributions.push_back(Distribution::random);
+                } else if (name == "zipf") {
+                    opts.distributions.push_back(Distribution::zipf);
+                } else {
+                    usage(argv[0]);
+                }
+            }
+        } else if (key == "keys") {
+            opts.key_types.clear();
+            for (const auto& name : split(value)) {
+                if (name == "integer") {
+                    opts.key_types.push_back(KeyType::integer);
+                } else if (name == "string") {
+                    opts.key_types.push_back(KeyType::string);
+                } else {
+                    usage(argv[0]);
+                }
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    return opts;
+}
+
+// the operation checksums of every container must agree with the baseline
+bool cross_check(const std::vector<Result>& results)
+{
+    std::map<std::tuple<KeyType, Distribution, std::size_t, std::string>,
+             std::pair<std::string, std::uint64_t>>
+        expected;
+
+    bool ok = true;
+    for (const auto& r : results) {
+        const Sample& sample = r.sample;
+
+        auto key = std::make_tuple(
+            r.key_type, r.distribution, r.size, sample.operation);
+        auto [it, fresh] =
+            expected.try_emplace(key, r.container, sample.checksum);
+        if (!fresh && it->second.second != sample.checksum) {
+            std::cerr << "checksum mismatch: " << r.container << " vs "
+                      << it->second.first << " on " << to_string(r.key_type)
+                      << '/' << to_string(r.distribution)
+                      << '/' << r.size << '/' << sample.operation << '\n';
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// runs every selected container over one key stream
+template <typename K>
+void run_all(const Options&        opts,
+             KeyType               type,
+             Distribution          dist,
+             const std::vector<K>& keys,
+             const std::vector<K>& queries,
+             const std::vector<K>& sorted,
+             std::vector<Result>&  results)
+{
+    for (const auto& name : opts.containers) {
+        std::cerr << name << ' ' << to_string(type) << ' ' << to_string(dist)
+                  << ' ' << keys.size() << '\n';
+
+        if (name == "bst") {
+            // an unbalanced tree degenerates into a list on ordered input
+            // (and on long runs of equal keys)
+            if (dist != Distribution::random
+                && keys.size() > opts.degenerate_limit) {
+                continue;
+            }
+            run<Bst<K>>(name, type, dist, keys, queries, sorted,
+                        opts.repetitions, results);
+        } else if (name == "rb_tree") {
+            run<RbTree<K>>(name, type, dist, keys, queries, sorted,
+                           opts.repetitions, results);
+        } else if (name == "persistent") {
+            run<Persistent<K>>(name, type, dist, keys, queries, sorted,
+                               opts.repetitions, results);
+        } else if (name == "b_tree") {
+            run<BTree<K>>(name, type, dist, keys, queries, sorted,
+                          opts.repetitions, results);
+        } else if (name == "compact") {
+            run<Compact<K>>(name, type, dist, keys, queries, sorted,
+                            opts.repetitions, results);
+        } else if (name == "multiset") {
+            run<Multiset<K>>(name, type, dist, keys, queries, sorted,
+                             opts.repetitions, results);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts = parse(argc, argv);
+
+    std::vector<Result> results;
+
+    for (std::size_t n = opts.min_size; n <= opts.max_size; n *= 10) {
+        for (Distribution dist : opts.distributions) {
+            std::vector<Key> keys = make_keys(dist, n, opts.seed);
+
+            std::vector<Key> queries{keys};
+            std::shuffle(queries.begin(),
+                         queries.end(),
+                         std::mt19937_64{opts.seed + 1});
+
+            std::vector<Key> sorted{keys};
+            std::sort(sorted.begin(), sorted.end());
+
+            for (KeyType type : opts.key_types) {
+                if (type == KeyType::integer) {
+                    run_all<Key>(opts, type, dist, keys, queries, sorted,
+                                 results);
+                } else {
+                    run_all<std::string>(opts, type, dist,
+                                         make_keys<std::string>(keys),
+                                         make_keys<std::string>(queries),
+                                         make_keys<std::string>(sorted),
+                                         results);
+                }
+            }
+        }
+        if (n > std::numeric_limits<std::size_t>::max() / 10) break;
+    }
+
+    std::ofstream file;
+    if (!opts.output.empty()) file.open(opts.output);
+    std::ostream& os = opts.output.empty() ? std::cout : file;
+
+    if (opts.format == "json") {
+        write_json(os, results);
+    } else {
+        write_csv(os, results);
+    }
+
+    return cross_check(results) ? 0 : 1;
+}
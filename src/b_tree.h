@@ -0,0 +1,1348 @@
+#ifndef B_TREE_H
+#define B_TREE_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* an ordered multiset keeping many elements per node
+ *
+ * every node holds up to node_capacity elements in sorted order, laid out
+ * next to each other in about node_bytes (a few cache lines); an inner node
+ * with k elements has k + 1 children, and every leaf is at the same depth; so
+ * a lookup touches height() nodes, a handful of cache lines each, instead of
+ * one (usually cold) node per level of a binary tree
+ *
+ * within a node the position of a key is found by comparing it with every
+ * element at once when T is arithmetic and Compare is std::less (with AVX2,
+ * or SSE2 and SSE4.2, when the target has them; SEE: simd_rank), and by
+ * binary search otherwise
+ *
+ * the interface is the one of bst, with one difference: the elements move
+ * between (and within) nodes as other elements are inserted and erased; so
+ * insert and erase invalidate every iterator (but the ones they return)
+ *
+ * NOTE: the elements are moved around with their move constructor and move
+ * assignment, which must not throw */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class b_tree
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>
+                  && std::is_nothrow_move_assignable_v<T>);
+
+    struct Node;
+    struct Inner;
+
+    class ConstBTreeIterator;
+
+    // SEE: bst::transparent
+    static constexpr bool transparent = requires {
+        typename Compare::is_transparent;
+    };
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using const_iterator         = ConstBTreeIterator;
+    using iterator               = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator       = const_reverse_iterator;
+
+    // the bytes the elements of a node (and its header) are laid out in
+    static constexpr size_t node_bytes{256};
+
+    // the most elements a node holds; odd, so that a full node splits into
+    // two halves and the one in the middle
+    static constexpr size_t node_capacity = [] {
+        size_t fit = (node_bytes - 16) / sizeof(T);
+        return fit < 3 ? size_t{3} : (fit - 1) | 1;
+    }();
+
+  private:
+    // every node but the root holds at least min_keys elements
+    static constexpr size_t min_keys = node_capacity / 2;
+
+    using AllocTraits    = std::allocator_traits<Allocator>;
+    using LeafAllocator  = typename AllocTraits::template rebind_alloc<Node>;
+    using LeafTraits     = std::allocator_traits<LeafAllocator>;
+    using InnerAllocator = typename AllocTraits::template rebind_alloc<Inner>;
+    using InnerTraits    = std::allocator_traits<InnerAllocator>;
+
+    // NOTE: the header (up to the elements) fits into the 16 bytes that
+    // node_capacity leaves for it
+    struct alignas(64) Node {
+        explicit Node(bool leaf) noexcept
+            : leaf{leaf}
+        {
+        }
+
+        Inner*        parent{nullptr};
+        std::uint16_t index{0}; // among the children of parent
+        std::uint16_t count{0};
+        bool          leaf;
+
+        alignas(T) unsigned char storage[node_capacity * sizeof(T)];
+
+        T* keys() noexcept
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+
+        const T* keys() const noexcept
+        {
+            return std::launder(reinterpret_cast<const T*>(storage));
+        }
+
+        T&       key(size_t i) noexcept { return keys()[i]; }
+        const T& key(size_t i) const noexcept { return keys()[i]; }
+    };
+
+    struct Inner : public Node {
+        Inner() noexcept
+            : Node{false}
+        {
+        }
+
+        // NOTE: only the first count + 1 are set
+        Node* children[node_capacity + 1]{};
+    };
+
+    /* the position of an element: the node it is in and its index there
+     *
+     * node is nullptr for end(); an index of node->count (one past the last
+     * element) only occurs on a leaf while erasing, and stands for the
+     * element after the leaf */
+    struct Position {
+        Node*  node;
+        size_t index;
+
+        bool operator==(const Position&) const = default;
+    };
+
+    class ConstBTreeIterator
+    {
+        friend class b_tree;
+
+      private:
+        using Self = ConstBTreeIterator;
+
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        const T& operator*() const noexcept { return node_->key(index_); }
+        const T* operator->() const noexcept { return &node_->key(index_); }
+
+        Self& operator++() noexcept
+        {
+            Position pos = next({const_cast<Node*>(node_), index_});
+            node_        = pos.node;
+            index_       = pos.index;
+            return *this;
+        }
+
+        Self operator++(int) noexcept
+        {
+            Self tmp{*this};
+            ++*this;
+            return tmp;
+        }
+
+        Self& operator--() noexcept
+        {
+            Position pos = tree_->prev({const_cast<Node*>(node_), index_});
+            node_        = pos.node;
+            index_       = pos.index;
+            return *this;
+        }
+
+        Self operator--(int) noexcept
+        {
+            Self tmp{*this};
+            --*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.node_ == rhs.node_ && lhs.index_ == rhs.index_;
+        }
+
+        friend bool operator!=(const Self& lhs, const Self& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+      private:
+        const b_tree* tree_;
+        const Node*   node_;
+        size_t        index_;
+
+        ConstBTreeIterator(const b_tree* tree, Position pos) noexcept
+            : tree_{tree}
+            , node_{pos.node}
+            , index_{pos.node != nullptr ? pos.index : 0}
+        {
+        }
+
+        Position position() const noexcept
+        {
+            return {const_cast<Node*>(node_), index_};
+        }
+    };
+
+  public:
+    b_tree()
+        : b_tree{Compare{}}
+    {
+    }
+
+    explicit b_tree(const Compare& compare)
+        : compare_{compare}
+    {
+    }
+
+    b_tree(const b_tree& that)
+        : compare_{that.compare_}
+    {
+        if (that.root_ != nullptr) root_ = clone(that.root_);
+        size_ = that.size_;
+    }
+
+    b_tree(b_tree&& that) noexcept
+        : compare_{that.compare_}
+        , root_{std::exchange(that.root_, nullptr)}
+        , size_{std::exchange(that.size_, 0)}
+    {
+    }
+
+    ~b_tree() { clear(); }
+
+    b_tree& operator=(const b_tree& that)
+    {
+        if (this != &that) {
+            b_tree copy{that};
+            *this = std::move(copy);
+        }
+
+        return *this;
+    }
+
+    b_tree& operator=(b_tree&& that) noexcept
+    {
+        if (this != &that) {
+            clear();
+            compare_ = that.compare_;
+            root_    = std::exchange(that.root_, nullptr);
+            size_    = std::exchange(that.size_, 0);
+        }
+
+        return *this;
+    }
+
+    allocator_type get_allocator() const noexcept { return allocator_type{}; }
+    value_compare  value_comp() const { return compare_; }
+
+    [[nodiscard]] bool   empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+
+    // the number of levels of nodes
+    [[nodiscard]] size_t height() const noexcept
+    {
+        size_t height = 0;
+        for (const Node* node = root_; node != nullptr; ++height) {
+            node = node->leaf ? nullptr : as_inner(node)->children[0];
+        }
+        return height;
+    }
+
+    /* true if the tree is a valid B-tree: every node but the root holds at
+     * least min_keys elements, and the root at least one; every leaf is at
+     * the same depth; every child links back to its parent and its index
+     * there; and the elements are in order, and as many as size()
+     *
+     * NOTE: this walks the whole tree; it is meant for tests */
+    [[nodiscard]] bool verify() const
+    {
+        if (root_ == nullptr) return size_ == 0;
+        if (root_->parent != nullptr || root_->count == 0) return false;
+
+        size_t count = 0;
+        if (!verify_subtree(root_, height(), count)) return false;
+
+        return count == size_ && std::is_sorted(begin(), end(), compare_);
+    }
+
+    void clear() noexcept
+    {
+        if (root_ != nullptr) destroy_subtree(std::exchange(root_, nullptr));
+        size_ = 0;
+    }
+
+    iterator insert(const_iterator hint, const T& data)
+    {
+        return emplace_hint(hint, data);
+    }
+
+    iterator insert(const_iterator hint, T&& data)
+    {
+        return emplace_hint(hint, std::move(data));
+    }
+
+    iterator insert(const T& data) { return emplace(data); }
+
+    iterator insert(T&& data) { return emplace(std::move(data)); }
+
+    // NOTE: the value is constructed from args, and then moved into its node
+    template <typename... Args>
+    iterator emplace(Args&&... args)
+    {
+        T data(std::forward<Args>(args)...);
+        return iterator{this, insert_value(std::move(data))};
+    }
+
+    /* the value goes right before hint if it fits between hint and the
+     * element before it, and the leaf that slot is in has room; so inserting
+     * a stream that is (almost) in order with end(), or the position after
+     * the previous insert, as the hint skips the descent from the root
+     *
+     * NOTE: unlike in bst a hint that is off is not searched from; the value
+     * is inserted as by emplace then */
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args)
+    {
+        T data(std::forward<Args>(args)...);
+        return iterator{this, insert_hinted(hint.position(), std::move(data))};
+    }
+
+    // NOTE: the elements are constructed from *first; so a move_iterator
+    // range is moved into the tree
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last)
+    {
+        for (; first != last; ++first) emplace(*first);
+    }
+
+    void insert(std::initializer_list<T> init)
+    {
+        insert(init.begin(), init.end());
+    }
+
+    /* replaces the contents of the tree with [first, last), which must already
+     * be sorted with respect to Compare
+     *
+     * the nodes are built bottom up (as full as the count of elements allows)
+     * in O(n) without comparing any elements */
+    template <typename ForwardIterator>
+    void assign_sorted(ForwardIterator first, ForwardIterator last)
+    {
+        clear();
+
+        auto n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0) return;
+
+        size_t height = 1;
+        while (subtree_capacity(height) < n) ++height;
+
+        root_ = build_sorted(first, n, height);
+        size_ = n;
+    }
+
+    /* replaces the contents of the tree with the (unsorted) values in
+     * [first, last); the values are sorted and then built as in assign_sorted
+     *
+     * equivalent values keep their relative order */
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        std::vector<T, Allocator> values(first, last);
+        std::stable_sort(values.begin(), values.end(), compare_);
+
+        assign_sorted(std::make_move_iterator(values.begin()),
+                      std::make_move_iterator(values.end()));
+    }
+
+    // returns the element after pos
+    iterator erase(const_iterator pos) noexcept
+    {
+        return iterator{this, erase_at(pos.position())};
+    }
+
+    iterator modify(const_iterator pos, const T& data)
+    {
+        return replace(pos, data);
+    }
+
+    iterator modify(const_iterator pos, T&& data)
+    {
+        return replace(pos, std::move(data));
+    }
+
+    iterator find(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find_of(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator find(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find_of(key);
+    }
+
+    // the first element not less than data
+    iterator lower_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, bound_of<false>(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator lower_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, bound_of<false>(key)};
+    }
+
+    // the first element greater than data
+    iterator upper_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, bound_of<true>(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator upper_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, bound_of<true>(key)};
+    }
+
+    // all the elements equivalent to data; in the order they were inserted
+    std::pair<iterator, iterator> equal_range(const T& data) const
+        noexcept(nothrow_compare<T>)
+    {
+        return {lower_bound(data), upper_bound(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    std::pair<iterator, iterator> equal_range(const Key& key) const
+        noexcept(nothrow_compare<Key>)
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    // NOTE: the equivalent elements are stepped over one at a time
+    size_type count(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        auto [first, last] = equal_range(data);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    template <typename Key>
+        requires transparent
+    size_type count(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        auto [first, last] = equal_range(key);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    bool contains(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find(data) != end();
+    }
+
+    template <typename Key>
+        requires transparent
+    bool contains(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find(key) != end();
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        if (root_ == nullptr) return cend();
+        return const_iterator{this, {leftmost(root_), 0}};
+    }
+
+    const_iterator begin() const noexcept { return cbegin(); }
+
+    const_iterator cend() const noexcept
+    {
+        return const_iterator{this, {nullptr, 0}};
+    }
+
+    const_iterator end() const noexcept { return cend(); }
+
+    const_reverse_iterator crbegin() const noexcept
+    {
+        return std::make_reverse_iterator(cend());
+    }
+
+    const_reverse_iterator rbegin() const noexcept { return crbegin(); }
+
+    const_reverse_iterator crend() const noexcept
+    {
+        return std::make_reverse_iterator(cbegin());
+    }
+
+    const_reverse_iterator rend() const noexcept { return crend(); }
+
+    /* the visitors walk the subtree of the node holding it; a node's elements
+     * are visited before (preorder), between (inorder) or after (postorder)
+     * its children; so inorder_from visits the elements of the subtree in
+     * order */
+    template <typename Visitor, typename... Args>
+    void preorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it.node_ == nullptr) return;
+        walk<Order::pre>(it.node_, visit, args...);
+    }
+
+    template <typename Visitor, typename... Args>
+    void inorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it.node_ == nullptr) return;
+        walk<Order::in>(it.node_, visit, args...);
+    }
+
+    template <typename Visitor, typename... Args>
+    void
+    postorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it.node_ == nullptr) return;
+        walk<Order::post>(it.node_, visit, args...);
+    }
+
+  private:
+    [[no_unique_address]] Compare        compare_;
+    [[no_unique_address]] LeafAllocator  leaf_alloc_;
+    [[no_unique_address]] InnerAllocator inner_alloc_;
+
+    Node*  root_{nullptr};
+    size_t size_{0};
+
+    enum class Order : unsigned char { pre, in, post };
+
+    static Inner* as_inner(Node* node) noexcept
+    {
+        return static_cast<Inner*>(node);
+    }
+
+    static const Inner* as_inner(const Node* node) noexcept
+    {
+        return static_cast<const Inner*>(node);
+    }
+
+    Node* make_leaf()
+    {
+        Node* node = LeafTraits::allocate(leaf_alloc_, 1);
+        LeafTraits::construct(leaf_alloc_, node, true);
+        return node;
+    }
+
+    Inner* make_inner()
+    {
+        Inner* node = InnerTraits::allocate(inner_alloc_, 1);
+        InnerTraits::construct(inner_alloc_, node);
+        return node;
+    }
+
+    // NOTE: the elements have to be destroyed already
+    void free_node(Node* node) noexcept
+    {
+        if (node->leaf) {
+            LeafTraits::destroy(leaf_alloc_, node);
+            LeafTraits::deallocate(leaf_alloc_, node, 1);
+        } else {
+            Inner* inner = as_inner(node);
+            InnerTraits::destroy(inner_alloc_, inner);
+            InnerTraits::deallocate(inner_alloc_, inner, 1);
+        }
+    }
+
+    // NOTE: the children not set yet (in a partially built node) are skipped
+    void destroy_subtree(Node* node) noexcept
+    {
+        if (!node->leaf) {
+            for (size_t i = 0; i <= node->count; ++i) {
+                Node* child = as_inner(node)->children[i];
+                if (child != nullptr) destroy_subtree(child);
+            }
+        }
+
+        std::destroy_n(node->keys(), node->count);
+        free_node(node);
+    }
+
+    // SEE: verify; levels counts the node and the ones below it
+    static bool
+    verify_subtree(const Node* node, size_t levels, size_t& count) noexcept
+    {
+        if (node->count > node_capacity) return false;
+        if (node->parent != nullptr && node->count < min_keys) return false;
+        if (node->leaf != (levels == 1)) return false;
+
+        count += node->count;
+        if (node->leaf) return true;
+
+        const Inner* inner = as_inner(node);
+        for (size_t i = 0; i <= node->count; ++i) {
+            const Node* child = inner->children[i];
+            if (child == nullptr || child->parent != inner
+                || child->index != i) {
+                return false;
+            }
+            if (!verify_subtree(child, levels - 1, count)) return false;
+        }
+
+        return true;
+    }
+
+    static void set_child(Inner* parent, size_t index, Node* child) noexcept
+    {
+        parent->children[index] = child;
+        child->parent           = parent;
+        child->index            = static_cast<std::uint16_t>(index);
+    }
+
+    template <typename NodePtr>
+    static NodePtr leftmost(NodePtr node) noexcept
+    {
+        while (!node->leaf) node = as_inner(node)->children[0];
+        return node;
+    }
+
+    template <typename NodePtr>
+    static NodePtr rightmost(NodePtr node) noexcept
+    {
+        while (!node->leaf) node = as_inner(node)->children[node->count];
+        return node;
+    }
+
+    // the most elements a subtree of the given height can hold
+    static size_t subtree_capacity(size_t height) noexcept
+    {
+        constexpr size_t max = std::numeric_limits<size_t>::max();
+
+        size_t leaves = 1;
+        for (size_t i = 1; i < height; ++i) {
+            if (leaves > max / (node_capacity + 1)) return max;
+            leaves *= node_capacity + 1;
+        }
+
+        // every inner node holds one element fewer than it has children
+        if (leaves > (max - leaves) / (node_capacity + 1)) return max;
+        return leaves * (node_capacity + 1) - 1;
+    }
+
+    /* the position after pos; from an element of an inner node that is the
+     * first element of the subtree right of it, and from the last element of
+     * a leaf it is the element (of an ancestor) the leaf is left of */
+    static Position next(Position pos) noexcept
+    {
+        Node* node = pos.node;
+
+        if (!node->leaf) {
+            return {leftmost(as_inner(node)->children[pos.index + 1]), 0};
+        }
+
+        if (pos.index + 1 < node->count) return {node, pos.index + 1};
+
+        return climb_right(node);
+    }
+
+    // the element the subtree at node is left of; end() if there is none
+    static Position climb_right(Node* node) noexcept
+    {
+        while (node->parent != nullptr && node->index == node->parent->count) {
+            node = node->parent;
+        }
+
+        return {node->parent, node->index};
+    }
+
+    // the position before pos; from end() that is the last element
+    Position prev(Position pos) const noexcept
+    {
+        Node* node = pos.node;
+
+        if (node == nullptr) [[unlikely]] {
+            node = rightmost(root_);
+            return {node, node->count - size_t{1}};
+        }
+
+        if (!node->leaf) {
+            node = rightmost(as_inner(node)->children[pos.index]);
+            return {node, node->count - size_t{1}};
+        }
+
+        if (pos.index > 0) return {node, pos.index - 1};
+
+        while (node->parent != nullptr && node->index == 0) {
+            node = node->parent;
+        }
+
+        return {node->parent, node->index - size_t{1}};
+    }
+
+    // true if the keys of a node can be searched with SIMD compares
+    template <typename Key>
+    static constexpr bool simd_search =
+        std::is_same_v<Key, T> && std::is_arithmetic_v<T>
+        && (std::is_same_v<Compare, std::less<T>>
+            || std::is_same_v<Compare, std::less<>>);
+
+    // SEE: bst::nothrow_compare; std::less never throws on arithmetic types,
+    // whether or not it says so
+    template <typename Key>
+    static constexpr bool nothrow_compare =
+        simd_search<Key>
+        || (noexcept(std::declval<const Compare&>()(std::declval<const Key&>(),
+                                                    std::declval<const T&>()))
+            && noexcept(std::declval<const Compare&>()(
+                std::declval<const T&>(), std::declval<const Key&>())));
+
+    /* the number of elements of node that are less than key (or, with
+     * Upper, not greater than key); i.e., the index of the bound within the
+     * node, and the child to descend into */
+    template <bool Upper, typename Key>
+    size_t rank_of(const Node* node, const Key& key) const
+        noexcept(nothrow_compare<Key>)
+    {
+        const T* keys = node->keys();
+        size_t   n    = node->count;
+
+        if constexpr (simd_search<Key>) {
+            return simd_rank<Upper>(keys, n, key);
+        } else if constexpr (Upper) {
+            return static_cast<size_t>(
+                std::upper_bound(keys, keys + n, key, compare_) - keys);
+        } else {
+            return static_cast<size_t>(
+                std::lower_bound(keys, keys + n, key, compare_) - keys);
+        }
+    }
+
+    /* counts the elements less than (or not greater than) key by comparing
+     * every one of them; the counts of whole vectors come from the masks of
+     * their compares, and the rest are counted one by one (which compilers
+     * turn into compares without branches)
+     *
+     * NOTE: unsigned integers are compared as signed ones with their sign
+     * bits flipped, since SSE2 and AVX2 only compare signed integers */
+    template <bool Upper>
+    static size_t simd_rank(const T* keys, size_t n, T key) noexcept
+    {
+        size_t i    = 0;
+        size_t rank = 0;
+
+#if defined(__AVX2__)
+        if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+            const __m256i bias =
+                _mm256_set1_epi32(std::is_signed_v<T> ? 0 : INT32_MIN);
+            const __m256i k = _mm256_xor_si256(
+                _mm256_set1_epi32(static_cast<std::int32_t>(key)), bias);
+
+            for (; i + 8 <= n; i += 8) {
+                __m256i v = _mm256_xor_si256(
+                    _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(keys + i)),
+                    bias);
+                __m256i gt = Upper ? _mm256_cmpgt_epi32(v, k)
+                                   : _mm256_cmpgt_epi32(k, v);
+                int mask = _mm256_movemask_ps(_mm256_castsi256_ps(gt));
+                rank += Upper ? 8 - std::popcount(unsigned(mask))
+                              : std::popcount(unsigned(mask));
+            }
+        } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+            const __m256i bias =
+                _mm256_set1_epi64x(std::is_signed_v<T> ? 0 : INT64_MIN);
+            const __m256i k = _mm256_xor_si256(
+                _mm256_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_xor_si256(
+                    _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(keys + i)),
+                    bias);
+                __m256i gt = Upper ? _mm256_cmpgt_epi64(v, k)
+                                   : _mm256_cmpgt_epi64(k, v);
+                int mask = _mm256_movemask_pd(_mm256_castsi256_pd(gt));
+                rank += Upper ? 4 - std::popcount(unsigned(mask))
+                              : std::popcount(unsigned(mask));
+            }
+        } else if constexpr (std::is_same_v<T, float>) {
+            constexpr int predicate = Upper ? _CMP_LE_OQ : _CMP_LT_OQ;
+            const __m256  k         = _mm256_set1_ps(key);
+
+            for (; i + 8 <= n; i += 8) {
+                __m256 v   = _mm256_loadu_ps(keys + i);
+                __m256 cmp = _mm256_cmp_ps(v, k, predicate);
+                rank += std::popcount(unsigned(_mm256_movemask_ps(cmp)));
+            }
+        } else if constexpr (std::is_same_v<T, double>) {
+            constexpr int predicate = Upper ? _CMP_LE_OQ : _CMP_LT_OQ;
+            const __m256d k         = _mm256_set1_pd(key);
+
+            for (; i + 4 <= n; i += 4) {
+                __m256d v   = _mm256_loadu_pd(keys + i);
+                __m256d cmp = _mm256_cmp_pd(v, k, predicate);
+                rank += std::popcount(unsigned(_mm256_movemask_pd(cmp)));
+            }
+        }
+#elif defined(__SSE2__)
+        if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+            const __m128i bias =
+                _mm_set1_epi32(std::is_signed_v<T> ? 0 : INT32_MIN);
+            const __m128i k = _mm_xor_si128(
+                _mm_set1_epi32(static_cast<std::int32_t>(key)), bias);
+
+            for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_xor_si128(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)),
+                    bias);
+                __m128i gt =
+                    Upper ? _mm_cmpgt_epi32(v, k) : _mm_cmpgt_epi32(k, v);
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(gt));
+                rank += Upper ? 4 - std::popcount(unsigned(mask))
+                              : std::popcount(unsigned(mask));
+            }
+#if defined(__SSE4_2__)
+        } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+            const __m128i bias =
+                _mm_set1_epi64x(std::is_signed_v<T> ? 0 : INT64_MIN);
+            const __m128i k = _mm_xor_si128(
+                _mm_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+
+            for (; i + 2 <= n; i += 2) {
+                __m128i v = _mm_xor_si128(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)),
+                    bias);
+                __m128i gt =
+                    Upper ? _mm_cmpgt_epi64(v, k) : _mm_cmpgt_epi64(k, v);
+                int mask = _mm_movemask_pd(_mm_castsi128_pd(gt));
+                rank += Upper ? 2 - std::popcount(unsigned(mask))
+                              : std::popcount(unsigned(mask));
+            }
+#endif
+        } else if constexpr (std::is_same_v<T, float>) {
+            const __m128 k = _mm_set1_ps(key);
+
+            for (; i + 4 <= n; i += 4) {
+                __m128 v   = _mm_loadu_ps(keys + i);
+                __m128 cmp = Upper ? _mm_cmple_ps(v, k) : _mm_cmplt_ps(v, k);
+                rank += std::popcount(unsigned(_mm_movemask_ps(cmp)));
+            }
+        } else if constexpr (std::is_same_v<T, double>) {
+            const __m128d k = _mm_set1_pd(key);
+
+            for (; i + 2 <= n; i += 2) {
+                __m128d v   = _mm_loadu_pd(keys + i);
+                __m128d cmp = Upper ? _mm_cmple_pd(v, k) : _mm_cmplt_pd(v, k);
+                rank += std::popcount(unsigned(_mm_movemask_pd(cmp)));
+            }
+        }
+        // NOTE: without SSE4.2 there is no 64-bit integer compare; those are
+        // counted below
+#endif
+
+        for (; i < n; ++i) {
+            rank += Upper ? !(key < keys[i]) : keys[i] < key;
+        }
+
+        return rank;
+    }
+
+    template <bool Upper, typename Key>
+    Position bound_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        Position bound{nullptr, 0};
+
+        for (Node* node = root_; node != nullptr;) {
+            size_t i = rank_of<Upper>(node, key);
+            if (i < node->count) bound = {node, i};
+
+            node = node->leaf ? nullptr : as_inner(node)->children[i];
+        }
+
+        return bound;
+    }
+
+    template <typename Key>
+    iterator find_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        Position pos = bound_of<false>(key);
+        if (pos.node != nullptr && compare_(key, pos.node->key(pos.index))) {
+            pos = {nullptr, 0};
+        }
+        return iterator{this, pos};
+    }
+
+    // moves data into node at index, moving the elements from there on one
+    // to the right
+    static void insert_key(Node* node, size_t index, T&& data) noexcept
+    {
+        T*     keys = node->keys();
+        size_t n    = node->count;
+
+        if (index == n) {
+            std::construct_at(keys + n, std::move(data));
+        } else {
+            std::construct_at(keys + n, std::move(keys[n - 1]));
+            std::move_backward(keys + index, keys + n - 1, keys + n);
+            keys[index] = std::move(data);
+        }
+
+        ++node->count;
+    }
+
+    // destroys the element of node at index, moving the ones after it one to
+    // the left
+    static void erase_key(Node* node, size_t index) noexcept
+    {
+        T*     keys = node->keys();
+        size_t n    = node->count;
+
+        std::move(keys + index + 1, keys + n, keys + index);
+        std::destroy_at(keys + n - 1);
+
+        --node->count;
+    }
+
+    // moves the elements [from, from + n) of src to the (unconstructed)
+    // elements from to on of dst; the counts are left to the caller
+    static void
+    relocate(Node* src, size_t from, size_t n, Node* dst, size_t to) noexcept
+    {
+        std::uninitialized_move_n(src->keys() + from, n, dst->keys() + to);
+        std::destroy_n(src->keys() + from, n);
+    }
+
+    /* splits the full child at index of parent: the elements after the one
+     * in the middle go to a new node right of it, and the middle one goes up
+     * into parent (which is not full)
+     *
+     * NOTE: the new node is allocated before anything changes */
+    void split_child(Inner* parent, size_t index)
+    {
+        Node* child   = parent->children[index];
+        Node* sibling = child->leaf ? make_leaf()
+                                    : static_cast<Node*>(make_inner());
+
+        relocate(child, min_keys + 1, min_keys, sibling, 0);
+        sibling->count = static_cast<std::uint16_t>(min_keys);
+
+        if (!child->leaf) {
+            for (size_t i = 0; i <= min_keys; ++i) {
+                set_child(as_inner(sibling),
+                          i,
+                          as_inner(child)->children[min_keys + 1 + i]);
+            }
+        }
+
+        insert_key(parent, index, std::move(child->key(min_keys)));
+        std::destroy_at(child->keys() + min_keys);
+        child->count = static_cast<std::uint16_t>(min_keys);
+
+        for (size_t i = parent->count; i > index + 1; --i) {
+            set_child(parent, i, parent->children[i - 1]);
+        }
+        set_child(parent, index + 1, sibling);
+    }
+
+    /* inserts data after the elements equivalent to it
+     *
+     * the full nodes on the way down are split before they are descended
+     * into; so there is always room for the element that a split moves up,
+     * and the tree only grows at the root */
+    Position insert_value(T&& data)
+    {
+        if (root_ == nullptr) root_ = make_leaf();
+
+        if (root_->count == node_capacity) {
+            Inner* root = make_inner();
+            set_child(root, 0, root_);
+
+            try {
+                split_child(root, 0);
+            } catch (...) {
+                root_->parent = nullptr;
+                free_node(root);
+                throw;
+            }
+
+            root_ = root;
+        }
+
+        Node* node = root_;
+
+        while (!node->leaf) {
+            Inner* inner = as_inner(node);
+            size_t i     = rank_of<true>(inner, data);
+
+            if (inner->children[i]->count == node_capacity) {
+                split_child(inner, i);
+                if (!compare_(data, inner->key(i))) ++i;
+            }
+
+            node = inner->children[i];
+        }
+
+        size_t i = rank_of<true>(node, data);
+        insert_key(node, i, std::move(data));
+        ++size_;
+
+        return {node, i};
+    }
+
+    // SEE: emplace_hint
+    Position insert_hinted(Position hint, T&& data)
+    {
+        if (root_ == nullptr) return insert_value(std::move(data));
+
+        // the slot right before an element of an inner node (or end()) is
+        // past the last element of the rightmost leaf left of it
+        Node*  leaf  = hint.node;
+        size_t index = hint.index;
+        if (leaf == nullptr) {
+            leaf  = rightmost(root_);
+            index = leaf->count;
+        } else if (!leaf->leaf) {
+            leaf  = rightmost(as_inner(leaf)->children[index]);
+            index = leaf->count;
+        }
+
+        if (leaf->count == node_capacity) return insert_value(std::move(data));
+
+        // the neighbours data has to fit between; either is null at the ends
+        Position before = index > 0 ? Position{leaf, index - 1}
+                                    : prev(Position{leaf, 0});
+
+        if ((hint.node == nullptr
+             || !compare_(hint.node->key(hint.index), data))
+            && (before.node == nullptr
+                || !compare_(data, before.node->key(before.index)))) {
+            insert_key(leaf, index, std::move(data));
+            ++size_;
+            return {leaf, index};
+        }
+
+        return insert_value(std::move(data));
+    }
+
+    /* erases the element at pos and returns the position of the element after
+     * it
+     *
+     * an element of an inner node is replaced by the element after it (the
+     * first one of a leaf), which is erased from its leaf instead; a leaf left
+     * with fewer than min_keys elements then borrows one from a sibling (by
+     * way of the parent), or is merged with a sibling (and the element
+     * between them), which may leave the parent short in turn
+     *
+     * the elements move while this happens; so the position of the element
+     * after pos is moved along with it */
+    Position erase_at(Position pos) noexcept
+    {
+        Node* leaf = pos.node;
+
+        if (!leaf->leaf) {
+            leaf = leftmost(as_inner(leaf)->children[pos.index + 1]);
+            pos.node->key(pos.index) = std::move(leaf->key(0));
+            erase_key(leaf, 0);
+        } else {
+            erase_key(leaf, pos.index);
+        }
+
+        --size_;
+
+        Node* node = leaf;
+        while (node != root_ && node->count < min_keys) {
+            Inner* parent = node->parent;
+            size_t index  = node->index;
+
+            if (index > 0 && parent->children[index - 1]->count > min_keys) {
+                borrow_left(parent, index - 1, pos);
+                break;
+            }
+
+            if (index < parent->count
+                && parent->children[index + 1]->count > min_keys) {
+                borrow_right(parent, index, pos);
+                break;
+            }
+
+            merge(parent, index > 0 ? index - 1 : index, pos);
+            node = parent;
+        }
+
+        if (root_->count == 0) {
+            Node* root = root_;
+
+            root_ = root->leaf ? nullptr : as_inner(root)->children[0];
+            if (root_ != nullptr) root_->parent = nullptr;
+
+            // NOTE: the only position in an empty root is end()
+            if (pos.node == root) pos = {nullptr, 0};
+
+            free_node(root);
+        }
+
+        if (pos.node != nullptr && pos.index == pos.node->count) {
+            pos = climb_right(pos.node);
+        }
+
+        return pos;
+    }
+
+    // moves the last element of the left child of separator up into parent,
+    // and the separator down in front of the right child
+    void borrow_left(Inner* parent, size_t separator, Position& pos) noexcept
+    {
+        Node*  left  = parent->children[separator];
+        Node*  right = parent->children[separator + 1];
+        size_t last  = left->count - size_t{1};
+
+        insert_key(right, 0, std::move(parent->key(separator)));
+        parent->key(separator) = std::move(left->key(last));
+        std::destroy_at(left->keys() + last);
+        --left->count;
+
+        if (!right->leaf) {
+            Inner* to = as_inner(right);
+            for (size_t i = right->count; i > 0; --i) {
+                set_child(to, i, to->children[i - 1]);
+            }
+            set_child(to, 0, as_inner(left)->children[last + 1]);
+            as_inner(left)->children[last + 1] = nullptr;
+        }
+
+        if (pos.node == right) {
+            ++pos.index;
+        } else if (pos == Position{parent, separator}
+                   || pos == Position{left, last + 1}) {
+            pos = {right, 0};
+        } else if (pos == Position{left, last}) {
+            pos = {parent, separator};
+        }
+    }
+
+    // moves the first element of the right child of separator up into
+    // parent, and the separator down behind the left child
+    void borrow_right(Inner* parent, size_t separator, Position& pos) noexcept
+    {
+        Node*  left  = parent->children[separator];
+        Node*  right = parent->children[separator + 1];
+        size_t end   = left->count;
+
+        std::construct_at(left->keys() + end,
+                          std::move(parent->key(separator)));
+        ++left->count;
+        parent->key(separator) = std::move(right->key(0));
+        erase_key(right, 0);
+
+        if (!left->leaf) {
+            Inner* from = as_inner(right);
+            set_child(as_inner(left), end + 1, from->children[0]);
+            for (size_t i = 0; i <= right->count; ++i) {
+                set_child(from, i, from->children[i + 1]);
+            }
+            from->children[right->count + 1] = nullptr;
+        }
+
+        if (pos == Position{parent, separator}) {
+            pos = {left, end};
+        } else if (pos == Position{right, 0}) {
+            pos = {parent, separator};
+        } else if (pos.node == right) {
+            --pos.index;
+        }
+    }
+
+    // merges the right child of separator (and separator) into the left one
+    void merge(Inner* parent, size_t separator, Position& pos) noexcept
+    {
+        Node*  left  = parent->children[separator];
+        Node*  right = parent->children[separator + 1];
+        size_t end   = left->count;
+
+        std::construct_at(left->keys() + end,
+                          std::move(parent->key(separator)));
+        relocate(right, 0, right->count, left, end + 1);
+
+        if (!left->leaf) {
+            for (size_t i = 0; i <= right->count; ++i) {
+                set_child(as_inner(left),
+                          end + 1 + i,
+                          as_inner(right)->children[i]);
+            }
+        }
+
+        left->count = static_cast<std::uint16_t>(end + 1 + right->count);
+
+        erase_key(parent, separator);
+        for (size_t i = separator + 1; i <= parent->count; ++i) {
+            set_child(parent, i, parent->children[i + 1]);
+        }
+        parent->children[parent->count + 1] = nullptr;
+
+        if (pos == Position{parent, separator}) {
+            pos = {left, end};
+        } else if (pos.node == parent && pos.index > separator) {
+            --pos.index;
+        } else if (pos.node == right) {
+            pos = {left, end + 1 + pos.index};
+        }
+
+        right->count = 0;
+        free_node(right);
+    }
+
+    template <typename Data>
+    iterator replace(const_iterator pos, Data&& data)
+    {
+        T& key = pos.position().node->key(pos.index_);
+
+        if (!compare_(key, data) && !compare_(data, key)) {
+            // the element keeps its place; only the data changes
+            key = std::forward<Data>(data);
+            return pos;
+        }
+
+        // NOTE: data may refer to an element of the tree; so it is taken
+        // before anything moves
+        T value(std::forward<Data>(data));
+        erase(pos);
+        return emplace(std::move(value));
+    }
+
+    Node* clone(const Node* that)
+    {
+        Node* node = that->leaf ? make_leaf()
+                                : static_cast<Node*>(make_inner());
+
+        try {
+            for (; node->count < that->count; ++node->count) {
+                std::construct_at(node->keys() + node->count,
+                                  that->key(node->count));
+            }
+
+            if (!that->leaf) {
+                for (size_t i = 0; i <= that->count; ++i) {
+                    set_child(as_inner(node),
+                              i,
+                              clone(as_inner(that)->children[i]));
+                }
+            }
+        } catch (...) {
+            destroy_subtree(node);
+            throw;
+        }
+
+        return node;
+    }
+
+    /* builds a subtree of exactly the given height from the next n elements
+     * of it
+     *
+     * an inner node gets as few children as can hold n, but at least two;
+     * the elements left over once every child but the last is followed by an
+     * element of the node are spread evenly over the children */
+    template <typename ForwardIterator>
+    Node* build_sorted(ForwardIterator& it, size_t n, size_t height)
+    {
+        if (height == 1) {
+            Node* leaf = make_leaf();
+
+            try {
+                for (; leaf->count < n; ++leaf->count, ++it) {
+                    std::construct_at(leaf->keys() + leaf->count, *it);
+                }
+            } catch (...) {
+                destroy_subtree(leaf);
+                throw;
+            }
+
+            return leaf;
+        }
+
+        size_t below    = subtree_capacity(height - 1);
+        size_t children = std::max<size_t>(2, n / (below + 1) + 1);
+        size_t spread   = n - (children - 1);
+
+        Inner* node = make_inner();
+
+        try {
+            for (size_t i = 0; i < children; ++i) {
+                size_t share = spread / children + (i < spread % children);
+                set_child(node, i, build_sorted(it, share, height - 1));
+
+                if (i + 1 < children) {
+                    std::construct_at(node->keys() + i, *it);
+                    ++node->count;
+                    ++it;
+                }
+            }
+        } catch (...) {
+            destroy_subtree(node);
+            throw;
+        }
+
+        return node;
+    }
+
+    template <Order order, typename Visitor, typename... Args>
+    static void walk(const Node* node, Visitor& visit, Args&... args)
+    {
+        if constexpr (order == Order::pre) {
+            for (size_t i = 0; i < node->count; ++i) {
+                visit(node->key(i), args...);
+            }
+        }
+
+        for (size_t i = 0; i <= node->count; ++i) {
+            if (!node->leaf) {
+                walk<order>(as_inner(node)->children[i], visit, args...);
+            }
+
+            if constexpr (order == Order::in) {
+                if (i < node->count) visit(node->key(i), args...);
+            }
+        }
+
+        if constexpr (order == Order::post) {
+            for (size_t i = 0; i < node->count; ++i) {
+                visit(node->key(i), args...);
+            }
+        }
+    }
+};
+
+#endif // B_TREE_H
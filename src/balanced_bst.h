@@ -5,18 +5,25 @@
 
 template <typename T,
           typename Compare   = std::less<T>,
-          typename Allocator = std::allocator<T>>
-class balanced_bst : public bst<T, Compare, Allocator>
+          typename Allocator = std::allocator<T>,
+          typename Augment   = void>
+class balanced_bst : public bst<T, Compare, Allocator, Augment>
 {
   private:
-    using bst      = bst<T, Compare, Allocator>;
+    using bst      = ::bst<T, Compare, Allocator, Augment>;
     using Sentinel = typename bst::Sentinel;
     using BstNode  = typename bst::BstNode;
 
+    using DataFactory = typename bst::DataFactory;
+
   public:
     balanced_bst()          = delete;
     virtual ~balanced_bst() = default;
 
+    balanced_bst(balanced_bst&&) noexcept            = default;
+    balanced_bst& operator=(const balanced_bst&)     = default;
+    balanced_bst& operator=(balanced_bst&&) noexcept = default;
+
   protected:
     explicit balanced_bst(Sentinel* alloc)
         : bst{alloc}
@@ -26,96 +33,121 @@ class balanced_bst : public bst<T, Compare, Allocator>
     struct BalancedBstNode : public BstNode { // NOLINT
         BalancedBstNode() = default;
 
-        BalancedBstNode(const T&  data,
-                        Sentinel* owner) noexcept(noexcept(BstNode{data,
-                                                                   owner}))
-            : BstNode{data, owner}
+        explicit BalancedBstNode(const DataFactory& data)
+            : BstNode{data}
         {
         }
 
-        BalancedBstNode(const BalancedBstNode& that,
-                        Sentinel* owner) noexcept(noexcept(BstNode{that,
-                                                                   owner}))
-            : BstNode{that, owner}
+        BalancedBstNode(const BalancedBstNode& that) noexcept(
+            noexcept(BstNode{that}))
+            : BstNode{that}
         {
         }
+    };
 
-        void left_rotate() noexcept
-        {
-            /*
-             * example: T is this node and P is T's parent (if any)
-             *
-             * notice how the result is that the right subtree rooted at B (if
-             * any) is moved up a level; the height of the portion of the tree
-             * that is actually shown does not change, but the height of the
-             * nodes of the right subtree rooted at B will be one less as long
-             * as they exist
-             *
-             *                 ...                ...
-             *                  |                  |
-             *                  P                  P
-             *                 / \                / \
-             *                T  ...             B  ...
-             *               / \        -->     / \
-             *              A   B              T  ...
-             *                 / \            / \
-             *                C  ...         A   C
-             */
-
-            // we are "rotating" T and its right child, B, to the left
-            BstNode* child = this->right;
-
-            // T will become B's left child (because T is less than B), however
-            // we can't make C the right child of B (because C is less than B)
-            //
-            // but T is less than C so we can make it T's right child (the
-            // position formerly held by B)
-            this->right = child->left;
-            if (child->left != nullptr) child->left->parent = this;
-
-            // move B to T's old position
-            child->parent = this->parent;
-            // NOTE: we have to consider the parent of T and it is possible that
-            // T is the root
-            if (this->parent == nullptr) {
-                this->owner->root = child;
-            } else if (this == this->parent->left) {
-                this->parent->left = child;
-            } else {
-                this->parent->right = child;
-            }
-
-            // make T the left child of B
-            child->left  = this;
-            this->parent = child;
+    /* the rotations belong to the tree rather than to the nodes; rotating at
+     * the root has to update the root held by the Sentinel, and nodes do not
+     * know which Sentinel they belong to */
+    void left_rotate(BstNode* node) noexcept
+    {
+        left_rotate(node, this->sentinel_->root);
+    }
+
+    void right_rotate(BstNode* node) noexcept
+    {
+        right_rotate(node, this->sentinel_->root);
+    }
+
+    /* as above, but a rotation at the top updates root instead; so that a
+     * detached subtree (e.g., one being joined) can be rotated without
+     * touching the tree it came from */
+    static void left_rotate(BstNode* node, BstNode*& root) noexcept
+    {
+        /*
+         * example: T is node and P is T's parent (if any)
+         *
+         * notice how the result is that the right subtree rooted at B (if
+         * any) is moved up a level; the height of the portion of the tree
+         * that is actually shown does not change, but the height of the
+         * nodes of the right subtree rooted at B will be one less as long
+         * as they exist
+         *
+         *                 ...                ...
+         *                  |                  |
+         *                  P                  P
+         *                 / \                / \
+         *                T  ...             B  ...
+         *               / \        -->     / \
+         *              A   B              T  ...
+         *                 / \            / \
+         *                C  ...         A   C
+         */
+
+        // NOTE: only the addresses held by the parent links change here;
+        // a ParentLink keeps its tag across assignment, so any per-node
+        // flag stored in it (e.g., a color) stays with its node
+
+        // we are "rotating" T and its right child, B, to the left
+        BstNode* child = node->right;
+
+        // T will become B's left child (because T is less than B), however
+        // we can't make C the right child of B (because C is less than B)
+        //
+        // but T is less than C so we can make it T's right child (the
+        // position formerly held by B)
+        node->right = child->left;
+        if (child->left != nullptr) child->left->parent = node;
+
+        // move B to T's old position
+        child->parent = node->parent;
+        // NOTE: we have to consider the parent of T and it is possible that
+        // T is the root
+        if (node->parent == nullptr) {
+            root = child;
+        } else if (node == node->parent->left) {
+            node->parent->left = child;
+        } else {
+            node->parent->right = child;
         }
 
-        void right_rotate() noexcept
-        {
-            // SEE: the explanation provided for left_rotate; this situation is
-            // symmetric
+        // make T the left child of B
+        child->left  = node;
+        node->parent = child;
 
-            BstNode* child = this->left;
+        // T is now below B; so it has to be brought up to date first
+        bst::update_augment(node);
+        bst::update_augment(child);
+    }
+
+    static void right_rotate(BstNode* node, BstNode*& root) noexcept
+    {
+        // SEE: the explanation provided for left_rotate; node situation is
+        // symmetric
 
-            this->left = child->right;
-            if (child->right != nullptr) child->right->parent = this;
+        BstNode* child = node->left;
 
-            child->parent = this->parent;
-            if (this->parent == nullptr) {
-                this->owner->root = child;
-            } else if (this == this->parent->right) {
-                this->parent->right = child;
-            } else {
-                this->parent->left = child;
-            }
+        node->left = child->right;
+        if (child->right != nullptr) child->right->parent = node;
 
-            child->right = this;
-            this->parent = child;
+        child->parent = node->parent;
+        if (node->parent == nullptr) {
+            root = child;
+        } else if (node == node->parent->right) {
+            node->parent->right = child;
+        } else {
+            node->parent->left = child;
         }
-    };
+
+        child->right = node;
+        node->parent = child;
+
+        bst::update_augment(node);
+        bst::update_augment(child);
+    }
 
     virtual void post_insert(BalancedBstNode* node) = 0;
-    virtual void post_erase(BalancedBstNode* node)  = 0;
+    virtual void post_erase(BalancedBstNode* node,
+                            BalancedBstNode* parent) = 0;
 };
 
 #endif // BALANCED_BST_H
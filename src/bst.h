@@ -1,115 +1,261 @@
 #ifndef BST_H
 #define BST_H
 
+#include "work_stealing_pool.h"
+
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <new>
 #include <stack>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+/* augmentations a tree can be given as its Augment parameter
+ *
+ * order_statistics keeps the size of every subtree in its root; this makes
+ * select, rank and distance (and count) O(log n) at the cost of a word per
+ * node
+ *
+ * any other Augment is a monoid whose value is kept for every subtree (along
+ * with its size) so that aggregate(first, last) is O(log n); it provides
+ *
+ *   using value_type = ...;
+ *   static value_type identity();
+ *   static value_type lift(const T& data);
+ *   static value_type combine(const value_type& lhs, const value_type& rhs);
+ *
+ * combine has to be associative (but not necessarily commutative; values are
+ * combined in order) with identity as its identity element
+ *
+ * NOTE: the values are recomputed inside the rotations, which cannot fail; so
+ * none of these may throw */
+struct order_statistics {};
+
+template <typename V>
+struct sum_aggregate {
+    using value_type = V;
+
+    static V identity() noexcept { return V{}; }
+
+    template <typename U>
+    static V lift(const U& data) noexcept
+    {
+        return static_cast<V>(data);
+    }
+
+    static V combine(const V& lhs, const V& rhs) noexcept { return lhs + rhs; }
+};
+
+template <typename V>
+struct min_aggregate {
+    using value_type = V;
+
+    static V identity() noexcept { return std::numeric_limits<V>::max(); }
+
+    template <typename U>
+    static V lift(const U& data) noexcept
+    {
+        return static_cast<V>(data);
+    }
+
+    static V combine(const V& lhs, const V& rhs) noexcept
+    {
+        return std::min(lhs, rhs);
+    }
+};
+
+template <typename V>
+struct max_aggregate {
+    using value_type = V;
+
+    static V identity() noexcept { return std::numeric_limits<V>::lowest(); }
+
+    template <typename U>
+    static V lift(const U& data) noexcept
+    {
+        return static_cast<V>(data);
+    }
+
+    static V combine(const V& lhs, const V& rhs) noexcept
+    {
+        return std::max(lhs, rhs);
+    }
+};
 
 template <typename T,
           typename Compare   = std::less<T>,
-          typename Allocator = std::allocator<T>>
+          typename Allocator = std::allocator<T>,
+          typename Augment   = void>
 class bst
 {
   protected:
     struct Sentinel;
     struct BstNode;
 
-    // base class for Sentinel and BstNode
-    struct Node { // NOLINT
-        Node() = default;
-
-        explicit Node(Sentinel* owner) noexcept
-            : owner{owner}
-        {
-        }
-
-        [[nodiscard]] inline bool is_data() const noexcept
-        {
-            return this != owner;
-        }
-
-        const Node* successor() const noexcept
-        {
-            if (is_data()) [[likely]] {
-                auto* node = static_cast<const BstNode*>(this);
+    static constexpr bool augmented = !std::is_void_v<Augment>;
 
-                // if there is a right subtree, then we return the minumum of
-                // that subtree; as that is the next in-order node
-                if (node->right != nullptr) return node->right->min();
+    // true if Augment is a monoid; SEE: order_statistics
+    static constexpr bool aggregated = requires {
+        typename Augment::value_type;
+    };
 
-                // otherwise we must traverse up the tree until we reach the
-                // root of a left subtree; we have exhasted the traversal of
-                // that subtree, so the next in-order node is it's root
-                BstNode* parent = node->parent;
+    // true if Compare can order T against other key types (e.g., std::less<>);
+    // the lookups then accept any such key without building a T from it
+    static constexpr bool transparent = requires {
+        typename Compare::is_transparent;
+    };
 
-                while (parent != nullptr && node == parent->right) {
-                    node   = parent;
-                    parent = parent->parent;
-                }
+    /* searching needs to tell "less", "equal" and "greater" apart; with only
+     * Compare that costs two calls, so a three-way comparison is used when
+     * one is available:
+     *
+     *   - Compare may supply its own as a member compare(lhs, rhs) returning
+     *     an ordering (or an int compared against 0)
+     *   - otherwise, if Compare is std::less then the operands' operator<=>
+     *     agrees with it and is used instead */
+    template <typename Lhs, typename Rhs>
+    static constexpr bool custom_three_way =
+        requires(const Compare& cmp, const Lhs& lhs, const Rhs& rhs) {
+            cmp.compare(lhs, rhs) < 0;
+            cmp.compare(lhs, rhs) == 0;
+        };
 
-                // if we have exhasted all the nodes then we return the Sentinel
-                if (parent == nullptr) return owner;
+    template <typename Lhs, typename Rhs>
+    static constexpr bool three_way =
+        custom_three_way<Lhs, Rhs>
+        || ((std::is_same_v<Compare, std::less<T>>
+             || std::is_same_v<Compare, std::less<>>)
+            && std::three_way_comparable_with<Lhs, Rhs>);
+
+    template <typename Lhs, typename Rhs>
+        requires custom_three_way<Lhs, Rhs>
+    static auto order(const Compare& cmp, const Lhs& lhs, const Rhs& rhs)
+        noexcept(noexcept(cmp.compare(lhs, rhs)))
+    {
+        return cmp.compare(lhs, rhs);
+    }
 
-                return parent;
-            }
+    template <typename Lhs, typename Rhs>
+        requires(three_way<Lhs, Rhs> && !custom_three_way<Lhs, Rhs>)
+    static auto order(const Compare& /*cmp*/, const Lhs& lhs, const Rhs& rhs)
+        noexcept(noexcept(std::compare_three_way{}(lhs, rhs)))
+    {
+        return std::compare_three_way{}(lhs, rhs);
+    }
 
-            // otherwise, if this node is the Sentinel then the next node should
-            // be the first in-order node (i.e., the minimum)
-            return static_cast<const Sentinel*>(this)->min;
+    template <typename Key>
+    static constexpr bool nothrow_compare =
+        noexcept(std::declval<const Compare&>()(std::declval<const Key&>(),
+                                                std::declval<const T&>()))
+        && noexcept(std::declval<const Compare&>()(std::declval<const T&>(),
+                                                   std::declval<const Key&>()))
+        && (!three_way<Key, T>
+            || requires(const Compare& cmp, const Key& key, const T& data) {
+                   { order(cmp, key, data) } noexcept;
+               });
+
+    // neither lhs < rhs nor rhs < lhs; in a single comparison when possible
+    static bool equivalent(const Compare& cmp,
+                           const T&       lhs,
+                           const T&       rhs) noexcept(nothrow_compare<T>)
+    {
+        if constexpr (three_way<T, T>) {
+            return order(cmp, lhs, rhs) == 0;
+        } else {
+            return !cmp(lhs, rhs) && !cmp(rhs, lhs);
         }
+    }
 
-        const Node* predecessor() const noexcept
+    /* builds the data of a new node in place
+     *
+     * make_node is virtual (only the derived tree knows its node type), so
+     * the constructor arguments are passed to it type-erased; the T returned
+     * by operator() initializes the node's data directly (no copy or move) */
+    class DataFactory
+    {
+      public:
+        // args is a tuple of references to the constructor arguments
+        template <typename Args>
+        explicit DataFactory(Args& args) noexcept
+            : build_{&build<Args>}
+            , args_{std::addressof(args)}
         {
-            // SEE: the notes in successor; the explanation for this method is
-            // symmetric to the one provided for that method
-            if (is_data()) [[likely]] {
-                auto* node = static_cast<const BstNode*>(this);
-
-                if (node->left) return node->left->max();
-
-                BstNode* parent = node->parent;
-
-                while (parent != nullptr && node == parent->left) {
-                    node   = parent;
-                    parent = parent->parent;
-                }
+        }
 
-                if (parent == nullptr) return owner;
+        T operator()() const { return build_(args_); }
 
-                return parent;
-            }
+      private:
+        T (*build_)(void*);
+        void* args_;
 
-            return static_cast<const Sentinel*>(this)->max;
+        template <typename Args>
+        static T build(void* args)
+        {
+            return std::make_from_tuple<T>(
+                std::move(*static_cast<Args*>(args)));
         }
+    };
 
-        Sentinel* owner{nullptr};
+    /* base class for Sentinel and BstNode
+     *
+     * it carries no data; it only lets iterators (and the min/max of the
+     * Sentinel) refer to either a node holding data or the past-the-end
+     * position */
+    struct Node { // NOLINT
     };
 
     /* this class contains the root of the tree, but also acts as the
      * past-the-end node
      *
-     * nodes holding data shall keep a reference to the Sentinel that contains
-     * its root so that it can be iterated to
+     * nodes holding data do not know which Sentinel they belong to; iterators
+     * carry it instead so that they can step to (and back from) the
+     * past-the-end position
      *
      * also it holds reference to the min and max nodes of the tree so that they
-     * may subsequently be iterated to */
+     * may subsequently be iterated to
+     *
+     * the comparator lives here as well; it is constructed once per tree so
+     * it may carry state (an empty one takes up no space) */
     struct Sentinel : public Node { // NOLINT
-        Sentinel() noexcept
-            : Node{this}
+        explicit Sentinel(const Compare& compare)
+            : compare{compare}
         {
         }
 
         virtual ~Sentinel() = default;
 
-        virtual BstNode* make_node(const T& data)       = 0;
-        virtual BstNode* make_node(const BstNode& node) = 0;
-        virtual void     destroy_node(BstNode* node)    = 0;
+        virtual BstNode* make_node(const DataFactory& data) = 0;
+        virtual BstNode* make_node(const BstNode& node)     = 0;
+        virtual void     destroy_node(BstNode* node)        = 0;
+
+        // keeps the storage of the nodes of that alive for as long as this
+        // Sentinel holds on to it; nodes can then be moved over from that
+        virtual void adopt_storage(const Sentinel& that) = 0;
+
+        // the number of storage arenas held on to; SEE: BstAllocator
+        virtual size_t arena_count() const noexcept = 0;
+
+        // a new node whose data is constructed from args
+        template <typename... Args>
+        BstNode* emplace_node(Args&&... args)
+        {
+            std::tuple<Args&&...> packed{std::forward<Args>(args)...};
+            return make_node(DataFactory{packed});
+        }
 
         void copy(Sentinel* that)
         {
@@ -159,11 +305,40 @@ class bst
             this->size = that->size;
         }
 
-        inline void clear()
+        virtual void clear()
         {
-            postorder_visit(this->root, [this](BstNode* node) {
-                this->destroy_node(node);
-            });
+            teardown(this->root,
+                     [this](BstNode* node) { this->destroy_node(node); });
+        }
+
+        /* visits every node below node in post-order, detaching each one from
+         * its parent before it is handed to dispose
+         *
+         * the parent pointers are enough to find the way back up, so unlike
+         * postorder_visit no stack is needed */
+        template <typename Dispose>
+        static void teardown(BstNode* node, Dispose&& dispose)
+        {
+            while (node != nullptr) {
+                if (node->left != nullptr) {
+                    node = node->left;
+                } else if (node->right != nullptr) {
+                    node = node->right;
+                } else {
+                    BstNode* parent = node->parent;
+
+                    if (parent != nullptr) {
+                        if (node == parent->left) {
+                            parent->left = nullptr;
+                        } else {
+                            parent->right = nullptr;
+                        }
+                    }
+
+                    dispose(node);
+                    node = parent;
+                }
+            }
         }
 
         inline void reset() noexcept
@@ -209,12 +384,32 @@ class bst
             }
         }
 
-        const BstNode* find(const T& data) const
-            noexcept(noexcept(Compare{}(data, data)))
+        template <typename Key>
+        const BstNode* find(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            if (this->root == nullptr) return nullptr;
+            return this->root->find(this->compare, key);
+        }
+
+        template <typename Key>
+        const BstNode* lower_bound(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            if (this->root == nullptr) return nullptr;
+            return this->root->lower_bound(this->compare, key);
+        }
+
+        template <typename Key>
+        const BstNode* upper_bound(const Key& key) const
+            noexcept(nothrow_compare<Key>)
         {
-            return this->root->find(data);
+            if (this->root == nullptr) return nullptr;
+            return this->root->upper_bound(this->compare, key);
         }
 
+        [[no_unique_address]] Compare compare;
+
         BstNode* root{nullptr};
 
         Node* min{this};
@@ -223,54 +418,353 @@ class bst
         size_t size{0};
     };
 
+    /* nodes are handed out from contiguous slabs obtained through
+     * NodeAllocator; freed nodes are threaded onto a free list and are reused
+     * before the current slab is bumped
+     *
+     * the slabs are only given back by clear (and on destruction); when the
+     * nodes are trivially destructible that is done without visiting the
+     * nodes at all
+     *
+     * the slabs are grouped into reference counted arenas; a tree that takes
+     * over nodes of another tree (SEE: adopt_storage) shares the other tree's
+     * arenas, so they are given back once neither of the trees uses them any
+     * more; every tree bumps (and recycles into) its own arena only, so trees
+     * sharing arenas may still be used from different threads
+     *
+     * NOTE: an arena is held on to for as long as the tree may use it; so
+     * trees that keep taking over each other's nodes (e.g., the shards of a
+     * sharded_tree) gather arenas until they are cleared or compacted (SEE:
+     * bst::compact) */
     template <typename NodeAllocator>
     struct BstAllocator : public NodeAllocator, public Sentinel { // NOLINT
         using NodeTraits = std::allocator_traits<NodeAllocator>;
         using NodeType   = typename NodeTraits::value_type;
 
-        BstNode* make_node(const T& data) override
+        explicit BstAllocator(const Compare& compare)
+            : Sentinel{compare}
+        {
+        }
+
+        BstAllocator(const BstAllocator&)            = delete;
+        BstAllocator& operator=(const BstAllocator&) = delete;
+
+        ~BstAllocator() override { release(); }
+
+        BstNode* make_node(const DataFactory& data) override
         {
-            auto* node = NodeTraits::allocate(*this, 1);
-            NodeTraits::construct(*this,
-                                  static_cast<NodeType*>(node),
-                                  data,
-                                  this);
+            NodeType* node = acquire();
+            try {
+                NodeTraits::construct(*this, node, data);
+            } catch (...) {
+                recycle(node);
+                throw;
+            }
             return node;
         }
 
+        // NOTE: only a tree of a T that can be copied can be copied (SEE:
+        // bst(const bst&)); so for any other T this is never called
         BstNode* make_node(const BstNode& node) override
         {
-            auto* copy = NodeTraits::allocate(*this, 1);
-            NodeTraits::construct(*this,
-                                  copy,
-                                  static_cast<const NodeType&>(node),
-                                  this);
-            return copy;
+            if constexpr (std::is_copy_constructible_v<T>) {
+                NodeType* copy = acquire();
+                try {
+                    NodeTraits::construct(*this,
+                                          copy,
+                                          static_cast<const NodeType&>(node));
+                } catch (...) {
+                    recycle(copy);
+                    throw;
+                }
+                return copy;
+            } else {
+                static_cast<void>(node);
+                std::terminate();
+            }
         }
 
         void destroy_node(BstNode* node) override
         {
-            NodeTraits::destroy(*this, node);
-            NodeTraits::deallocate(*this, static_cast<NodeType*>(node), 1);
+            NodeTraits::destroy(*this, static_cast<NodeType*>(node));
+            recycle(static_cast<NodeType*>(node));
+        }
+
+        void clear() override
+        {
+            if constexpr (!std::is_trivially_destructible_v<NodeType>) {
+                this->teardown(this->root, [this](BstNode* node) {
+                    NodeTraits::destroy(*this, static_cast<NodeType*>(node));
+                });
+            }
+
+            release();
+        }
+
+        // NOTE: that has to be of the same type as this
+        void adopt_storage(const Sentinel& that) override
+        {
+            const auto& other = static_cast<const BstAllocator&>(that);
+
+            // both are sorted by address; so the union takes a single merge
+            Arenas merged{arenas_.get_allocator()};
+            merged.reserve(arenas_.size() + other.arenas_.size());
+            std::set_union(arenas_.begin(),
+                           arenas_.end(),
+                           other.arenas_.begin(),
+                           other.arenas_.end(),
+                           std::back_inserter(merged));
+            arenas_.swap(merged);
+        }
+
+        size_t arena_count() const noexcept override { return arenas_.size(); }
+
+      private:
+        // a freed node's storage is reused to link it into the free list
+        struct FreeSlot {
+            FreeSlot* next;
+        };
+
+        // the low bit of a node address is used as the ParentLink tag
+        static_assert(alignof(NodeType) > 1);
+        static_assert(sizeof(NodeType) >= sizeof(FreeSlot));
+        static_assert(alignof(NodeType) >= alignof(FreeSlot));
+
+        struct Slab {
+            NodeType* nodes;
+            size_t    count;
+        };
+
+        using SlabAllocator =
+            typename NodeTraits::template rebind_alloc<Slab>;
+
+        struct Arena : public NodeAllocator {
+            explicit Arena(const NodeAllocator& alloc)
+                : NodeAllocator{alloc}
+                , slabs{SlabAllocator{alloc}}
+            {
+            }
+
+            Arena(const Arena&)            = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            ~Arena()
+            {
+                for (const Slab& slab : slabs) {
+                    NodeTraits::deallocate(*this, slab.nodes, slab.count);
+                }
+            }
+
+            std::vector<Slab, SlabAllocator> slabs;
+        };
+
+        using ArenaAllocator =
+            typename NodeTraits::template rebind_alloc<Arena>;
+        using ArenaRefAllocator = typename NodeTraits::template rebind_alloc<
+            std::shared_ptr<Arena>>;
+
+        static constexpr size_t min_slab_nodes{32};
+        static constexpr size_t max_slab_nodes{8192};
+
+        using Arenas = std::vector<std::shared_ptr<Arena>, ArenaRefAllocator>;
+
+        // every arena holding nodes of this tree, sorted by address; own_ is
+        // the one bumped
+        Arenas arenas_;
+        Arena* own_{nullptr};
+
+        FreeSlot* free_{nullptr};
+        NodeType* next_{nullptr};
+        NodeType* end_{nullptr};
+
+        NodeType* acquire()
+        {
+            if (free_ != nullptr) {
+                FreeSlot* slot = free_;
+                free_          = slot->next;
+                return reinterpret_cast<NodeType*>(slot);
+            }
+
+            if (next_ == end_) [[unlikely]] {
+                if (own_ == nullptr) {
+                    arenas_.reserve(arenas_.size() + 1);
+                    auto arena = std::allocate_shared<Arena>(
+                        ArenaAllocator{*this}, *this);
+                    own_ = arena.get();
+                    arenas_.insert(std::lower_bound(arenas_.begin(),
+                                                    arenas_.end(),
+                                                    arena),
+                                   std::move(arena));
+                }
+
+                auto& slabs = own_->slabs;
+
+                // grow geometrically so that small trees stay small
+                size_t count = slabs.empty() ? min_slab_nodes
+                                             : std::min(slabs.back().count * 2,
+                                                        max_slab_nodes);
+
+                slabs.reserve(slabs.size() + 1);
+                NodeType* nodes = NodeTraits::allocate(*this, count);
+                slabs.push_back({nodes, count});
+
+                next_ = nodes;
+                end_  = nodes + count;
+            }
+
+            return next_++;
+        }
+
+        void recycle(NodeType* node) noexcept
+        {
+            free_ = ::new (static_cast<void*>(node)) FreeSlot{free_};
+        }
+
+        void release() noexcept
+        {
+            arenas_.clear();
+            own_ = nullptr;
+
+            free_ = nullptr;
+            next_ = nullptr;
+            end_  = nullptr;
+        }
+    };
+
+    /* the parent link of a BstNode
+     *
+     * nodes are at least pointer aligned, so the low bit of the address is
+     * always zero; it is used to carry a one bit tag for derived trees (e.g.,
+     * the color of a red-black node) so that they do not have to pad the node
+     * with a field of their own
+     *
+     * NOTE: assigning a pointer, or another link, only replaces the address;
+     * the tag belongs to the node holding the link and is left alone */
+    class ParentLink
+    {
+      public:
+        ParentLink() = default;
+
+        ParentLink(BstNode* node) noexcept // NOLINT
+            : bits_{reinterpret_cast<std::uintptr_t>(node)}
+        {
+        }
+
+        ParentLink(const ParentLink& that) = default;
+
+        ParentLink& operator=(BstNode* node) noexcept
+        {
+            bits_ = reinterpret_cast<std::uintptr_t>(node) | (bits_ & tag_bit);
+            return *this;
+        }
+
+        ParentLink& operator=(const ParentLink& that) noexcept
+        {
+            return *this = that.get();
+        }
+
+        operator BstNode*() const noexcept { return get(); } // NOLINT
+
+        BstNode* operator->() const noexcept { return get(); }
+
+        [[nodiscard]] BstNode* get() const noexcept
+        {
+            return reinterpret_cast<BstNode*>(bits_ & ~tag_bit);
         }
+
+        [[nodiscard]] bool tag() const noexcept
+        {
+            return (bits_ & tag_bit) != 0;
+        }
+
+        void set_tag(bool tag) noexcept
+        {
+            bits_ = (bits_ & ~tag_bit) | static_cast<std::uintptr_t>(tag);
+        }
+
+      private:
+        static constexpr std::uintptr_t tag_bit{1};
+
+        std::uintptr_t bits_{0};
+    };
+
+    // the per-node state kept for Augment; empty if there is none
+    struct NoAugment {};
+
+    struct SubtreeSize {
+        size_t subtree_size{1};
     };
 
-    struct BstNode : public Node { // NOLINT
+    template <typename Monoid>
+    struct SubtreeAggregate : public SubtreeSize {
+        typename Monoid::value_type aggregate{Monoid::identity()};
+    };
+
+    using NodeAugment = std::conditional_t<
+        aggregated,
+        SubtreeAggregate<Augment>,
+        std::conditional_t<augmented, SubtreeSize, NoAugment>>;
+
+    struct BstNode : public Node, public NodeAugment { // NOLINT
         BstNode() = default;
 
-        BstNode(const T& data, Sentinel* owner) noexcept(noexcept(T{data}))
-            : Node{owner}
-            , data{data}
+        explicit BstNode(const DataFactory& data)
+            : data{data()}
         {
         }
 
-        BstNode(const BstNode& that,
-                Sentinel*      owner) noexcept(noexcept(T{that.data}))
-            : Node{owner}
+        // NOTE: only the data is copied; the copy is linked into its tree by
+        // the caller
+        BstNode(const BstNode& that) noexcept(noexcept(T{that.data}))
+            : NodeAugment{that}
             , data{that.data}
         {
         }
 
+        BstNode& operator=(const BstNode&) = delete;
+
+        // the next in-order node; or nullptr if this is the maximum
+        const BstNode* successor() const noexcept
+        {
+            const BstNode* node{this};
+
+            // if there is a right subtree, then we return the minumum of
+            // that subtree; as that is the next in-order node
+            if (node->right != nullptr) return node->right->min();
+
+            // otherwise we must traverse up the tree until we reach the
+            // root of a left subtree; we have exhasted the traversal of
+            // that subtree, so the next in-order node is it's root
+            const BstNode* parent = node->parent;
+
+            while (parent != nullptr && node == parent->right) {
+                node   = parent;
+                parent = parent->parent;
+            }
+
+            // if we have exhasted all the nodes then parent is null
+            return parent;
+        }
+
+        // the previous in-order node; or nullptr if this is the minimum
+        const BstNode* predecessor() const noexcept
+        {
+            // SEE: the notes in successor; the explanation for this method is
+            // symmetric to the one provided for that method
+            const BstNode* node{this};
+
+            if (node->left != nullptr) return node->left->max();
+
+            const BstNode* parent = node->parent;
+
+            while (parent != nullptr && node == parent->left) {
+                node   = parent;
+                parent = parent->parent;
+            }
+
+            return parent;
+        }
+
         BstNode* min() noexcept
         {
             BstNode* node{this};
@@ -310,56 +804,96 @@ class bst
             return --h;
         }
 
-        const BstNode* find(const T& data) const
-            noexcept(noexcept(Compare{}(data, data)))
+        // Key is T, or any type Compare orders against T when it is
+        // transparent
+        template <typename Key>
+        const BstNode* find(const Compare& compare, const Key& key) const
+            noexcept(nothrow_compare<Key>)
         {
             const BstNode* node{this};
 
-            auto not_equal = [](const T& lhs, const T& rhs) noexcept(
-                                 noexcept(Compare{}(lhs, rhs))) {
-                return Compare{}(lhs, rhs) != Compare{}(rhs, lhs);
-            };
+            if constexpr (three_way<Key, T>) {
+                // one comparison per level; stop at the first equal node
+                while (node != nullptr) {
+                    auto cmp = order(compare, key, node->data);
+                    if (cmp == 0) return node;
+                    node = cmp < 0 ? node->left : node->right;
+                }
+                return nullptr;
+            } else {
+                // with only Compare at hand descend to the first node that is
+                // not less than key (one comparison per level) and check that
+                // one for equality at the end
+                const BstNode* bound = lower_bound(compare, key);
 
-            while (node != nullptr && not_equal(data, node->data)) {
-                if (Compare{}(data, node->data)) {
-                    node = node->left;
-                } else {
-                    node = node->right;
+                if (bound != nullptr && !compare(key, bound->data)) {
+                    return bound;
                 }
+                return nullptr;
             }
-            return node;
         }
 
-        inline void reset() noexcept
+        // the first node (in-order) whose data is not less than key; or
+        // nullptr if there is none below this node
+        template <typename Key>
+        const BstNode* lower_bound(const Compare& compare, const Key& key) const
+            noexcept(nothrow_compare<Key>)
         {
-            parent = nullptr;
-            left   = nullptr;
-            right  = nullptr;
+            const BstNode* node{this};
+            const BstNode* bound{nullptr};
+
+            while (node != nullptr) {
+                if (compare(node->data, key)) {
+                    node = node->right;
+                } else {
+                    bound = node;
+                    node  = node->left;
+                }
+            }
+
+            return bound;
         }
 
-        friend bool operator<(const BstNode& lhs, const BstNode& rhs) noexcept(
-            noexcept(Compare{}(lhs.data, rhs.data)))
+        // the first node (in-order) whose data is greater than key; or
+        // nullptr if there is none below this node
+        template <typename Key>
+        const BstNode* upper_bound(const Compare& compare, const Key& key) const
+            noexcept(nothrow_compare<Key>)
         {
-            return Compare{}(lhs.data, rhs.data);
+            const BstNode* node{this};
+            const BstNode* bound{nullptr};
+
+            while (node != nullptr) {
+                if (compare(key, node->data)) {
+                    bound = node;
+                    node  = node->left;
+                } else {
+                    node = node->right;
+                }
+            }
+
+            return bound;
         }
 
-        friend bool operator!=(const BstNode& lhs, const BstNode& rhs) noexcept(
-            noexcept(Compare{}(lhs.data, rhs.data)))
+        inline void reset() noexcept
         {
-            return lhs.data < rhs.data != rhs.data < lhs.data;
+            parent = nullptr;
+            left   = nullptr;
+            right  = nullptr;
         }
 
         T data;
 
-        BstNode* parent{nullptr};
-        BstNode* left{nullptr};
-        BstNode* right{nullptr};
+        ParentLink parent;
+        BstNode*   left{nullptr};
+        BstNode*   right{nullptr};
 
         const T* get() const noexcept { return std::addressof(data); }
     };
 
     class ConstBstNodeIterator;
     class MutableIterator;
+    class BstCursor;
 
     // trait type for allocating data type T
     using AllocTraits = std::allocator_traits<Allocator>;
@@ -385,6 +919,11 @@ class bst
 
     using position = MutableIterator;
 
+    using cursor = BstCursor;
+
+    // the most ancestors a cursor keeps; SEE: BstCursor
+    static constexpr size_t cursor_depth{32};
+
   protected:
     /* all statndard input iteartors returned by the methods of bst are "const"
      *
@@ -405,20 +944,24 @@ class bst
         using reference = const T&;
         using pointer   = const T*;
 
-        explicit ConstBstNodeIterator(const Node* node) noexcept
+        ConstBstNodeIterator(const Node*     node,
+                             const Sentinel* sentinel) noexcept
             : node_{node}
+            , sentinel_{sentinel}
         {
         }
 
         ConstBstNodeIterator(const ConstBstNodeIterator& that) noexcept
             : node_{that.node_}
+            , sentinel_{that.sentinel_}
         {
         }
 
         ConstBstNodeIterator& operator=(const Self& that) noexcept
         {
             if (this != &that) {
-                node_ = that.node_;
+                node_     = that.node_;
+                sentinel_ = that.sentinel_;
             }
             return *this;
         }
@@ -435,7 +978,16 @@ class bst
 
         Self& operator++() noexcept
         {
-            node_ = node_->successor();
+            // the Sentinel is a ring position: it follows the maximum and
+            // precedes the minimum
+            if (node_ == sentinel_) [[unlikely]] {
+                node_ = sentinel_->min;
+            } else {
+                const BstNode* next =
+                    static_cast<const BstNode*>(node_)->successor();
+                node_ = next != nullptr ? static_cast<const Node*>(next)
+                                        : static_cast<const Node*>(sentinel_);
+            }
             return *this;
         }
 
@@ -448,7 +1000,14 @@ class bst
 
         Self& operator--() noexcept
         {
-            node_ = node_->predecessor();
+            if (node_ == sentinel_) [[unlikely]] {
+                node_ = sentinel_->max;
+            } else {
+                const BstNode* prev =
+                    static_cast<const BstNode*>(node_)->predecessor();
+                node_ = prev != nullptr ? static_cast<const Node*>(prev)
+                                        : static_cast<const Node*>(sentinel_);
+            }
             return *this;
         }
 
@@ -470,7 +1029,8 @@ class bst
         }
 
       private:
-        const Node* node_;
+        const Node*     node_;
+        const Sentinel* sentinel_;
 
         inline Node* extract() noexcept
         {
@@ -504,6 +1064,16 @@ class bst
             return *this;
         }
 
+        MutableIterator& operator=(T&& data)
+        {
+            if (iter_ == t_->end()) {
+                iter_ = t_->insert(iter_, std::move(data));
+            } else {
+                iter_ = t_->modify(iter_, std::move(data));
+            }
+            return *this;
+        }
+
         MutableIterator& operator=(std::nullptr_t) noexcept
         {
             iter_ = t_->erase(iter_);
@@ -522,9 +1092,128 @@ class bst
         }
     };
 
-    // Allocator type for nodes which holds T
-    using NodeAllocator = typename AllocTraits::template rebind_alloc<BstNode>;
-    using BstNodeAllocator = BstAllocator<NodeAllocator>;
+    /* a forward cursor for scans (SEE: scan)
+     *
+     * ++ on an iterator finds the next node through the parent links; on a
+     * large tree those are cache misses of their own, and a step may climb
+     * O(log n) of them; a cursor instead keeps the ancestors it has yet to
+     * come back to (the ones whose left subtree it is in) on a stack, so that
+     * a step either pops the next node or descends the left spine of a right
+     * subtree; every node is then reached once per scan, from above, and the
+     * right child of every node that is pushed is prefetched (it is the next
+     * subtree to descend once the node has been visited)
+     *
+     * the stack keeps the cursor_depth deepest ancestors; in a deeper tree
+     * (e.g., a degenerate bst) the cursor falls back on the parent links for
+     * the ones it had to drop
+     *
+     * NOTE: a cursor is invalidated along with the iterators of the tree */
+    class BstCursor
+    {
+        friend class bst;
+
+      private:
+        using Self = BstCursor;
+
+      public:
+        using value_type = T;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        const T& operator*() const noexcept { return *node_->get(); }
+        const T* operator->() const noexcept { return node_->get(); }
+
+        // false once the cursor is past the maximum
+        explicit operator bool() const noexcept { return node_ != nullptr; }
+
+        Self& operator++() noexcept
+        {
+            if (node_->right != nullptr) {
+                descend(node_->right);
+            } else if (size_ != 0) {
+                --size_;
+                node_ = stack_[--top_ % cursor_depth];
+            } else {
+                node_ = node_->successor();
+            }
+            return *this;
+        }
+
+        // the element the cursor is at; end() once it is past the maximum
+        const_iterator current() const noexcept
+        {
+            if (node_ == nullptr) return const_iterator{sentinel_, sentinel_};
+            return const_iterator{node_, sentinel_};
+        }
+
+      private:
+        static_assert(std::has_single_bit(cursor_depth));
+
+        const BstNode*  node_{nullptr};
+        const Sentinel* sentinel_;
+
+        // a ring; top_ wraps around, and size_ (up to cursor_depth) of the
+        // slots below it are in use
+        std::array<const BstNode*, cursor_depth> stack_;
+        size_t                                   top_{0};
+        size_t                                   size_{0};
+
+        explicit BstCursor(const Sentinel* sentinel) noexcept
+            : sentinel_{sentinel}
+        {
+        }
+
+        static void prefetch(const void* ptr) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(ptr);
+#else
+            static_cast<void>(ptr);
+#endif
+        }
+
+        // the oldest (i.e., shallowest) ancestor is dropped once full
+        void push(const BstNode* node) noexcept
+        {
+            if (node->right != nullptr) prefetch(node->right);
+            stack_[top_++ % cursor_depth] = node;
+            if (size_ < cursor_depth) ++size_;
+        }
+
+        // moves to the minimum of the subtree at node
+        void descend(const BstNode* node) noexcept
+        {
+            while (node->left != nullptr) {
+                push(node);
+                node = node->left;
+            }
+            node_ = node;
+        }
+
+        // moves to node, and pushes the ancestors a descent to it would have
+        void seek(const BstNode* node) noexcept
+        {
+            std::array<const BstNode*, cursor_depth> above;
+            size_t                                   n = 0;
+
+            // the climb finds them deepest first
+            const BstNode* child = node;
+            const BstNode* up    = node->parent;
+
+            for (; up != nullptr && n < above.size(); up = up->parent) {
+                if (child == up->left) above[n++] = up;
+                child = up;
+            }
+
+            while (n != 0) push(above[--n]);
+            node_ = node;
+        }
+    };
+
+    // Allocator type for nodes which holds T
+    using NodeAllocator = typename AllocTraits::template rebind_alloc<BstNode>;
+    using BstNodeAllocator = BstAllocator<NodeAllocator>;
 
     // interanal constructor used to pass the allocator
     // all derived tree classes should call this
@@ -533,35 +1222,98 @@ class bst
     {
     }
 
+    // a new, empty Sentinel of the kind this tree is constructed with; every
+    // derived tree with a node type of its own overrides this
+    virtual Sentinel* make_sentinel(const Compare& compare) const
+    {
+        return new BstNodeAllocator{compare};
+    }
+
+    /* the Sentinel a moved-from tree is left with; it is shared by all of
+     * them, and is never updated (so it is safe to read from any thread)
+     *
+     * nullptr unless Compare can be default constructed; SEE: bst(bst&&) */
+    static Sentinel* empty_sentinel() noexcept
+    {
+        if constexpr (std::is_default_constructible_v<Compare>) {
+            static BstNodeAllocator empty{Compare{}};
+            return &empty;
+        } else {
+            return nullptr;
+        }
+    }
+
+    // false for a moved-from tree (until it is updated again)
+    bool owns_sentinel() const noexcept
+    {
+        return sentinel_ != empty_sentinel() && sentinel_ != nullptr;
+    }
+
+    // gives a moved-from tree a Sentinel of its own again; every update
+    // calls this before it touches the Sentinel
+    void own_sentinel()
+    {
+        if (owns_sentinel()) [[likely]] return;
+
+        if constexpr (std::is_default_constructible_v<Compare>) {
+            sentinel_ = make_sentinel(Compare{});
+        } else {
+            // SEE: bst(bst&&)
+            std::terminate();
+        }
+    }
+
   public:
     bst()
+        : bst{Compare{}}
+    {
+    }
+
+    explicit bst(const Compare& compare)
         // call the constructor that sets the allocator
-        : bst{new BstNodeAllocator{}}
+        : bst{new BstNodeAllocator{compare}}
     {
     }
 
+    // a tree of a move-only T can only be moved
     bst(const bst& that)
-        : bst{}
+        requires std::is_copy_constructible_v<T>
+        : bst{that.value_comp()}
     {
         sentinel_->copy(that.sentinel_);
     }
 
+    /* the moved-from tree is left empty; it shares a static empty Sentinel
+     * (SEE: empty_sentinel) until it is updated again, and only then gets
+     * one of its own, ordered by Compare{}. so moving allocates nothing
+     *
+     * NOTE: unless Compare can be default constructed the moved-from tree
+     * holds no Sentinel at all; it can then only be assigned to (or swapped
+     * with) and destroyed */
     bst(bst&& that) noexcept
-        : sentinel_{std::exchange(that.sentinel_, nullptr)}
+        : sentinel_{std::exchange(that.sentinel_, empty_sentinel())}
     {
     }
 
     virtual ~bst()
     {
+        if (!owns_sentinel()) return;
+
         sentinel_->clear();
         // TODO(michael): this could cause problems if Allocator has state
         delete sentinel_;
     }
 
     bst& operator=(const bst& that)
+        requires std::is_copy_constructible_v<T>
     {
         if (this != &that) {
-            sentinel_->clear();
+            if (owns_sentinel()) {
+                sentinel_->clear_and_reset();
+                sentinel_->compare = that.sentinel_->compare;
+            } else {
+                sentinel_ = make_sentinel(that.sentinel_->compare);
+            }
             sentinel_->copy(that.sentinel_);
         }
 
@@ -570,15 +1322,24 @@ class bst
 
     bst& operator=(bst&& that) noexcept
     {
+        // that is left with the (emptied) Sentinel of this tree
         if (this != &that) {
-            sentinel_->clear();
-            sentinel_ = std::exchange(that.sentinel_, nullptr);
+            if (owns_sentinel()) sentinel_->clear_and_reset();
+            std::swap(sentinel_, that.sentinel_);
         }
 
         return *this;
     }
 
+    // exchanges the Sentinels (and so the elements and the comparators) of
+    // the two trees; iterators stay valid, and refer to the other tree
+    void swap(bst& that) noexcept { std::swap(sentinel_, that.sentinel_); }
+
+    friend void swap(bst& lhs, bst& rhs) noexcept { lhs.swap(rhs); }
+
     allocator_type get_allocator() const noexcept { return allocator_type{}; }
+    value_compare  value_comp() const { return sentinel_->compare; }
+
     [[nodiscard]] bool   empty() const noexcept { return begin() == end(); }
     [[nodiscard]] size_t size() const noexcept { return sentinel_->size; }
 
@@ -587,26 +1348,140 @@ class bst
         return sentinel_->root->height();
     }
 
-    void clear() { sentinel_->clear_and_reset(); }
+    void clear()
+    {
+        if (owns_sentinel()) sentinel_->clear_and_reset();
+    }
+
+    // the number of storage arenas the tree holds on to; SEE: compact
+    [[nodiscard]] size_t arena_count() const noexcept
+    {
+        return sentinel_->arena_count();
+    }
+
+    /* moves the elements into new nodes, all in storage of the tree's own,
+     * and lets go of every arena it shared with other trees (SEE:
+     * BstAllocator); O(n)
+     *
+     * elements are moved if that cannot throw, and copied otherwise; so if
+     * anything throws the tree is left as it was */
+    void compact()
+        requires std::is_copy_constructible_v<T>
+                 || (std::is_nothrow_move_constructible_v<T>
+                     && std::is_nothrow_move_assignable_v<T>)
+    {
+        constexpr bool move = std::is_nothrow_move_constructible_v<T>
+                              && std::is_nothrow_move_assignable_v<T>;
+
+        // a moved-from tree has no storage to let go of
+        if (!owns_sentinel()) return;
+
+        std::vector<BstNode*> nodes;
+        std::vector<BstNode*> fresh;
+        nodes.reserve(size());
+        fresh.reserve(size());
+
+        if (sentinel_->root != nullptr) {
+            inorder_visit(sentinel_->root,
+                          [&nodes](BstNode* node) { nodes.push_back(node); });
+        }
+
+        Sentinel* compacted = make_sentinel(sentinel_->compare);
+        try {
+            for (BstNode* node : nodes) {
+                if constexpr (move) {
+                    fresh.push_back(
+                        compacted->emplace_node(std::move(node->data)));
+                } else {
+                    fresh.push_back(compacted->emplace_node(node->data));
+                }
+            }
+        } catch (...) {
+            for (size_t i = 0; i < fresh.size(); ++i) {
+                if constexpr (move) nodes[i]->data = std::move(fresh[i]->data);
+                compacted->destroy_node(fresh[i]);
+            }
+            delete compacted;
+            throw;
+        }
+
+        if (!fresh.empty()) {
+            // SEE: assign_sorted
+            size_t n      = fresh.size();
+            size_t height = 0;
+            while ((size_t{2} << height) <= n) ++height;
+
+            auto it         = fresh.cbegin();
+            compacted->root = relink_sorted(it, n, 0, height);
+            compacted->min  = fresh.front();
+            compacted->max  = fresh.back();
+            compacted->size = n;
+        }
+
+        std::swap(sentinel_, compacted);
+        compacted->clear();
+        delete compacted;
+    }
+
+    iterator insert(const_iterator hint, const T& data)
+    {
+        return emplace_hint(hint, data);
+    }
+
+    iterator insert(const_iterator hint, T&& data)
+    {
+        return emplace_hint(hint, std::move(data));
+    }
+
+    iterator insert(const T& data) { return emplace(data); }
+
+    iterator insert(T&& data) { return emplace(std::move(data)); }
+
+    // the value is constructed from args inside its node
+    template <typename... Args>
+    iterator emplace(Args&&... args)
+    {
+        own_sentinel();
+
+        BstNode* node = sentinel_->emplace_node(std::forward<Args>(args)...);
+        base_insert(node, slot_for(node, [this](const T& data) {
+                        return slot_of(data);
+                    }));
+
+        ++sentinel_->size;
 
-    iterator insert(const_iterator, const T& data) { return insert(data); }
+        return iterator{node, sentinel_};
+    }
 
-    iterator insert(const T& data)
+    /* the value goes as close as it can right before hint: if it fits between
+     * hint and its predecessor it is linked in there with two comparisons;
+     * otherwise it is searched for from hint upwards (SEE: finger_slot)
+     *
+     * so inserting a stream that is (almost) in order with end(), or the
+     * position after the previous insert, as the hint does O(1) comparisons
+     * per element (plus the rebalancing, which is O(1) amortized) */
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args)
     {
-        BstNode* node = sentinel_->make_node(data);
-        base_insert(node);
+        // a hint into a moved-from tree is its end(); so it is one still
+        if (!owns_sentinel()) return emplace(std::forward<Args>(args)...);
+
+        BstNode* node = sentinel_->emplace_node(std::forward<Args>(args)...);
+        base_insert(node, slot_for(node, [this, &hint](const T& data) {
+                        return hinted_slot(hint.node_, data);
+                    }));
 
         ++sentinel_->size;
 
-        return iterator{node};
+        return iterator{node, sentinel_};
     }
 
+    // NOTE: the elements are constructed from *first; so a move_iterator
+    // range is moved into the tree
     template <typename InputIterator>
     void insert(InputIterator first, InputIterator last)
     {
-        std::for_each(first, last, [this](const T& data) {
-            this->insert(data);
-        });
+        for (; first != last; ++first) emplace(*first);
     }
 
     void insert(std::initializer_list<T> init)
@@ -614,21 +1489,122 @@ class bst
         insert(init.begin(), init.end());
     }
 
-    iterator erase(const_iterator pos)
+    /* replaces the contents of the tree with [first, last), which must already
+     * be sorted with respect to Compare
+     *
+     * the tree is built perfectly balanced in O(n) without comparing any
+     * elements */
+    template <typename ForwardIterator>
+    void assign_sorted(ForwardIterator first, ForwardIterator last)
     {
-        auto* node = static_cast<BstNode*>(pos++.extract());
-        base_erase(node);
+        clear();
+        own_sentinel();
 
-        --sentinel_->size;
+        auto n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0) return;
 
-        if (sentinel_->is_min(node)) [[unlikely]] {
-            sentinel_->update_min(node->parent);
+        // the deepest level of a perfectly balanced tree of n nodes
+        size_t height = 0;
+        while ((size_t{2} << height) <= n) ++height;
+
+        BstNode* root = build_sorted(first, n, 0, height);
+
+        sentinel_->root = root;
+        sentinel_->min  = root->min();
+        sentinel_->max  = root->max();
+        sentinel_->size = n;
+    }
+
+    /* replaces the contents of the tree with the (unsorted) values in
+     * [first, last); the values are sorted and then built as in assign_sorted
+     *
+     * with threads > 1 the sort is split across that many threads; equivalent
+     * values keep their relative order in either case */
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last, size_t threads = 1)
+    {
+        std::vector<T, Allocator> values(first, last);
+
+        const Compare& compare = sentinel_->compare;
+
+        if (threads > 1) {
+            sort_parallel(values.begin(), values.end(), threads, compare);
+        } else {
+            std::stable_sort(values.begin(), values.end(), compare);
         }
 
-        if (sentinel_->is_max(node)) [[unlikely]] {
-            sentinel_->update_max(node->parent);
+        assign_sorted(values.begin(), values.end());
+    }
+
+    // how insert_many put its batch into the tree
+    enum class insert_strategy : unsigned char { merge, rebuild };
+
+    /* inserts the (unsorted) values in [first, last); returns which of the
+     * two ways it took
+     *
+     * the values are sorted first (with threads > 1 across that many threads;
+     * SEE: assign), and then
+     *
+     *   - merge: every value is searched for from the node inserted before
+     *     it; so each search starts where the last one ended, and costs as
+     *     much as the gap between the two (SEE: finger_slot)
+     *   - rebuild: the nodes of the tree and the ones of the batch are merged
+     *     into one sequence and relinked into a balanced tree in O(size() +
+     *     batch), without moving any element
+     *
+     * rebuild is taken once the batch has at least size() / rebuild_ratio
+     * values; equivalent elements end up as insert would leave them (the
+     * ones already in the tree first, then the batch in its own order)
+     *
+     * NOTE: if anything throws a rebuild leaves the tree as it was; a merge
+     * keeps the values it inserted until then, which are the ones that sort
+     * before the value it failed on, and drops the rest of the batch (the
+     * tree stays valid and its size exact) */
+    template <typename InputIterator>
+    insert_strategy
+    insert_many(InputIterator first, InputIterator last, size_t threads = 1)
+    {
+        own_sentinel();
+
+        std::vector<T, Allocator> values(first, last);
+
+        const Compare& compare = sentinel_->compare;
+
+        if (threads > 1) {
+            sort_parallel(values.begin(), values.end(), threads, compare);
+        } else {
+            std::stable_sort(values.begin(), values.end(), compare);
         }
 
+        if (values.size() * rebuild_ratio < size()) {
+            const BstNode* previous = nullptr;
+            for (T& value : values) {
+                BstNode* node = sentinel_->emplace_node(std::move(value));
+
+                // past the maximum slot_of appends with a single comparison
+                bool finger = previous != nullptr && previous != sentinel_->max;
+                base_insert(node, slot_for(node, [&](const T& data) {
+                                return finger ? finger_slot(previous, data)
+                                              : slot_of(data);
+                            }));
+
+                ++sentinel_->size;
+                previous = node;
+            }
+            return insert_strategy::merge;
+        }
+
+        rebuild_with(values);
+        return insert_strategy::rebuild;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        auto* node = static_cast<BstNode*>(pos++.extract());
+        unlink(node);
+
+        --sentinel_->size;
+
         sentinel_->destroy_node(node);
 
         // no need to wrap in iterator constructor; all iterators are
@@ -636,56 +1612,205 @@ class bst
         return pos;
     }
 
+    /* NOTE: if the value is no longer equivalent the element is moved; if
+     * assigning it or finding its new place throws then it is erased */
     iterator modify(const_iterator pos, const T& data)
     {
-        auto not_equal = [](const T& lhs, const T& rhs) noexcept(
-                             noexcept(Compare{}(data, data))) {
-            return Compare{}(lhs, rhs) != Compare{}(rhs, lhs);
-        };
+        return replace(pos, data);
+    }
 
-        if (not_equal(*pos, data)) {
-            auto* node = static_cast<BstNode*>(pos.extract());
+    iterator modify(const_iterator pos, T&& data)
+    {
+        return replace(pos, std::move(data));
+    }
 
-            base_erase(node);
-            node->reset();
-            node->data = data;
-            base_insert(node);
+    iterator find(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator_at(sentinel_->find(data));
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator find(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator_at(sentinel_->find(key));
+    }
+
+    // the first element not less than data
+    iterator lower_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator_at(sentinel_->lower_bound(data));
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator lower_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator_at(sentinel_->lower_bound(key));
+    }
+
+    // the first element greater than data
+    iterator upper_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator_at(sentinel_->upper_bound(data));
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator upper_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator_at(sentinel_->upper_bound(key));
+    }
+
+    // all the elements equivalent to data; in the order they were inserted
+    std::pair<iterator, iterator> equal_range(const T& data) const
+        noexcept(nothrow_compare<T>)
+    {
+        return {lower_bound(data), upper_bound(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    std::pair<iterator, iterator> equal_range(const Key& key) const
+        noexcept(nothrow_compare<Key>)
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    // NOTE: the bounds are found in O(log n), but unless the tree keeps
+    // order_statistics the equivalent elements between them are stepped over
+    // one at a time
+    size_type count(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        auto [first, last] = equal_range(data);
+        return count_between(first, last);
+    }
+
+    template <typename Key>
+        requires transparent
+    size_type count(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        auto [first, last] = equal_range(key);
+        return count_between(first, last);
+    }
+
+    // the element at (zero based) index k in sorted order; or end() if there
+    // are no more than k elements
+    iterator select(size_type k) const noexcept
+        requires augmented
+    {
+        const BstNode* node = sentinel_->root;
+
+        while (node != nullptr) {
+            size_t left = subtree_size(node->left);
+
+            if (k < left) {
+                node = node->left;
+            } else if (k == left) {
+                return iterator{node, sentinel_};
+            } else {
+                k -= left + 1;
+                node = node->right;
+            }
         }
 
-        // no need to wrap in iterator constructor; all iterators are
-        // const_iterator
-        return pos;
+        return end();
+    }
+
+    // the index of pos in sorted order; size() for end()
+    size_type rank(const_iterator pos) const noexcept
+        requires augmented
+    {
+        if (pos == end()) return size();
+
+        const auto* node = static_cast<const BstNode*>(pos.node_);
+        size_t      r    = subtree_size(node->left);
+
+        // every ancestor we come up to from the right precedes pos, and so
+        // does its left subtree
+        for (; node->parent != nullptr; node = node->parent) {
+            if (node == node->parent->right) {
+                r += subtree_size(node->parent->left) + 1;
+            }
+        }
+
+        return r;
+    }
+
+    // the number of elements less than data
+    size_type rank(const T& data) const noexcept(nothrow_compare<T>)
+        requires augmented
+    {
+        return rank_of(data);
+    }
+
+    template <typename Key>
+        requires(augmented && transparent)
+    size_type rank(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return rank_of(key);
+    }
+
+    // the number of increments from first to last
+    difference_type distance(const_iterator first, const_iterator last) const
+        noexcept
+        requires augmented
+    {
+        return static_cast<difference_type>(rank(last))
+               - static_cast<difference_type>(rank(first));
     }
 
-    iterator find(const T& data) const noexcept
+    // the combined value of the elements in [first, last), in order; the
+    // identity if the range is empty
+    auto aggregate(const_iterator first, const_iterator last) const noexcept
+        requires aggregated
     {
-        const BstNode* node = sentinel_->find(data);
-        if (node == nullptr) return iterator{sentinel_};
-        return iterator{node};
+        return aggregate_of(sentinel_->root, rank(first), rank(last));
     }
 
-    position position_of(const T& data) noexcept
+    // the combined value of all the elements
+    auto aggregate() const noexcept
+        requires aggregated
+    {
+        if (sentinel_->root == nullptr) return Augment::identity();
+        return sentinel_->root->aggregate;
+    }
+
+    position position_of(const T& data) noexcept(nothrow_compare<T>)
     {
         iterator pos = find(data);
         return position_of(pos);
     }
 
+    template <typename Key>
+        requires transparent
+    position position_of(const Key& key) noexcept(nothrow_compare<Key>)
+    {
+        iterator pos = find(key);
+        return position_of(pos);
+    }
+
     inline position position_of(const_iterator pos) noexcept
     {
         return position{this, pos};
     }
 
-    iterator begin() noexcept { return iterator{sentinel_->min}; }
+    iterator begin() noexcept { return iterator{sentinel_->min, sentinel_}; }
 
     const_iterator cbegin() const noexcept
     {
-        return const_iterator{sentinel_->min};
+        return const_iterator{sentinel_->min, sentinel_};
     }
 
     const_iterator begin() const noexcept { return cbegin(); }
 
-    iterator       end() noexcept { return iterator{sentinel_}; }
-    const_iterator cend() const noexcept { return const_iterator{sentinel_}; }
+    iterator end() noexcept { return iterator{sentinel_, sentinel_}; }
+
+    const_iterator cend() const noexcept
+    {
+        return const_iterator{sentinel_, sentinel_};
+    }
+
     const_iterator end() const noexcept { return cend(); }
 
     reverse_iterator rbegin() noexcept
@@ -712,11 +1837,40 @@ class bst
 
     const_reverse_iterator rend() const noexcept { return crend(); }
 
+    /* a cursor at the minimum; a full scan is
+     *
+     *   for (auto it = tree.scan(); it; ++it) ...;
+     *
+     * a range scan starts with scan(lower_bound(key)) */
+    cursor scan() const noexcept
+    {
+        cursor it{sentinel_};
+        if (sentinel_->root != nullptr) it.descend(sentinel_->root);
+        return it;
+    }
+
+    // a cursor at pos; the ancestors of pos are found by climbing once
+    cursor scan(const_iterator pos) const noexcept
+    {
+        cursor it{sentinel_};
+        if (pos != end()) it.seek(static_cast<const BstNode*>(pos.node_));
+        return it;
+    }
+
+    // the element at the root; or end() if the tree is empty. the visitors
+    // below walk the subtree of the node holding it; so from root() they
+    // walk the whole tree
+    const_iterator root() const noexcept
+    {
+        return iterator_at(sentinel_->root);
+    }
+
     template <typename Visitor, typename... Args>
     void preorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
     {
-        preorder_visit(it.extract(),
-                       &bst::data_visit,
+        if (it == end()) return;
+        preorder_visit(static_cast<BstNode*>(it.extract()),
+                       &bst::template data_visit<Visitor, Args...>,
                        std::forward<Visitor>(visit),
                        std::forward<Args>(args)...);
     }
@@ -724,8 +1878,9 @@ class bst
     template <typename Visitor, typename... Args>
     void inorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
     {
-        inorder_visit(it.extract(),
-                      &bst::data_visit,
+        if (it == end()) return;
+        inorder_visit(static_cast<BstNode*>(it.extract()),
+                      &bst::template data_visit<Visitor, Args...>,
                       std::forward<Visitor>(visit),
                       std::forward<Args>(args)...);
     }
@@ -734,12 +1889,78 @@ class bst
     void
     postorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
     {
-        postorder_visit(it.extract(),
-                        &bst::data_visit,
+        if (it == end()) return;
+        postorder_visit(static_cast<BstNode*>(it.extract()),
+                        &bst::template data_visit<Visitor, Args...>,
                         std::forward<Visitor>(visit),
                         std::forward<Args>(args)...);
     }
 
+    /* the parallel visitors walk the subtree at it like the ones above, but
+     * as tasks on pool: a subtree with (an estimated) grain elements or more
+     * is forked into its two children, and smaller ones are walked on their
+     * own
+     *
+     * every task folds the elements it walks, in order, into a partial
+     * result of its own that starts out as identity,
+     *
+     *   visit(data, partial);
+     *
+     * and the partial results of the two sides of a fork are then combined
+     * in order as well,
+     *
+     *   partial = combine(std::move(lhs), std::move(rhs));
+     *
+     * so with an associative combine the result is the one the sequential
+     * walk would have folded (e.g., a sum, or the elements in order)
+     *
+     * NOTE: visit and combine are called from several threads at once; the
+     * estimate (without order_statistics or an aggregate) assumes that the
+     * tree is balanced, and no more than fork_levels levels are forked; so
+     * a degenerate tree is mostly walked on one thread
+     *
+     * SEE: work_stealing_pool::fork_join for exceptions */
+    static constexpr size_t default_grain{4096};
+
+    template <typename Result, typename Visitor, typename Combine>
+    Result
+    parallel_preorder_from(const_iterator      it,
+                           work_stealing_pool& pool,
+                           Result              identity,
+                           Visitor&&           visit,
+                           Combine&&           combine,
+                           size_t              grain = default_grain) const
+    {
+        return parallel_from<Order::pre>(
+            it, VisitContext{identity, visit, combine, pool, grain});
+    }
+
+    template <typename Result, typename Visitor, typename Combine>
+    Result
+    parallel_inorder_from(const_iterator      it,
+                          work_stealing_pool& pool,
+                          Result              identity,
+                          Visitor&&           visit,
+                          Combine&&           combine,
+                          size_t              grain = default_grain) const
+    {
+        return parallel_from<Order::in>(
+            it, VisitContext{identity, visit, combine, pool, grain});
+    }
+
+    template <typename Result, typename Visitor, typename Combine>
+    Result
+    parallel_postorder_from(const_iterator      it,
+                            work_stealing_pool& pool,
+                            Result              identity,
+                            Visitor&&           visit,
+                            Combine&&           combine,
+                            size_t              grain = default_grain) const
+    {
+        return parallel_from<Order::post>(
+            it, VisitContext{identity, visit, combine, pool, grain});
+    }
+
   protected:
     template <typename Visitor, typename... Args>
     static void preorder_visit(BstNode* node, Visitor&& visit, Args&&... args)
@@ -764,26 +1985,43 @@ class bst
     template <typename Visitor, typename... Args>
     static void inorder_visit(BstNode* node, Visitor&& visit, Args&&... args)
     {
-        Node* cursor = node->min();
-
-        while (cursor->is_data() && cursor != node->parent) {
-            auto* up = static_cast<BstNode*>(cursor);
-            std::forward<Visitor>(visit)(up, std::forward<Args>(args)...);
-            cursor = cursor->successor();
+        // the walk ends at the maximum of the subtree; the cursor (which
+        // may fall back on the links above node) never gets past it
+        BstNode* last = node->max();
+
+        BstCursor it{nullptr};
+        it.descend(node);
+
+        while (true) {
+            // const_cast is OK; SEE: ConstBstNodeIterator::extract
+            auto* cursor = const_cast<BstNode*>(it.node_);
+            std::forward<Visitor>(visit)(cursor, std::forward<Args>(args)...);
+            if (cursor == last) break;
+            ++it;
         }
     }
 
     template <typename Visitor, typename... Args>
     static void postorder_visit(BstNode* node, Visitor&& visit, Args&&... args)
     {
+        std::stack<BstNode*> pending;
         std::stack<BstNode*> stack;
 
-        preorder_visit(
-            node,
-            [](BstNode* node, std::stack<BstNode*>& stack) {
-                stack.push(node);
-            },
-            stack);
+        if (node) {
+            pending.push(node);
+        }
+
+        // a preorder walk with the children swapped, which is the postorder
+        // one backwards
+        while (!pending.empty()) {
+            BstNode* up = pending.top();
+            pending.pop();
+
+            stack.push(up);
+
+            if (up->left != nullptr) pending.push(up->left);
+            if (up->right != nullptr) pending.push(up->right);
+        }
 
         while (!stack.empty()) {
             BstNode* up = stack.top();
@@ -792,36 +2030,171 @@ class bst
         }
     }
 
-    virtual void base_insert(BstNode* node)
+    /* called for every node built by assign_sorted once both of its subtrees
+     * are in place; depth is the node's depth and height the depth of the
+     * deepest level (every leaf is at height or height - 1) */
+    virtual void post_build(BstNode* /*node*/,
+                            size_t /*depth*/,
+                            size_t /*height*/)
+    {
+    }
+
+    // SEE: insert_many
+    static constexpr size_t rebuild_ratio{1};
+
+    // where a new node is linked in: as the left or right child of parent (or
+    // as the root if parent is null)
+    struct Slot {
+        BstNode* parent;
+        bool     left;
+    };
+
+    // the slot of data after all of its equivalents
+    Slot slot_of(const T& data) const
+    {
+        const Compare& compare = sentinel_->compare;
+
+        if (sentinel_->root == nullptr) return {nullptr, false};
+
+        // appending past the maximum (e.g., timestamps that arrive in order)
+        // takes a single comparison
+        auto* max = static_cast<BstNode*>(sentinel_->max);
+        if (!compare(data, max->data)) return {max, false};
+
+        // NOTE: this will put "equal", but "newer" nodes to the right of
+        // already exisitng nodes
+        return descend_slot(sentinel_->root, data);
+    }
+
+    /* the slot find picks for node, which is not linked in; if find throws
+     * the node is destroyed (nothing else refers to it) and the exception is
+     * rethrown */
+    template <typename Find>
+    Slot slot_for(BstNode* node, Find&& find)
+    {
+        try {
+            return std::forward<Find>(find)(node->data);
+        } catch (...) {
+            sentinel_->destroy_node(node);
+            throw;
+        }
+    }
+
+    // SEE: emplace_hint
+    Slot hinted_slot(const Node* hint, const T& data) const
     {
+        const Compare& compare = sentinel_->compare;
+
+        if (sentinel_->root == nullptr) return {nullptr, false};
+
+        // the neighbours data has to fit between; next is null for end()
+        const BstNode* next = hint != sentinel_
+                                  ? static_cast<const BstNode*>(hint)
+                                  : nullptr;
+        const BstNode* prev = next != nullptr
+                                  ? next->predecessor()
+                                  : static_cast<const BstNode*>(sentinel_->max);
+
+        if ((next == nullptr || !compare(next->data, data))
+            && (prev == nullptr || !compare(data, prev->data))) {
+            // one of the two is free: either next has no left subtree, or
+            // prev (the maximum of that subtree) has no right one
+            //
+            // const_cast is OK; Node(s) are never actually declared const
+            if (next != nullptr && next->left == nullptr) {
+                return {const_cast<BstNode*>(next), true};
+            }
+            return {const_cast<BstNode*>(prev), false};
+        }
+
+        return finger_slot(next != nullptr ? next : prev, data);
+    }
+
+    /* the slot of data found from node: up to the lowest ancestor whose
+     * subtree data belongs in, and down from there; so the cost is in the
+     * distance from node rather than in the size of the tree
+     *
+     * only the ancestors where the path up turns towards data bound it (the
+     * right turns if data is less than node, the left turns otherwise); the
+     * search goes down from the last one data is beyond, which lies on the
+     * path a search from the root would take; so a hint that is far off
+     * costs the climb, but no more comparisons than that search */
+    Slot finger_slot(const BstNode* node, const T& data) const
+    {
+        const Compare& compare = sentinel_->compare;
+
+        bool           less = compare(data, node->data);
+        const BstNode* from = node;
+
+        for (const BstNode* up = node->parent; up != nullptr;
+             node = up, up = up->parent) {
+            if ((node == up->right) != less) continue;
+            if (less != compare(data, up->data)) break;
+            from = up;
+        }
+
+        // const_cast is OK; Node(s) are never actually declared const
+        return descend_slot(const_cast<BstNode*>(from), data);
+    }
+
+    Slot descend_slot(BstNode* cursor, const T& data) const
+    {
+        const Compare& compare = sentinel_->compare;
+
         BstNode* parent{nullptr};
-        BstNode* cursor{sentinel_->root};
+        bool     less{false};
 
         // find where the node should be added; parent will be a leaf node
         // and we will add the new node as one of its children
+        //
+        // NOTE: the last comparison also decides which child it becomes; so
+        // there is exactly one comparison per level
         while (cursor != nullptr) {
             parent = cursor;
-            if (*node < *parent) {
-                cursor = cursor->left;
-            } else {
-                cursor = cursor->right;
-            }
+            less   = compare(data, parent->data);
+            cursor = less ? cursor->left : cursor->right;
         }
 
+        return {parent, less};
+    }
+
+    virtual void base_insert(BstNode* node, Slot slot)
+    {
+        BstNode* parent = slot.parent;
+
         node->parent = parent;
 
         if (parent == nullptr) { // there is no root; update min and max as well
             sentinel_->update_all(node);
-        } else if (*node < *parent) { // add as left child and possibly update
-                                      // min; min will always be a left child
+        } else if (slot.left) { // add as left child and possibly update
+                                // min; min will always be a left child
             parent->left = node;
             if (sentinel_->is_min(parent)) sentinel_->update_min(node);
         } else { // the analogous logic for right children
-            // NOTE: this will put "equal", but "newer" nodes to the
-            // right of already exisitng nodes
             parent->right = node;
             if (sentinel_->is_max(parent)) sentinel_->update_max(node);
         }
+
+        update_augment_path(node);
+    }
+
+    void unlink(BstNode* node)
+    {
+        // the in-order neighbours have to be found before the node is removed;
+        // the min (max) node may still have a right (left) subtree
+        if (sentinel_->is_min(node)) [[unlikely]] {
+            const BstNode* next = node->successor();
+            sentinel_->min = next != nullptr ? const_cast<BstNode*>(next)
+                                             : static_cast<Node*>(sentinel_);
+        }
+
+        if (sentinel_->is_max(node)) [[unlikely]] {
+            const BstNode* prev = node->predecessor();
+            sentinel_->max = prev != nullptr ? const_cast<BstNode*>(prev)
+                                             : static_cast<Node*>(sentinel_);
+        }
+
+        base_erase(node);
     }
 
     void transplant(BstNode* u, BstNode* v)
@@ -845,14 +2218,23 @@ class bst
         if (v != nullptr) v->parent = u->parent;
     }
 
+    /* NOTE: both erase steps bring the augmentation of the nodes above the
+     * removed one back up to date before they return; so derived trees can
+     * rebalance with rotations right after calling them */
     virtual void single_child_or_leaf_node_erase(BstNode* node, BstNode* rep)
     {
         transplant(node, rep);
+        update_augment_path(node->parent);
     }
 
     virtual void double_child_node_erase(BstNode* node, BstNode* rep)
     {
+        // the lowest node whose subtree loses a node
+        BstNode* lowest = rep;
+
         if (rep->parent != node) {
+            lowest = rep->parent;
+
             transplant(rep, rep->right);
             rep->right         = node->right;
             rep->right->parent = rep;
@@ -861,6 +2243,8 @@ class bst
         transplant(node, rep);
         rep->left         = node->left;
         rep->left->parent = rep;
+
+        update_augment_path(lowest);
     }
 
     virtual void base_erase(BstNode* node)
@@ -889,14 +2273,415 @@ class bst
         }
     }
 
+    // the number of nodes in the subtree rooted at node
+    static size_t subtree_size(const BstNode* node) noexcept
+        requires augmented
+    {
+        return node != nullptr ? node->subtree_size : 0;
+    }
+
+    /* recomputes what Augment keeps for node from its children; this has to
+     * be done whenever the children of node change (e.g., in a rotation) */
+    static void update_augment(BstNode* node) noexcept
+    {
+        if constexpr (augmented) {
+            node->subtree_size =
+                1 + subtree_size(node->left) + subtree_size(node->right);
+        }
+
+        if constexpr (aggregated) node->aggregate = combined_aggregate(node);
+    }
+
+    // the aggregate of the subtree at node, from the ones of its children
+    static auto combined_aggregate(const BstNode* node) noexcept
+        requires aggregated
+    {
+        auto value = Augment::lift(node->data);
+        if (node->left != nullptr) {
+            value = Augment::combine(node->left->aggregate, value);
+        }
+        if (node->right != nullptr) {
+            value = Augment::combine(value, node->right->aggregate);
+        }
+        return value;
+    }
+
+    // SEE: update_augment; for node and all of its ancestors
+    static void update_augment_path(BstNode* node) noexcept
+    {
+        if constexpr (augmented) {
+            for (; node != nullptr; node = node->parent) update_augment(node);
+        }
+    }
+
+    // the iterator to node; or end() if node is null
+    iterator iterator_at(const BstNode* node) const noexcept
+    {
+        if (node == nullptr) return iterator{sentinel_, sentinel_};
+        return iterator{node, sentinel_};
+    }
+
     Sentinel* sentinel_;
 
   private:
+    size_type count_between(const_iterator first, const_iterator last) const
+        noexcept
+    {
+        if constexpr (augmented) {
+            return rank(last) - rank(first);
+        } else {
+            return static_cast<size_type>(std::distance(first, last));
+        }
+    }
+
+    /* the aggregate of the nodes of the subtree at node whose (subtree local)
+     * indices are in [lo, hi)
+     *
+     * a subtree that lies entirely within the range contributes the aggregate
+     * kept in its root; so besides those only the nodes on the paths to the
+     * two ends of the range are visited */
+    static auto aggregate_of(const BstNode* node, size_t lo, size_t hi) noexcept
+    {
+        auto value = Augment::identity();
+
+        if (node == nullptr || lo >= hi) return value;
+        if (lo == 0 && hi == node->subtree_size) return node->aggregate;
+
+        size_t left = subtree_size(node->left);
+
+        if (lo < left) {
+            value = aggregate_of(node->left, lo, std::min(hi, left));
+        }
+
+        if (lo <= left && left < hi) {
+            value = Augment::combine(value, Augment::lift(node->data));
+        }
+
+        if (hi > left + 1) {
+            size_t from = lo > left + 1 ? lo - left - 1 : 0;
+            value       = Augment::combine(
+                value, aggregate_of(node->right, from, hi - left - 1));
+        }
+
+        return value;
+    }
+
+    template <typename Key>
+    size_type rank_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        const Compare& compare = sentinel_->compare;
+        const BstNode* node    = sentinel_->root;
+        size_t         r       = 0;
+
+        while (node != nullptr) {
+            if (compare(node->data, key)) {
+                r += subtree_size(node->left) + 1;
+                node = node->right;
+            } else {
+                node = node->left;
+            }
+        }
+
+        return r;
+    }
+
+    // SEE: modify
+    template <typename Data>
+    iterator replace(const_iterator pos, Data&& data)
+    {
+        auto* node = static_cast<BstNode*>(pos.extract());
+
+        if (equivalent(sentinel_->compare, node->data, data)) {
+            // the node keeps its place; only the data changes
+            node->data = std::forward<Data>(data);
+            if constexpr (aggregated) update_augment_path(node);
+        } else {
+            // NOTE: the slot can only be found after unlinking; unlinking
+            // rebalances the tree, which could move a slot found before
+            unlink(node);
+            --sentinel_->size;
+            node->reset();
+
+            Slot slot = slot_for(node, [this, &data](T& value) {
+                value = std::forward<Data>(data);
+                return slot_of(value);
+            });
+            base_insert(node, slot);
+            ++sentinel_->size;
+        }
+
+        // no need to wrap in iterator constructor; all iterators are
+        // const_iterator
+        return pos;
+    }
+
+    template <typename ForwardIterator>
+    BstNode*
+    build_sorted(ForwardIterator& it, size_t n, size_t depth, size_t height)
+    {
+        if (n == 0) return nullptr;
+
+        // the larger half goes right; so every leaf ends up at height or
+        // height - 1
+        size_t left_n = (n - 1) / 2;
+
+        BstNode* left = build_sorted(it, left_n, depth + 1, height);
+        BstNode* node{nullptr};
+        BstNode* right{nullptr};
+
+        try {
+            node = sentinel_->emplace_node(*it);
+
+            node->left = left;
+            if (left != nullptr) left->parent = node;
+
+            ++it;
+
+            right = build_sorted(it, n - left_n - 1, depth + 1, height);
+        } catch (...) {
+            // the partial subtrees are not reachable from the tree yet
+            auto dispose = [this](BstNode* up) { sentinel_->destroy_node(up); };
+            Sentinel::teardown(node != nullptr ? node : left, dispose);
+            throw;
+        }
+
+        node->right = right;
+        if (right != nullptr) right->parent = node;
+
+        update_augment(node);
+        post_build(node, depth, height);
+
+        return node;
+    }
+
+    // SEE: insert_many; values is sorted, and its elements are moved from
+    void rebuild_with(std::vector<T, Allocator>& values)
+    {
+        const Compare& compare = sentinel_->compare;
+
+        std::vector<BstNode*> nodes;
+        nodes.reserve(size());
+        if (sentinel_->root != nullptr) {
+            inorder_visit(sentinel_->root,
+                          [&nodes](BstNode* node) { nodes.push_back(node); });
+        }
+
+        std::vector<BstNode*> fresh;
+        std::vector<BstNode*> merged;
+
+        // the tree is only read until every node is at hand
+        try {
+            fresh.reserve(values.size());
+            for (T& value : values) {
+                fresh.push_back(sentinel_->emplace_node(std::move(value)));
+            }
+
+            merged.reserve(nodes.size() + fresh.size());
+            std::merge(nodes.begin(),
+                       nodes.end(),
+                       fresh.begin(),
+                       fresh.end(),
+                       std::back_inserter(merged),
+                       [&compare](const BstNode* lhs, const BstNode* rhs) {
+                           return compare(lhs->data, rhs->data);
+                       });
+        } catch (...) {
+            for (BstNode* node : fresh) sentinel_->destroy_node(node);
+            throw;
+        }
+
+        size_t n = merged.size();
+        if (n == 0) return;
+
+        // SEE: assign_sorted
+        size_t height = 0;
+        while ((size_t{2} << height) <= n) ++height;
+
+        auto     it   = merged.cbegin();
+        BstNode* root = relink_sorted(it, n, 0, height);
+
+        sentinel_->root = root;
+        sentinel_->min  = merged.front();
+        sentinel_->max  = merged.back();
+        sentinel_->size = n;
+    }
+
+    // SEE: build_sorted; the same shape, out of nodes that already exist
+    template <typename NodeIterator>
+    BstNode* relink_sorted(NodeIterator& it,
+                           size_t        n,
+                           size_t        depth,
+                           size_t        height)
+    {
+        if (n == 0) return nullptr;
+
+        size_t left_n = (n - 1) / 2;
+
+        BstNode* left = relink_sorted(it, left_n, depth + 1, height);
+        BstNode* node = *it++;
+        node->reset();
+        BstNode* right = relink_sorted(it, n - left_n - 1, depth + 1, height);
+
+        node->left = left;
+        if (left != nullptr) left->parent = node;
+
+        node->right = right;
+        if (right != nullptr) right->parent = node;
+
+        update_augment(node);
+        post_build(node, depth, height);
+
+        return node;
+    }
+
+    // sorts runs of the input on their own threads and then merges them
+    template <typename RandomIterator>
+    static void sort_parallel(RandomIterator first,
+                              RandomIterator last,
+                              size_t         threads,
+                              const Compare& compare)
+    {
+        auto n = static_cast<size_t>(last - first);
+
+        std::vector<RandomIterator> bounds;
+        for (size_t i = 0; i <= threads; ++i) {
+            auto offset = static_cast<std::ptrdiff_t>(n * i / threads);
+            bounds.push_back(first + offset);
+        }
+
+        auto fork_join = [](size_t count, auto&& task) {
+            std::vector<std::thread> workers;
+            workers.reserve(count);
+            for (size_t i = 0; i < count; ++i) workers.emplace_back(task, i);
+            for (auto& worker : workers) worker.join();
+        };
+
+        fork_join(threads, [&bounds, &compare](size_t i) {
+            std::stable_sort(bounds[i], bounds[i + 1], compare);
+        });
+
+        // merge neighbouring runs pairwise until a single run is left
+        for (size_t width = 1; width < threads; width *= 2) {
+            size_t merges = (threads + 2 * width - 1) / (2 * width);
+
+            fork_join(merges, [&bounds, &compare, width, threads](size_t i) {
+                size_t lo  = 2 * width * i;
+                size_t mid = std::min(lo + width, threads);
+                size_t hi  = std::min(lo + 2 * width, threads);
+                if (mid < hi) {
+                    std::inplace_merge(bounds[lo],
+                                       bounds[mid],
+                                       bounds[hi],
+                                       compare);
+                }
+            });
+        }
+    }
+
     template <typename Visitor, typename... Args>
     static void data_visit(const BstNode* node, Visitor&& visit, Args&&... args)
     {
         std::forward<Visitor>(visit)(node->data, std::forward<Args>(args)...);
     }
+
+    enum class Order : unsigned char { pre, in, post };
+
+    // SEE: parallel_inorder_from
+    template <typename Result, typename Visitor, typename Combine>
+    struct VisitContext {
+        const Result&       identity;
+        Visitor&            visit;
+        Combine&            combine;
+        work_stealing_pool& pool;
+        size_t              grain;
+    };
+
+    // the walk forks at most this many levels below where it started; so
+    // the recursion stays shallow even where the tree is not balanced
+    static constexpr size_t fork_levels{48};
+
+    template <Order order, typename Context>
+    auto parallel_from(const_iterator it, const Context& context) const
+    {
+        using Result = std::remove_cvref_t<decltype(context.identity)>;
+
+        Result result{context.identity};
+        if (it == end()) return result;
+
+        auto* node = static_cast<BstNode*>(it.extract());
+
+        size_t depth = 0;
+        for (const BstNode* up = node->parent; up != nullptr; up = up->parent) {
+            ++depth;
+        }
+
+        parallel_walk<order>(node, depth, fork_levels, result, context);
+        return result;
+    }
+
+    // the number of elements in the subtree at node (which is at depth); as
+    // if the tree was perfectly balanced unless the sizes are kept
+    size_t estimated_size(const BstNode* node, size_t depth) const noexcept
+    {
+        if constexpr (augmented) {
+            return subtree_size(node);
+        } else {
+            if (depth >= std::numeric_limits<size_t>::digits) return 0;
+            return sentinel_->size >> depth;
+        }
+    }
+
+    template <Order order, typename Result, typename Context>
+    void parallel_walk(BstNode*       node,
+                       size_t         depth,
+                       size_t         levels,
+                       Result&        partial,
+                       const Context& context) const
+    {
+        using Visitor = decltype(context.visit);
+
+        if (levels == 0 || estimated_size(node, depth) < context.grain) {
+            auto* visit = &bst::template data_visit<Visitor, Result&>;
+            if constexpr (order == Order::pre) {
+                preorder_visit(node, visit, context.visit, partial);
+            } else if constexpr (order == Order::in) {
+                inorder_visit(node, visit, context.visit, partial);
+            } else {
+                postorder_visit(node, visit, context.visit, partial);
+            }
+            return;
+        }
+
+        // the left side goes on with partial, the right one starts over
+        Result right{context.identity};
+
+        auto walk_left = [&] {
+            if (node->left != nullptr) {
+                parallel_walk<order>(
+                    node->left, depth + 1, levels - 1, partial, context);
+            }
+            if constexpr (order == Order::in) {
+                data_visit(node, context.visit, partial);
+            }
+        };
+        auto walk_right = [&] {
+            if (node->right != nullptr) {
+                parallel_walk<order>(
+                    node->right, depth + 1, levels - 1, right, context);
+            }
+        };
+
+        if constexpr (order == Order::pre) {
+            data_visit(node, context.visit, partial);
+        }
+
+        context.pool.fork_join(walk_left, walk_right);
+        partial = context.combine(std::move(partial), std::move(right));
+
+        if constexpr (order == Order::post) {
+            data_visit(node, context.visit, partial);
+        }
+    }
 };
 
 #endif // BST_H
@@ -0,0 +1,1110 @@
+#ifndef COMPACT_RB_TREE_H
+#define COMPACT_RB_TREE_H
+
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* a red-black multiset whose nodes link to each other by 32-bit indices
+ *
+ * the nodes live next to each other in one vector, and every link (left,
+ * right and parent) is the index of a node in it rather than a pointer to it;
+ * the color of a node is kept in the top bit of its parent link; so the links
+ * of a node take 12 bytes instead of the 24 of a BstNode (e.g., a node of a
+ * 32-bit key takes 16 bytes instead of 32), and the nodes are not scattered
+ * over the heap
+ *
+ * the rotations, successor / predecessor and the insert and erase fixups are
+ * the ones of rb_tree (SEE: rb_tree::insert_fixup), written on indices
+ *
+ * an erased node leaves no hole: the last node of the vector is moved into
+ * its place; assign_sorted lays the nodes out in order, so that iterating
+ * over the tree then walks the vector from front to back
+ *
+ * the interface is the one of bst (without its parallel visitors and batch
+ * inserts), with two differences: it holds at most max_size() elements, and
+ * erase moves one other element (the last one of the vector) to another
+ * index; so erase invalidates every iterator (but the one it returns),
+ * whereas insert invalidates none
+ *
+ * NOTE: the elements are moved around with their move constructor and move
+ * assignment, which must not throw */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class compact_rb_tree
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>
+                  && std::is_nothrow_move_assignable_v<T>);
+
+    using Index = std::uint32_t;
+
+    // the top bit of a parent link is the color; so an index has 31 bits, and
+    // the largest one stands for no node
+    static constexpr Index red_bit{Index{1} << 31};
+    static constexpr Index nil{red_bit - 1};
+
+    struct Node;
+
+    class ConstCompactIterator;
+
+    // SEE: bst::transparent
+    static constexpr bool transparent = requires {
+        typename Compare::is_transparent;
+    };
+
+    // SEE: bst::three_way
+    template <typename Lhs, typename Rhs>
+    static constexpr bool custom_three_way =
+        requires(const Compare& cmp, const Lhs& lhs, const Rhs& rhs) {
+            cmp.compare(lhs, rhs) < 0;
+            cmp.compare(lhs, rhs) == 0;
+        };
+
+    template <typename Lhs, typename Rhs>
+    static constexpr bool three_way =
+        custom_three_way<Lhs, Rhs>
+        || ((std::is_same_v<Compare, std::less<T>>
+             || std::is_same_v<Compare, std::less<>>)
+            && std::three_way_comparable_with<Lhs, Rhs>);
+
+    // true if order does not throw; SEE: order
+    template <typename Lhs, typename Rhs>
+    static constexpr bool nothrow_order = [] {
+        if constexpr (custom_three_way<Lhs, Rhs>) {
+            return noexcept(std::declval<const Compare&>().compare(
+                std::declval<const Lhs&>(), std::declval<const Rhs&>()));
+        } else {
+            return noexcept(std::compare_three_way{}(
+                std::declval<const Lhs&>(), std::declval<const Rhs&>()));
+        }
+    }();
+
+    // SEE: bst::nothrow_compare
+    template <typename Key>
+    static constexpr bool nothrow_compare =
+        noexcept(std::declval<const Compare&>()(std::declval<const Key&>(),
+                                                std::declval<const T&>()))
+        && noexcept(std::declval<const Compare&>()(std::declval<const T&>(),
+                                                   std::declval<const Key&>()))
+        && (!three_way<Key, T> || nothrow_order<Key, T>);
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using const_iterator         = ConstCompactIterator;
+    using iterator               = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator       = const_reverse_iterator;
+
+  private:
+    using AllocTraits   = std::allocator_traits<Allocator>;
+    using NodeAllocator = typename AllocTraits::template rebind_alloc<Node>;
+
+    struct Node {
+        template <typename... Args>
+        explicit Node(std::in_place_t, Args&&... args)
+            : data(std::forward<Args>(args)...)
+        {
+        }
+
+        T data;
+
+        Index left{nil};
+        Index right{nil};
+        Index parent{nil}; // NOTE: tagged with red_bit
+    };
+
+    class ConstCompactIterator
+    {
+        friend class compact_rb_tree;
+
+      private:
+        using Self = ConstCompactIterator;
+
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        ConstCompactIterator() noexcept = default;
+
+        const T& operator*() const noexcept
+        {
+            return tree_->nodes_[index_].data;
+        }
+
+        const T* operator->() const noexcept
+        {
+            return &tree_->nodes_[index_].data;
+        }
+
+        Self& operator++() noexcept
+        {
+            index_ = tree_->successor(index_);
+            return *this;
+        }
+
+        Self operator++(int) noexcept
+        {
+            Self tmp{*this};
+            ++*this;
+            return tmp;
+        }
+
+        Self& operator--() noexcept
+        {
+            index_ = index_ == nil ? tree_->max_ : tree_->predecessor(index_);
+            return *this;
+        }
+
+        Self operator--(int) noexcept
+        {
+            Self tmp{*this};
+            --*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.index_ == rhs.index_;
+        }
+
+        friend bool operator!=(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.index_ != rhs.index_;
+        }
+
+      private:
+        const compact_rb_tree* tree_{nullptr};
+        Index                  index_{nil};
+
+        ConstCompactIterator(const compact_rb_tree* tree, Index index) noexcept
+            : tree_{tree}
+            , index_{index}
+        {
+        }
+    };
+
+  public:
+    compact_rb_tree()
+        : compact_rb_tree{Compare{}}
+    {
+    }
+
+    explicit compact_rb_tree(const Compare& compare)
+        : compare_{compare}
+    {
+    }
+
+    // NOTE: the links are indices; so a copy is a copy of the vector
+    compact_rb_tree(const compact_rb_tree& that) = default;
+
+    compact_rb_tree(compact_rb_tree&& that) noexcept
+        : nodes_{std::move(that.nodes_)}
+        , root_{std::exchange(that.root_, nil)}
+        , min_{std::exchange(that.min_, nil)}
+        , max_{std::exchange(that.max_, nil)}
+        , compare_{that.compare_}
+    {
+        that.nodes_.clear();
+    }
+
+    compact_rb_tree& operator=(const compact_rb_tree& that)
+    {
+        if (this != &that) {
+            compact_rb_tree copy{that};
+            *this = std::move(copy);
+        }
+
+        return *this;
+    }
+
+    compact_rb_tree& operator=(compact_rb_tree&& that) noexcept
+    {
+        if (this != &that) {
+            nodes_ = std::move(that.nodes_);
+            that.nodes_.clear();
+            root_    = std::exchange(that.root_, nil);
+            min_     = std::exchange(that.min_, nil);
+            max_     = std::exchange(that.max_, nil);
+            compare_ = that.compare_;
+        }
+
+        return *this;
+    }
+
+    allocator_type get_allocator() const noexcept { return allocator_type{}; }
+    value_compare  value_comp() const { return compare_; }
+
+    [[nodiscard]] bool   empty() const noexcept { return nodes_.empty(); }
+    [[nodiscard]] size_t size() const noexcept { return nodes_.size(); }
+
+    [[nodiscard]] static constexpr size_t max_size() noexcept { return nil; }
+
+    // the number of levels
+    [[nodiscard]] size_t height() const
+    {
+        if (root_ == nil) return 0;
+
+        std::vector<std::pair<Index, size_t>> stack{{root_, 1}};
+
+        size_t height = 0;
+        while (!stack.empty()) {
+            auto [index, depth] = stack.back();
+            stack.pop_back();
+
+            height = std::max(height, depth);
+
+            const Node& node = nodes_[index];
+            if (node.left != nil) stack.emplace_back(node.left, depth + 1);
+            if (node.right != nil) stack.emplace_back(node.right, depth + 1);
+        }
+
+        return height;
+    }
+
+    /* true if the tree is a valid red-black tree: every child links back to
+     * its parent, the root is black, no red node has a red child, every path
+     * from the root down to a leaf passes as many black nodes, and the
+     * elements are in order; and every node of the vector is in the tree,
+     * and the minimum and maximum are the ones of the nodes
+     *
+     * NOTE: this walks the whole tree; it is meant for tests (SEE:
+     * rb_tree::verify) */
+    [[nodiscard]] bool verify() const
+    {
+        if (root_ == nil) {
+            return nodes_.empty() && min_ == nil && max_ == nil;
+        }
+
+        if (parent(root_) != nil || is_red(root_)) return false;
+
+        size_t count = 0;
+        if (!verify_subtree(root_, count).has_value()) return false;
+
+        return count == nodes_.size() && min_ == leftmost(root_)
+               && max_ == rightmost(root_)
+               && std::is_sorted(begin(), end(), compare_);
+    }
+
+    // makes room for n elements; so that the next inserts do not reallocate
+    void reserve(size_t n)
+    {
+        if (n > max_size()) throw std::length_error("compact_rb_tree");
+        nodes_.reserve(n);
+    }
+
+    void shrink_to_fit() { nodes_.shrink_to_fit(); }
+
+    void clear() noexcept
+    {
+        nodes_.clear();
+        root_ = min_ = max_ = nil;
+    }
+
+    iterator insert(const_iterator hint, const T& data)
+    {
+        return emplace_hint(hint, data);
+    }
+
+    iterator insert(const_iterator hint, T&& data)
+    {
+        return emplace_hint(hint, std::move(data));
+    }
+
+    iterator insert(const T& data) { return emplace(data); }
+
+    iterator insert(T&& data) { return emplace(std::move(data)); }
+
+    template <typename... Args>
+    iterator emplace(Args&&... args)
+    {
+        if (nodes_.size() == max_size()) [[unlikely]] {
+            throw std::length_error("compact_rb_tree");
+        }
+
+        nodes_.emplace_back(std::in_place, std::forward<Args>(args)...);
+        auto index = static_cast<Index>(nodes_.size() - 1);
+
+        try {
+            attach(index);
+        } catch (...) {
+            // NOTE: only a comparison throws, and that is before any link
+            nodes_.pop_back();
+            throw;
+        }
+
+        return iterator{this, index};
+    }
+
+    template <typename... Args>
+    iterator emplace_hint(const_iterator, Args&&... args)
+    {
+        return emplace(std::forward<Args>(args)...);
+    }
+
+    // NOTE: the elements are constructed from *first; so a move_iterator
+    // range is moved into the tree
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last)
+    {
+        for (; first != last; ++first) emplace(*first);
+    }
+
+    void insert(std::initializer_list<T> init)
+    {
+        insert(init.begin(), init.end());
+    }
+
+    /* replaces the contents of the tree with [first, last), which must already
+     * be sorted with respect to Compare
+     *
+     * the tree is built in O(n) without comparing any elements, and the nodes
+     * are laid out in order (the index of a node is its rank) */
+    template <typename ForwardIterator>
+    void assign_sorted(ForwardIterator first, ForwardIterator last)
+    {
+        clear();
+
+        auto n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0) return;
+
+        reserve(n);
+
+        // SEE: bst::assign_sorted
+        size_t height = 0;
+        while ((size_t{2} << height) <= n) ++height;
+
+        try {
+            root_ = build_sorted(first, n, 0, height);
+        } catch (...) {
+            clear();
+            throw;
+        }
+
+        min_ = 0;
+        max_ = static_cast<Index>(n - 1);
+    }
+
+    /* replaces the contents of the tree with the (unsorted) values in
+     * [first, last); the values are sorted and then built as in assign_sorted
+     *
+     * equivalent values keep their relative order */
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        std::vector<T, Allocator> values(first, last);
+        std::stable_sort(values.begin(), values.end(), compare_);
+
+        assign_sorted(std::make_move_iterator(values.begin()),
+                      std::make_move_iterator(values.end()));
+    }
+
+    // returns the element after pos
+    iterator erase(const_iterator pos) noexcept
+    {
+        Index index = pos.index_;
+        Index next  = successor(index);
+
+        detach(index);
+        return iterator{this, remove(index, next)};
+    }
+
+    iterator modify(const_iterator pos, const T& data)
+    {
+        return replace(pos, data);
+    }
+
+    iterator modify(const_iterator pos, T&& data)
+    {
+        return replace(pos, std::move(data));
+    }
+
+    iterator find(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find_of(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator find(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find_of(key);
+    }
+
+    // the first element not less than data
+    iterator lower_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, lower_bound_of(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator lower_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, lower_bound_of(key)};
+    }
+
+    // the first element greater than data
+    iterator upper_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, upper_bound_of(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator upper_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, upper_bound_of(key)};
+    }
+
+    std::pair<iterator, iterator> equal_range(const T& data) const
+        noexcept(nothrow_compare<T>)
+    {
+        return {lower_bound(data), upper_bound(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    std::pair<iterator, iterator> equal_range(const Key& key) const
+        noexcept(nothrow_compare<Key>)
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    // NOTE: the equivalent elements are stepped over one at a time
+    size_type count(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        auto [first, last] = equal_range(data);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    template <typename Key>
+        requires transparent
+    size_type count(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        auto [first, last] = equal_range(key);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    bool contains(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find(data) != end();
+    }
+
+    template <typename Key>
+        requires transparent
+    bool contains(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find(key) != end();
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return const_iterator{this, min_};
+    }
+
+    const_iterator begin() const noexcept { return cbegin(); }
+
+    const_iterator cend() const noexcept { return const_iterator{this, nil}; }
+
+    const_iterator end() const noexcept { return cend(); }
+
+    const_reverse_iterator crbegin() const noexcept
+    {
+        return const_reverse_iterator{cend()};
+    }
+
+    const_reverse_iterator rbegin() const noexcept { return crbegin(); }
+
+    const_reverse_iterator crend() const noexcept
+    {
+        return const_reverse_iterator{cbegin()};
+    }
+
+    const_reverse_iterator rend() const noexcept { return crend(); }
+
+    // the element at the root; or end() if the tree is empty. SEE: bst::root
+    const_iterator root() const noexcept { return const_iterator{this, root_}; }
+
+    template <typename Visitor, typename... Args>
+    void preorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it == end()) return;
+
+        std::vector<Index> stack{it.index_};
+        while (!stack.empty()) {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+
+            visit(node.data, args...);
+
+            if (node.right != nil) stack.push_back(node.right);
+            if (node.left != nil) stack.push_back(node.left);
+        }
+    }
+
+    template <typename Visitor, typename... Args>
+    void inorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it == end()) return;
+
+        // the walk ends at the maximum of the subtree
+        Index last = rightmost(it.index_);
+        for (Index index = leftmost(it.index_);; index = successor(index)) {
+            visit(nodes_[index].data, args...);
+            if (index == last) break;
+        }
+    }
+
+    template <typename Visitor, typename... Args>
+    void
+    postorder_from(const_iterator it, Visitor&& visit, Args&&... args) const
+    {
+        if (it == end()) return;
+
+        // a preorder walk with the children swapped, which is the postorder
+        // one backwards; SEE: bst::postorder_visit
+        std::vector<Index> pending{it.index_};
+        std::vector<Index> stack;
+        while (!pending.empty()) {
+            Index index = pending.back();
+            pending.pop_back();
+
+            stack.push_back(index);
+
+            const Node& node = nodes_[index];
+            if (node.left != nil) pending.push_back(node.left);
+            if (node.right != nil) pending.push_back(node.right);
+        }
+
+        for (; !stack.empty(); stack.pop_back()) {
+            visit(nodes_[stack.back()].data, args...);
+        }
+    }
+
+  private:
+    std::vector<Node, NodeAllocator> nodes_;
+
+    Index root_{nil};
+    Index min_{nil};
+    Index max_{nil};
+
+    [[no_unique_address]] Compare compare_;
+
+    Index parent(Index index) const noexcept
+    {
+        return nodes_[index].parent & ~red_bit;
+    }
+
+    void set_parent(Index index, Index parent) noexcept
+    {
+        Index& link = nodes_[index].parent;
+        link        = (link & red_bit) | parent;
+    }
+
+    // nil is black
+    bool is_red(Index index) const noexcept
+    {
+        return index != nil && (nodes_[index].parent & red_bit) != 0;
+    }
+
+    void set_red(Index index, bool red) noexcept
+    {
+        Index& link = nodes_[index].parent;
+        link        = red ? link | red_bit : link & ~red_bit;
+    }
+
+    Index leftmost(Index index) const noexcept
+    {
+        while (nodes_[index].left != nil) index = nodes_[index].left;
+        return index;
+    }
+
+    Index rightmost(Index index) const noexcept
+    {
+        while (nodes_[index].right != nil) index = nodes_[index].right;
+        return index;
+    }
+
+    /* the black height of the subtree at index (SEE: verify); or nothing if
+     * the subtree is not valid. count is increased by the number of its
+     * nodes */
+    std::optional<size_t> verify_subtree(Index index, size_t& count) const
+    {
+        if (index == nil) return 0;
+        if (index >= nodes_.size() || ++count > nodes_.size()) {
+            return std::nullopt;
+        }
+
+        const Node& node = nodes_[index];
+        for (Index child : {node.left, node.right}) {
+            if (child == nil) continue;
+            if (child >= nodes_.size() || parent(child) != index) {
+                return std::nullopt;
+            }
+            if (is_red(index) && is_red(child)) return std::nullopt;
+        }
+
+        auto left  = verify_subtree(node.left, count);
+        auto right = verify_subtree(node.right, count);
+
+        if (!left.has_value() || !right.has_value() || *left != *right) {
+            return std::nullopt;
+        }
+
+        return *left + (is_red(index) ? 0 : 1);
+    }
+
+    // the next index in order; nil after the last one
+    Index successor(Index index) const noexcept
+    {
+        if (nodes_[index].right != nil) return leftmost(nodes_[index].right);
+
+        Index up = parent(index);
+        while (up != nil && index == nodes_[up].right) {
+            index = up;
+            up    = parent(up);
+        }
+        return up;
+    }
+
+    // the previous index in order; nil before the first one
+    Index predecessor(Index index) const noexcept
+    {
+        if (nodes_[index].left != nil) return rightmost(nodes_[index].left);
+
+        Index up = parent(index);
+        while (up != nil && index == nodes_[up].left) {
+            index = up;
+            up    = parent(up);
+        }
+        return up;
+    }
+
+    // makes child take the place of old below parent (or as the root)
+    void replace_child(Index parent, Index old, Index child) noexcept
+    {
+        if (parent == nil) {
+            root_ = child;
+        } else if (nodes_[parent].left == old) {
+            nodes_[parent].left = child;
+        } else {
+            nodes_[parent].right = child;
+        }
+    }
+
+    void rotate_left(Index index) noexcept
+    {
+        Index pivot = nodes_[index].right;
+        Index inner = nodes_[pivot].left;
+
+        nodes_[index].right = inner;
+        if (inner != nil) set_parent(inner, index);
+
+        Index up = parent(index);
+        set_parent(pivot, up);
+        replace_child(up, index, pivot);
+
+        nodes_[pivot].left = index;
+        set_parent(index, pivot);
+    }
+
+    void rotate_right(Index index) noexcept
+    {
+        Index pivot = nodes_[index].left;
+        Index inner = nodes_[pivot].right;
+
+        nodes_[index].left = inner;
+        if (inner != nil) set_parent(inner, index);
+
+        Index up = parent(index);
+        set_parent(pivot, up);
+        replace_child(up, index, pivot);
+
+        nodes_[pivot].right = index;
+        set_parent(index, pivot);
+    }
+
+    // links the (unlinked) node at index into the tree, after the elements
+    // equivalent to it
+    void attach(Index index)
+    {
+        const T& data = nodes_[index].data;
+
+        Index up     = nil;
+        Index cursor = root_;
+        bool  less   = false;
+
+        while (cursor != nil) {
+            up     = cursor;
+            less   = compare_(data, nodes_[cursor].data);
+            cursor = less ? nodes_[cursor].left : nodes_[cursor].right;
+        }
+
+        Node& node = nodes_[index];
+        node.left = node.right = nil;
+        node.parent            = up | red_bit;
+
+        if (up == nil) {
+            root_ = min_ = max_ = index;
+        } else if (less) {
+            nodes_[up].left = index;
+            if (up == min_) min_ = index;
+        } else {
+            nodes_[up].right = index;
+            if (up == max_) max_ = index;
+        }
+
+        insert_fixup(index);
+    }
+
+    // SEE: rb_tree::insert_fixup
+    void insert_fixup(Index index) noexcept
+    {
+        while (is_red(parent(index))) {
+            Index up          = parent(index);
+            Index grandparent = parent(up);
+
+            if (up == nodes_[grandparent].left) {
+                Index uncle = nodes_[grandparent].right;
+
+                if (is_red(uncle)) {
+                    set_red(up, false);
+                    set_red(uncle, false);
+                    set_red(grandparent, true);
+                    index = grandparent;
+                    continue;
+                }
+
+                if (index == nodes_[up].right) {
+                    index = up;
+                    rotate_left(index);
+                    up = parent(index);
+                }
+
+                set_red(up, false);
+                set_red(grandparent, true);
+                rotate_right(grandparent);
+            } else {
+                Index uncle = nodes_[grandparent].left;
+
+                if (is_red(uncle)) {
+                    set_red(up, false);
+                    set_red(uncle, false);
+                    set_red(grandparent, true);
+                    index = grandparent;
+                    continue;
+                }
+
+                if (index == nodes_[up].left) {
+                    index = up;
+                    rotate_right(index);
+                    up = parent(index);
+                }
+
+                set_red(up, false);
+                set_red(grandparent, true);
+                rotate_left(grandparent);
+            }
+        }
+
+        set_red(root_, false);
+    }
+
+    // unlinks the node at index from the tree (it stays in the vector)
+    void detach(Index index) noexcept
+    {
+        if (index == min_) min_ = successor(index);
+        if (index == max_) max_ = predecessor(index);
+
+        Node& node = nodes_[index];
+
+        // child takes the place of the node that leaves its place in the tree
+        // (index, or its successor if it has two children); it may be nil,
+        // hence its parent is kept apart
+        Index child;
+        Index child_parent;
+        bool  removed_red;
+
+        if (node.left == nil || node.right == nil) {
+            child        = node.left != nil ? node.left : node.right;
+            child_parent = parent(index);
+            removed_red  = is_red(index);
+
+            if (child != nil) set_parent(child, child_parent);
+            replace_child(child_parent, index, child);
+        } else {
+            // the successor takes the place (and the color) of index
+            Index next  = leftmost(node.right);
+            child       = nodes_[next].right;
+            removed_red = is_red(next);
+
+            if (next == node.right) {
+                child_parent = next;
+            } else {
+                child_parent = parent(next);
+                if (child != nil) set_parent(child, child_parent);
+                nodes_[child_parent].left = child;
+
+                nodes_[next].right = node.right;
+                set_parent(node.right, next);
+            }
+
+            nodes_[next].left = node.left;
+            set_parent(node.left, next);
+
+            Index up = parent(index);
+            replace_child(up, index, next);
+            nodes_[next].parent = node.parent; // the color comes along
+        }
+
+        if (!removed_red) erase_fixup(child, child_parent);
+    }
+
+    // SEE: rb_tree::erase_fixup
+    void erase_fixup(Index index, Index up) noexcept
+    {
+        while (index != root_ && !is_red(index)) {
+            if (index == nodes_[up].left) {
+                Index sibling = nodes_[up].right;
+
+                if (is_red(sibling)) {
+                    set_red(sibling, false);
+                    set_red(up, true);
+                    rotate_left(up);
+                    sibling = nodes_[up].right;
+                }
+
+                if (!is_red(nodes_[sibling].left)
+                    && !is_red(nodes_[sibling].right)) {
+                    set_red(sibling, true);
+                    index = up;
+                    up    = parent(up);
+                    continue;
+                }
+
+                if (!is_red(nodes_[sibling].right)) {
+                    set_red(nodes_[sibling].left, false);
+                    set_red(sibling, true);
+                    rotate_right(sibling);
+                    sibling = nodes_[up].right;
+                }
+
+                set_red(sibling, is_red(up));
+                set_red(up, false);
+                set_red(nodes_[sibling].right, false);
+                rotate_left(up);
+            } else {
+                Index sibling = nodes_[up].left;
+
+                if (is_red(sibling)) {
+                    set_red(sibling, false);
+                    set_red(up, true);
+                    rotate_right(up);
+                    sibling = nodes_[up].left;
+                }
+
+                if (!is_red(nodes_[sibling].left)
+                    && !is_red(nodes_[sibling].right)) {
+                    set_red(sibling, true);
+                    index = up;
+                    up    = parent(up);
+                    continue;
+                }
+
+                if (!is_red(nodes_[sibling].left)) {
+                    set_red(nodes_[sibling].right, false);
+                    set_red(sibling, true);
+                    rotate_left(sibling);
+                    sibling = nodes_[up].left;
+                }
+
+                set_red(sibling, is_red(up));
+                set_red(up, false);
+                set_red(nodes_[sibling].left, false);
+                rotate_right(up);
+            }
+
+            index = root_;
+        }
+
+        if (index != nil) set_red(index, false);
+    }
+
+    /* drops the (detached) node at index from the vector by moving the last
+     * node into its place; returns where the node at next is afterwards */
+    Index remove(Index index, Index next) noexcept
+    {
+        auto last = static_cast<Index>(nodes_.size() - 1);
+
+        if (index != last) {
+            nodes_[index] = std::move(nodes_[last]);
+
+            // whatever linked to last links to index now
+            const Node& node = nodes_[index];
+            replace_child(parent(index), last, index);
+            if (node.left != nil) set_parent(node.left, index);
+            if (node.right != nil) set_parent(node.right, index);
+
+            if (min_ == last) min_ = index;
+            if (max_ == last) max_ = index;
+            if (next == last) next = index;
+        }
+
+        nodes_.pop_back();
+        return next;
+    }
+
+    template <typename Data>
+    iterator replace(const_iterator pos, Data&& data)
+    {
+        Index index = pos.index_;
+        T&    key   = nodes_[index].data;
+
+        if (!compare_(key, data) && !compare_(data, key)) {
+            // the element keeps its place; only the data changes
+            key = std::forward<Data>(data);
+            return pos;
+        }
+
+        // NOTE: data may refer to an element of the tree; so it is taken
+        // before anything moves; the node then keeps its index
+        T value(std::forward<Data>(data));
+        detach(index);
+        nodes_[index].data = std::move(value);
+
+        try {
+            attach(index);
+        } catch (...) {
+            // NOTE: a comparison threw; the node is dropped
+            remove(index, nil);
+            throw;
+        }
+
+        return iterator{this, index};
+    }
+
+    // the next n elements of it go to consecutive indices, in order; depth
+    // and height color the nodes as rb_tree::post_build does
+    template <typename ForwardIterator>
+    Index
+    build_sorted(ForwardIterator& it, size_t n, size_t depth, size_t height)
+    {
+        if (n == 0) return nil;
+
+        // the larger half goes right; SEE: bst::build_sorted
+        size_t left_n = (n - 1) / 2;
+        Index  left   = build_sorted(it, left_n, depth + 1, height);
+
+        nodes_.emplace_back(std::in_place, *it);
+        ++it;
+        auto index = static_cast<Index>(nodes_.size() - 1);
+
+        Index right = build_sorted(it, n - left_n - 1, depth + 1, height);
+
+        Node& node = nodes_[index];
+        node.left  = left;
+        node.right = right;
+        if (left != nil) set_parent(left, index);
+        if (right != nil) set_parent(right, index);
+        set_red(index, depth == height && depth != 0);
+
+        return index;
+    }
+
+    template <typename Key>
+    Index lower_bound_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        Index bound  = nil;
+        Index cursor = root_;
+
+        while (cursor != nil) {
+            const Node& node = nodes_[cursor];
+            if (compare_(node.data, key)) {
+                cursor = node.right;
+            } else {
+                bound  = cursor;
+                cursor = node.left;
+            }
+        }
+
+        return bound;
+    }
+
+    template <typename Key>
+    Index upper_bound_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        Index bound  = nil;
+        Index cursor = root_;
+
+        while (cursor != nil) {
+            const Node& node = nodes_[cursor];
+            if (compare_(key, node.data)) {
+                bound  = cursor;
+                cursor = node.left;
+            } else {
+                cursor = node.right;
+            }
+        }
+
+        return bound;
+    }
+
+    template <typename Lhs, typename Rhs>
+    auto order(const Lhs& lhs, const Rhs& rhs) const
+        noexcept(nothrow_order<Lhs, Rhs>)
+    {
+        if constexpr (custom_three_way<Lhs, Rhs>) {
+            return compare_.compare(lhs, rhs);
+        } else {
+            return std::compare_three_way{}(lhs, rhs);
+        }
+    }
+
+    template <typename Key>
+    iterator find_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        if constexpr (three_way<Key, T>) {
+            // one comparison per level; stop at the first equal node
+            Index cursor = root_;
+            while (cursor != nil) {
+                const Node& node = nodes_[cursor];
+
+                auto cmp = order(key, node.data);
+                if (cmp == 0) break;
+                cursor = cmp < 0 ? node.left : node.right;
+            }
+            return iterator{this, cursor};
+        } else {
+            Index index = lower_bound_of(key);
+            if (index != nil && compare_(key, nodes_[index].data)) index = nil;
+            return iterator{this, index};
+        }
+    }
+};
+
+#endif // COMPACT_RB_TREE_H
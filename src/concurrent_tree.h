@@ -0,0 +1,244 @@
+#ifndef CONCURRENT_TREE_H
+#define CONCURRENT_TREE_H
+
+#include "epoch_domain.h"
+#include "persistent_tree.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/* an ordered multiset whose readers never block
+ *
+ * the writers update a persistent_tree of their own and then publish a
+ * snapshot of it; the published snapshot shares its nodes with the writers'
+ * version, so the next update copies the path it changes instead of touching
+ * anything a reader may be on (SEE: persistent_tree)
+ *
+ * readers pin an epoch and read the published snapshot through a view
+ * (SEE: persistent_tree::version_view); they take no locks and write to no
+ * memory shared with other threads, so lookups and iteration scale with the
+ * number of readers
+ *
+ * a snapshot that has been replaced is retired through an epoch_domain; it is
+ * destroyed (dropping the nodes only it still refers to) once no reader pinned
+ * before it was replaced is left
+ *
+ * writers are serialized by a mutex of the tree; a single writer only pays
+ * for an uncontended lock
+ *
+ * NOTE: every update copies O(log n) nodes and retires the previous snapshot;
+ * update batches several changes into a single publication */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class concurrent_tree
+{
+    using Version = persistent_tree<T, Compare, Allocator>;
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using const_iterator         = typename Version::const_iterator;
+    using iterator               = const_iterator;
+    using const_reverse_iterator = typename Version::const_reverse_iterator;
+    using reverse_iterator       = const_reverse_iterator;
+
+    using version_view = typename Version::version_view;
+
+    /* the published version as of the time it was taken, pinned
+     *
+     * it is read through the lookups of version_view; its iterators are valid
+     * (and its contents unchanged) for as long as the guard lives, whatever
+     * the writers do meanwhile */
+    class read_guard;
+
+    class reader;
+
+  private:
+    // a base of read_guard ahead of its view; so the epoch is pinned before
+    // the published version is loaded
+    struct Pinned {
+        explicit Pinned(const epoch_domain::participant& participant) noexcept
+            : guard{participant.pin()}
+        {
+        }
+
+        epoch_domain::guard guard;
+    };
+
+  public:
+    class read_guard : private Pinned, public version_view
+    {
+        friend class reader;
+
+      public:
+        read_guard(const read_guard&)            = delete;
+        read_guard& operator=(const read_guard&) = delete;
+
+      private:
+        read_guard(const epoch_domain::participant& participant,
+                   const concurrent_tree&           tree) noexcept
+            : Pinned{participant}
+            , version_view{
+                  tree.published_.load(std::memory_order_seq_cst)->view()}
+        {
+        }
+    };
+
+    /* the handle of one reading thread
+     *
+     * it claims a slot of the tree's epoch_domain; so every thread takes its
+     * own reader (once) and reads through it, and no reader may outlive the
+     * tree */
+    class reader
+    {
+      public:
+        explicit reader(const concurrent_tree& tree)
+            : tree_{&tree}
+            , participant_{tree.domain_}
+        {
+        }
+
+        // SEE: read_guard
+        [[nodiscard]] read_guard read() const noexcept
+        {
+            return read_guard{participant_, *tree_};
+        }
+
+      private:
+        const concurrent_tree*     tree_;
+        epoch_domain::participant participant_;
+    };
+
+    concurrent_tree()
+        : concurrent_tree{Compare{}}
+    {
+    }
+
+    explicit concurrent_tree(const Compare& compare)
+        : live_{compare}
+        , published_{new Version{live_}}
+    {
+    }
+
+    concurrent_tree(const concurrent_tree&)            = delete;
+    concurrent_tree& operator=(const concurrent_tree&) = delete;
+
+    ~concurrent_tree() { delete published_.load(std::memory_order_relaxed); }
+
+    value_compare value_comp() const { return live_.value_comp(); }
+
+    reader make_reader() const { return reader{*this}; }
+
+    /* applies update to the writers' version of the tree and publishes the
+     * result once; update is called with a persistent_tree&
+     *
+     * if update (or publishing) throws nothing is published, and the writers'
+     * version goes back to the published one */
+    template <typename Update>
+    void update(Update&& update)
+    {
+        std::lock_guard<std::mutex> lock{write_mutex_};
+
+        try {
+            std::forward<Update>(update)(live_);
+            publish();
+        } catch (...) {
+            live_ = *published_.load(std::memory_order_relaxed);
+            throw;
+        }
+    }
+
+    void insert(const T& data)
+    {
+        update([&data](Version& tree) { tree.insert(data); });
+    }
+
+    void insert(T&& data)
+    {
+        update([&data](Version& tree) { tree.insert(std::move(data)); });
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args)
+    {
+        update([&args...](Version& tree) {
+            tree.emplace(std::forward<Args>(args)...);
+        });
+    }
+
+    // erases every element equivalent to data; returns how many there were
+    size_type erase(const T& data)
+    {
+        size_type erased{0};
+
+        update([&data, &erased](Version& tree) {
+            for (auto it = tree.find(data); it != tree.end();
+                 it      = tree.find(data)) {
+                tree.erase(it);
+                ++erased;
+            }
+        });
+
+        return erased;
+    }
+
+    void clear()
+    {
+        update([](Version& tree) { tree.clear(); });
+    }
+
+    // SEE: bst::assign_sorted
+    template <typename ForwardIterator>
+    void assign_sorted(ForwardIterator first, ForwardIterator last)
+    {
+        update([&first, &last](Version& tree) {
+            tree.assign_sorted(first, last);
+        });
+    }
+
+    // a snapshot of the published version; SEE: persistent_tree::snapshot
+    Version snapshot() const
+    {
+        std::lock_guard<std::mutex> lock{write_mutex_};
+        return *published_.load(std::memory_order_relaxed);
+    }
+
+    // NOTE: retired snapshots are otherwise only destroyed as more pile up
+    void collect() { domain_.collect(); }
+
+  private:
+    // the writers' version; only touched under write_mutex_
+    Version live_;
+
+    std::atomic<Version*> published_;
+
+    mutable epoch_domain domain_;
+    mutable std::mutex   write_mutex_;
+
+    // NOTE: the caller holds write_mutex_
+    void publish()
+    {
+        // so that retiring prev cannot throw once next is published
+        domain_.reserve();
+
+        auto* next = new Version{live_};
+
+        Version* prev = published_.exchange(next, std::memory_order_seq_cst);
+        domain_.retire(prev);
+    }
+};
+
+#endif // CONCURRENT_TREE_H
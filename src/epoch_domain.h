@@ -0,0 +1,250 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/* epoch-based reclamation
+ *
+ * readers pin the domain while they use shared objects; an object a writer
+ * has unlinked is retired instead of being deleted, and it is deleted once no
+ * reader that might still see it is pinned
+ *
+ * retiring stamps the object with the current epoch and advances the epoch;
+ * readers pinning after that announce a later epoch, and they can only reach
+ * what was linked at the time, so the object is deleted once no pinned reader
+ * announces its epoch (or an earlier one)
+ *
+ * every reading thread takes a participant (a slot of its own, on a cache
+ * line of its own) once and pins through it; pinning only writes to that
+ * slot, so readers do not contend with each other or with the writers
+ *
+ * NOTE: every participant has to be gone before the domain is destroyed */
+class epoch_domain
+{
+    struct Record;
+
+  public:
+    class guard;
+    class participant;
+
+    epoch_domain() = default;
+
+    epoch_domain(const epoch_domain&)            = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    ~epoch_domain()
+    {
+        for (const Retired& retired : retired_) retired.dispose(retired.ptr);
+
+        Record* record = records_.load(std::memory_order_acquire);
+        while (record != nullptr) delete std::exchange(record, record->next);
+    }
+
+    /* deletes ptr once no reader can see it any more; ptr has to be unlinked
+     * already (i.e., no reader pinning from now on can reach it)
+     *
+     * the objects are deleted by whichever thread retires or collects
+     *
+     * NOTE: retire only throws if it has to make room for ptr, and then ptr
+     * is neither deleted nor retired; SEE: reserve */
+    template <typename U>
+    void retire(U* ptr)
+    {
+        retire(ptr, [](void* ptr) { delete static_cast<U*>(ptr); });
+    }
+
+    void retire(void* ptr, void (*dispose)(void*))
+    {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+
+        retired_.push_back(
+            {ptr, dispose, epoch_.fetch_add(1, std::memory_order_seq_cst)});
+
+        if (retired_.size() >= collect_at_) collect_retired();
+    }
+
+    /* makes room for the next retire, so that it cannot throw (unless
+     * another thread retires in between)
+     *
+     * the room grows geometrically, so reserving before every retire is
+     * amortized O(1) */
+    void reserve()
+    {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+
+        if (retired_.size() == retired_.capacity()) {
+            retired_.reserve(
+                std::max(collect_threshold, 2 * retired_.capacity()));
+        }
+    }
+
+    // deletes what has been retired and can no longer be seen
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        collect_retired();
+    }
+
+    // pins the domain until the guard is destroyed; guards of the same
+    // participant may be nested
+    class guard
+    {
+        friend class participant;
+
+      public:
+        guard(const guard&)            = delete;
+        guard& operator=(const guard&) = delete;
+
+        ~guard()
+        {
+            if (--record_->pins == 0) {
+                record_->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+      private:
+        Record* record_;
+
+        guard(Record* record, const std::atomic<std::uint64_t>& epoch) noexcept
+            : record_{record}
+        {
+            if (record_->pins++ == 0) {
+                // NOTE: the announcement has to be visible before anything
+                // shared is read; SEE: retire
+                record_->epoch.store(epoch.load(std::memory_order_seq_cst),
+                                     std::memory_order_seq_cst);
+            }
+        }
+    };
+
+    // the slot of one reading thread; SEE: epoch_domain
+    class participant
+    {
+      public:
+        explicit participant(epoch_domain& domain)
+            : domain_{&domain}
+            , record_{domain.claim()}
+        {
+        }
+
+        participant(participant&& that) noexcept
+            : domain_{that.domain_}
+            , record_{std::exchange(that.record_, nullptr)}
+        {
+        }
+
+        participant(const participant&)            = delete;
+        participant& operator=(const participant&) = delete;
+        participant& operator=(participant&&)      = delete;
+
+        // the slot is given back to the domain for the next participant
+        ~participant()
+        {
+            if (record_ != nullptr) {
+                record_->claimed.store(false, std::memory_order_release);
+            }
+        }
+
+        [[nodiscard]] guard pin() const noexcept
+        {
+            return guard{record_, domain_->epoch_};
+        }
+
+      private:
+        epoch_domain* domain_;
+        Record*       record_;
+    };
+
+  private:
+    // NOTE: 64 rather than std::hardware_destructive_interference_size, whose
+    // value is not stable across compiler flags
+    struct alignas(64) Record {
+        // the epoch announced by a pinned reader; 0 if it is not pinned
+        std::atomic<std::uint64_t> epoch{0};
+        std::atomic<bool>          claimed{true};
+
+        // only touched by the thread owning the record
+        size_t pins{0};
+
+        Record* next{nullptr};
+    };
+
+    struct Retired {
+        void* ptr;
+        void (*dispose)(void*);
+        std::uint64_t epoch;
+    };
+
+    static constexpr size_t collect_threshold{64};
+
+    std::atomic<std::uint64_t> epoch_{1};
+
+    // records are never unlinked (only given back) while the domain lives
+    std::atomic<Record*> records_{nullptr};
+
+    std::mutex           retired_mutex_;
+    std::vector<Retired> retired_;
+
+    /* the size at which retire collects; twice what the last collection had
+     * to keep, so that a reader pinned for long (which keeps everything
+     * retired since) does not make every retire walk the whole list */
+    size_t collect_at_{collect_threshold};
+
+    Record* claim()
+    {
+        Record* record = records_.load(std::memory_order_acquire);
+
+        for (; record != nullptr; record = record->next) {
+            bool claimed = false;
+            if (record->claimed.compare_exchange_strong(
+                    claimed, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        record       = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next,
+                                               record,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+
+        return record;
+    }
+
+    // NOTE: the caller holds retired_mutex_
+    void collect_retired()
+    {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+
+        for (Record* record = records_.load(std::memory_order_acquire);
+             record != nullptr;
+             record = record->next) {
+            std::uint64_t epoch = record->epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0) oldest = std::min(oldest, epoch);
+        }
+
+        // a reader pinned at epoch e can only see what was retired at e or
+        // later
+        auto kept = std::partition(retired_.begin(),
+                                   retired_.end(),
+                                   [oldest](const Retired& retired) {
+                                       return retired.epoch >= oldest;
+                                   });
+
+        for (auto it = kept; it != retired_.end(); ++it) it->dispose(it->ptr);
+        retired_.erase(kept, retired_.end());
+
+        collect_at_ = std::max(collect_threshold, 2 * retired_.size());
+    }
+};
+
+#endif // EPOCH_DOMAIN_H
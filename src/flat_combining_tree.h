@@ -0,0 +1,353 @@
+#ifndef FLAT_COMBINING_TREE_H
+#define FLAT_COMBINING_TREE_H
+
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* an rb_tree whose writers combine their updates
+ *
+ * with many threads updating one tree behind a lock, handing the lock over
+ * costs more than the update itself; here every writing thread posts its
+ * update to a slot of its own instead, and whichever thread gets the lock
+ * applies every posted update (its own included) in one go, while the others
+ * wait for theirs to be done rather than for the lock
+ *
+ * the posted updates are sorted before they are applied; so neighbouring keys
+ * are inserted one after the other (each one hinted with the position after
+ * the previous), and the descents share the nodes that are already cached
+ *
+ * every writing thread takes a writer (a slot of its own, on a cache line of
+ * its own) once and updates through it; SEE: epoch_domain::participant
+ *
+ * NOTE: every writer has to be gone before the tree is destroyed */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class flat_combining_tree
+{
+    using Tree = rb_tree<T, Compare, Allocator>;
+
+    struct Record;
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using tree_type = Tree;
+
+    // a waiting writer tries to combine every lock_interval rounds; SEE: post
+    static constexpr size_t lock_interval{16};
+
+    /* the handle of one writing thread
+     *
+     * every update blocks until it has been applied (by whichever thread is
+     * combining at the time); an exception thrown while applying it is
+     * rethrown here */
+    class writer
+    {
+      public:
+        explicit writer(flat_combining_tree& tree)
+            : tree_{&tree}
+            , record_{tree.claim()}
+        {
+        }
+
+        writer(writer&& that) noexcept
+            : tree_{that.tree_}
+            , record_{std::exchange(that.record_, nullptr)}
+        {
+        }
+
+        writer(const writer&)            = delete;
+        writer& operator=(const writer&) = delete;
+        writer& operator=(writer&&)      = delete;
+
+        // the slot is given back to the tree for the next writer
+        ~writer()
+        {
+            if (record_ != nullptr) {
+                record_->claimed.store(false, std::memory_order_release);
+            }
+        }
+
+        void insert(const T& data)
+        {
+            tree_->post(record_, Op::insert, &data, nullptr);
+        }
+
+        void insert(T&& data)
+        {
+            tree_->post(record_, Op::insert, &data, &data);
+        }
+
+        // erases every element equivalent to data; returns how many there were
+        size_type erase(const T& data)
+        {
+            return tree_->post(record_, Op::erase, &data, nullptr);
+        }
+
+      private:
+        flat_combining_tree* tree_;
+        Record*              record_;
+    };
+
+    flat_combining_tree()
+        : flat_combining_tree{Compare{}}
+    {
+    }
+
+    explicit flat_combining_tree(const Compare& compare)
+        : tree_{compare}
+    {
+    }
+
+    flat_combining_tree(const flat_combining_tree&)            = delete;
+    flat_combining_tree& operator=(const flat_combining_tree&) = delete;
+
+    ~flat_combining_tree()
+    {
+        Record* record = records_.load(std::memory_order_acquire);
+        while (record != nullptr) delete std::exchange(record, record->next);
+    }
+
+    value_compare value_comp() const { return tree_.value_comp(); }
+
+    writer make_writer() { return writer{*this}; }
+
+    // NOTE: the size as of the last combining pass
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    /* calls visit with the tree (as a const tree_type&) while holding the
+     * lock; the posted updates wait until it returns
+     *
+     * NOTE: the iterators of the tree are only valid inside visit */
+    template <typename Visitor>
+    decltype(auto) read(Visitor&& visit) const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return std::forward<Visitor>(visit)(std::as_const(tree_));
+    }
+
+    /* calls update with the tree (as a tree_type&) while holding the lock;
+     * for the updates that writers do not post (e.g., bulk loads) */
+    template <typename Update>
+    void update(Update&& update)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        try {
+            std::forward<Update>(update)(tree_);
+        } catch (...) {
+            size_.store(tree_.size(), std::memory_order_relaxed);
+            throw;
+        }
+
+        size_.store(tree_.size(), std::memory_order_relaxed);
+    }
+
+  private:
+    enum class Op : unsigned char { insert, erase };
+
+    enum class State : unsigned char { idle, posted, done };
+
+    // NOTE: 64 rather than std::hardware_destructive_interference_size;
+    // SEE: epoch_domain::Record
+    struct alignas(64) Record {
+        std::atomic<State> state{State::idle};
+        std::atomic<bool>  claimed{true};
+
+        // the posted update; written by the owner before it is posted, and
+        // by the combiner before it is done
+        Op       op{Op::insert};
+        const T* data{nullptr};
+        T*       movable{nullptr}; // data, if it may be moved from
+        size_t   result{0};
+
+        std::exception_ptr error;
+
+        Record* next{nullptr};
+    };
+
+    Tree tree_;
+
+    std::atomic<size_t> size_{0};
+
+    mutable std::mutex mutex_;
+
+    // records are never unlinked (only given back) while the tree lives
+    std::atomic<Record*> records_{nullptr};
+
+    // the updates of the current combining pass; guarded by mutex_
+    std::vector<Record*> batch_;
+
+    Record* claim()
+    {
+        Record* record = records_.load(std::memory_order_acquire);
+
+        for (; record != nullptr; record = record->next) {
+            bool claimed = false;
+            if (record->claimed.compare_exchange_strong(
+                    claimed, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        record       = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next,
+                                               record,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+
+        return record;
+    }
+
+    // posts an update and waits until it has been applied; returns its result
+    size_t post(Record* record, Op op, const T* data, T* movable)
+    {
+        record->op      = op;
+        record->data    = data;
+        record->movable = movable;
+        record->state.store(State::posted, std::memory_order_release);
+
+        // the waiter watches its own record, which only the combiner writes
+        // to; the lock (which every waiter would hand around) is only tried
+        // every lock_interval rounds, in case no one is combining
+        for (size_t round = 0;
+             record->state.load(std::memory_order_acquire) != State::done;
+             ++round) {
+            if (round % lock_interval == 0) {
+                std::unique_lock<std::mutex> lock{mutex_, std::try_to_lock};
+
+                // NOTE: our own update was posted before; so it is done once
+                // this pass is
+                if (lock.owns_lock()) {
+                    combine();
+                    continue;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+
+        record->state.store(State::idle, std::memory_order_relaxed);
+
+        if (record->error) [[unlikely]] {
+            std::rethrow_exception(std::exchange(record->error, nullptr));
+        }
+
+        return record->result;
+    }
+
+    /* NOTE: the caller holds mutex_
+     *
+     * every update posted when the pass starts is done when it ends, even if
+     * the batch cannot be collected or sorted; its poster may be waiting on
+     * it with data that lives on its stack */
+    void combine() noexcept
+    {
+        // every key of the batch is not less than the ones before it; so it
+        // goes right after them (the first one has no hint to go by)
+        auto hint = tree_.end();
+
+        try {
+            batch_.clear();
+
+            for (Record* record = records_.load(std::memory_order_acquire);
+                 record != nullptr;
+                 record = record->next) {
+                if (record->state.load(std::memory_order_acquire)
+                    == State::posted) {
+                    batch_.push_back(record);
+                }
+            }
+
+            // the updates are concurrent; so any order is a valid one
+            std::sort(batch_.begin(),
+                      batch_.end(),
+                      [compare = tree_.value_comp()](const Record* lhs,
+                                                     const Record* rhs) {
+                          return compare(*lhs->data, *rhs->data);
+                      });
+        } catch (...) {
+            // a sort that throws may leave the batch scrambled; so the
+            // updates are applied in the order of the records instead (the
+            // hints are then only as good as that order)
+            for (Record* record = records_.load(std::memory_order_acquire);
+                 record != nullptr;
+                 record = record->next) {
+                if (record->state.load(std::memory_order_acquire)
+                    == State::posted) {
+                    hint = finish(*record, hint);
+                }
+            }
+
+            size_.store(tree_.size(), std::memory_order_relaxed);
+            return;
+        }
+
+        for (Record* record : batch_) hint = finish(*record, hint);
+
+        size_.store(tree_.size(), std::memory_order_relaxed);
+    }
+
+    // applies the update of record and marks it done; SEE: apply
+    typename Tree::iterator finish(Record&                 record,
+                                   typename Tree::iterator hint) noexcept
+    {
+        try {
+            hint = apply(record, hint);
+        } catch (...) {
+            record.error = std::current_exception();
+        }
+
+        record.state.store(State::done, std::memory_order_release);
+        return hint;
+    }
+
+    typename Tree::iterator apply(Record& record, typename Tree::iterator hint)
+    {
+        if (record.op == Op::erase) {
+            auto [it, last] = tree_.equal_range(*record.data);
+
+            size_t erased = 0;
+            for (; it != last; ++erased) it = tree_.erase(it);
+
+            record.result = erased;
+            return it;
+        }
+
+        auto it = record.movable != nullptr
+                      ? tree_.insert(hint, std::move(*record.movable))
+                      : tree_.insert(hint, *record.data);
+
+        record.result = 1;
+        return std::next(it);
+    }
+};
+
+#endif // FLAT_COMBINING_TREE_H
@@ -0,0 +1,403 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* an immutable ordered multiset laid out for lookups
+ *
+ * the elements are stored in one array in Eytzinger (i.e., breadth-first)
+ * order: the root is at position 1 and the children of position k at 2k and
+ * 2k + 1; so a search is an index computation per level instead of a pointer
+ * to chase, and the top levels of every search share the same few cache lines
+ *
+ * the descent has no data dependent branches (the comparison only decides the
+ * next index), and the grandchildren of the current position (which are next
+ * to each other) are prefetched while it compares; so the cache misses of the
+ * levels below overlap with the comparisons above them
+ *
+ * a frozen_tree is built once from a sorted range, or from any ordered
+ * container (e.g., a rb_tree), in O(n); iterating over it visits the positions
+ * in order (each step is O(1) amortized)
+ *
+ * NOTE: the positions are 1-based; the element at position k is data_[k - 1]
+ * and position 0 is end() */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class frozen_tree
+{
+    class ConstEytzingerIterator;
+
+    // SEE: bst::transparent
+    static constexpr bool transparent = requires {
+        typename Compare::is_transparent;
+    };
+
+    // SEE: bst::nothrow_compare
+    template <typename Key>
+    static constexpr bool nothrow_compare =
+        noexcept(std::declval<const Compare&>()(std::declval<const Key&>(),
+                                                std::declval<const T&>()))
+        && noexcept(std::declval<const Compare&>()(std::declval<const T&>(),
+                                                   std::declval<const Key&>()));
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using const_iterator         = ConstEytzingerIterator;
+    using iterator               = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator       = const_reverse_iterator;
+
+  private:
+    class ConstEytzingerIterator
+    {
+        friend class frozen_tree;
+
+      private:
+        using Self = ConstEytzingerIterator;
+
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        const T& operator*() const noexcept { return tree_->at(pos_); }
+        const T* operator->() const noexcept { return &tree_->at(pos_); }
+
+        Self& operator++() noexcept
+        {
+            pos_ = tree_->next(pos_);
+            return *this;
+        }
+
+        Self operator++(int) noexcept
+        {
+            Self tmp{*this};
+            ++*this;
+            return tmp;
+        }
+
+        Self& operator--() noexcept
+        {
+            pos_ = tree_->prev(pos_);
+            return *this;
+        }
+
+        Self operator--(int) noexcept
+        {
+            Self tmp{*this};
+            --*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.pos_ == rhs.pos_;
+        }
+
+        friend bool operator!=(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.pos_ != rhs.pos_;
+        }
+
+      private:
+        const frozen_tree* tree_;
+        size_t             pos_;
+
+        ConstEytzingerIterator(const frozen_tree* tree, size_t pos) noexcept
+            : tree_{tree}
+            , pos_{pos}
+        {
+        }
+    };
+
+  public:
+    frozen_tree()
+        : frozen_tree{Compare{}}
+    {
+    }
+
+    explicit frozen_tree(const Compare& compare)
+        : compare_{compare}
+    {
+    }
+
+    // [first, last) must already be sorted with respect to Compare
+    template <typename InputIterator>
+    frozen_tree(InputIterator  first,
+                InputIterator  last,
+                const Compare& compare = Compare{})
+        : compare_{compare}
+    {
+        std::vector<T, Allocator> sorted(first, last);
+        size_t                    n = sorted.size();
+
+        // the rank of the element at every position; found by walking the
+        // positions in order
+        std::vector<size_t> rank(n);
+        size_t              pos = first_position(n);
+        for (size_t i = 0; i < n; ++i, pos = next_position(pos, n)) {
+            rank[pos - 1] = i;
+        }
+
+        data_.reserve(n);
+        for (size_t r : rank) data_.push_back(std::move(sorted[r]));
+    }
+
+    // freezes the current contents of an ordered container
+    template <typename Tree>
+        requires requires(const Tree& tree) {
+            tree.begin();
+            tree.end();
+            { tree.value_comp() } -> std::convertible_to<Compare>;
+        }
+    explicit frozen_tree(const Tree& tree)
+        : frozen_tree{tree.begin(), tree.end(), tree.value_comp()}
+    {
+    }
+
+    allocator_type get_allocator() const noexcept { return allocator_type{}; }
+    value_compare  value_comp() const { return compare_; }
+
+    [[nodiscard]] bool   empty() const noexcept { return data_.empty(); }
+    [[nodiscard]] size_t size() const noexcept { return data_.size(); }
+
+    // the number of levels; every search compares at most this many times
+    [[nodiscard]] size_t height() const noexcept
+    {
+        return std::bit_width(data_.size());
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return const_iterator{this, first_position(data_.size())};
+    }
+
+    const_iterator end() const noexcept { return const_iterator{this, 0}; }
+
+    const_reverse_iterator rbegin() const noexcept
+    {
+        return const_reverse_iterator{end()};
+    }
+
+    const_reverse_iterator rend() const noexcept
+    {
+        return const_reverse_iterator{begin()};
+    }
+
+    iterator find(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find_of(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator find(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find_of(key);
+    }
+
+    // the first element not less than data
+    iterator lower_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, lower_bound_of(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator lower_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, lower_bound_of(key)};
+    }
+
+    // the first element greater than data
+    iterator upper_bound(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return iterator{this, upper_bound_of(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator upper_bound(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return iterator{this, upper_bound_of(key)};
+    }
+
+    std::pair<iterator, iterator> equal_range(const T& data) const
+        noexcept(nothrow_compare<T>)
+    {
+        return {lower_bound(data), upper_bound(data)};
+    }
+
+    template <typename Key>
+        requires transparent
+    std::pair<iterator, iterator> equal_range(const Key& key) const
+        noexcept(nothrow_compare<Key>)
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    // NOTE: the equivalent elements are stepped over one at a time
+    size_type count(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        auto [first, last] = equal_range(data);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    template <typename Key>
+        requires transparent
+    size_type count(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        auto [first, last] = equal_range(key);
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    bool contains(const T& data) const noexcept(nothrow_compare<T>)
+    {
+        return find(data) != end();
+    }
+
+    template <typename Key>
+        requires transparent
+    bool contains(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return find(key) != end();
+    }
+
+  private:
+    std::vector<T, Allocator> data_;
+
+    [[no_unique_address]] Compare compare_;
+
+    const T& at(size_t pos) const noexcept { return data_[pos - 1]; }
+
+    static void prefetch(const void* ptr) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(ptr);
+#else
+        static_cast<void>(ptr);
+#endif
+    }
+
+    // the leftmost position; 0 if there is none
+    static size_t first_position(size_t n) noexcept
+    {
+        if (n == 0) return 0;
+        return std::bit_floor(n);
+    }
+
+    // the rightmost position; 0 if there is none
+    static size_t last_position(size_t n) noexcept
+    {
+        size_t pos = 0;
+        while (2 * pos + 1 <= n) pos = 2 * pos + 1;
+        return pos;
+    }
+
+    // the in-order successor of pos (0 after the last one)
+    static size_t next_position(size_t pos, size_t n) noexcept
+    {
+        if (2 * pos + 1 <= n) {
+            // the leftmost position of the right subtree
+            pos = 2 * pos + 1;
+            while (2 * pos <= n) pos *= 2;
+            return pos;
+        }
+
+        // up past every right child, then up once more
+        return pos >> (std::countr_one(pos) + 1);
+    }
+
+    // the in-order predecessor of pos (the last one before 0)
+    static size_t prev_position(size_t pos, size_t n) noexcept
+    {
+        if (pos == 0) [[unlikely]] return last_position(n);
+
+        if (2 * pos <= n) {
+            // the rightmost position of the left subtree
+            pos *= 2;
+            while (2 * pos + 1 <= n) pos = 2 * pos + 1;
+            return pos;
+        }
+
+        // up past every left child, then up once more
+        return pos >> (std::countr_zero(pos) + 1);
+    }
+
+    size_t next(size_t pos) const noexcept
+    {
+        return next_position(pos, data_.size());
+    }
+
+    size_t prev(size_t pos) const noexcept
+    {
+        return prev_position(pos, data_.size());
+    }
+
+    /* descends to a leaf, going right whenever go_right(element) holds; the
+     * answer is the last position the descent went left at, i.e., the one
+     * that is left once the trailing right turns (and the last left turn)
+     * are shifted off */
+    template <typename GoRight>
+    size_t descend(GoRight&& go_right) const
+        noexcept(noexcept(go_right(std::declval<const T&>())))
+    {
+        const size_t n    = data_.size();
+        const T*     base = data_.data();
+
+        size_t pos = 1;
+        while (pos <= n) {
+            // the grandchildren are at 4 * pos to 4 * pos + 3
+            if (4 * pos <= n) prefetch(base + (4 * pos - 1));
+            pos = 2 * pos + static_cast<size_t>(go_right(base[pos - 1]));
+        }
+
+        return pos >> (std::countr_one(pos) + 1);
+    }
+
+    template <typename Key>
+    size_t lower_bound_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return descend([this, &key](const T& data) {
+            return compare_(data, key);
+        });
+    }
+
+    template <typename Key>
+    size_t upper_bound_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        return descend([this, &key](const T& data) {
+            return !compare_(key, data);
+        });
+    }
+
+    template <typename Key>
+    iterator find_of(const Key& key) const noexcept(nothrow_compare<Key>)
+    {
+        size_t pos = lower_bound_of(key);
+        if (pos != 0 && compare_(key, at(pos))) pos = 0;
+        return iterator{this, pos};
+    }
+};
+
+#endif // FROZEN_TREE_H
@@ -0,0 +1,985 @@
+#ifndef PERSISTENT_TREE_H
+#define PERSISTENT_TREE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* an ordered multiset whose copies share their nodes
+ *
+ * the nodes are reference counted and never change once more than one version
+ * of the tree refers to them; an update copies the shared nodes on the path it
+ * changes (path copying) and leaves the rest of the tree shared, so copying a
+ * tree (SEE: snapshot) is O(1) and an update copies O(log n) nodes at most;
+ * nodes no other version refers to are updated in place
+ *
+ * versions only share the reference counts, which are atomic; so a version may
+ * be read (or copied) on any number of threads while other versions of the same
+ * tree are updated
+ *
+ * NOTE: unlike bst the nodes have no parent link (a shared node would need one
+ * per version); iterators carry the path from the root instead, and the tree is
+ * kept balanced as an AVL tree since that only ever rotates the nodes on the
+ * updated path and their children */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>>
+class persistent_tree
+{
+    struct Node;
+    class ConstPathIterator;
+    class VersionView;
+
+    using AllocTraits   = std::allocator_traits<Allocator>;
+    using NodeAllocator = typename AllocTraits::template rebind_alloc<Node>;
+    using NodeTraits    = std::allocator_traits<NodeAllocator>;
+
+    // SEE: bst::transparent
+    static constexpr bool transparent = requires {
+        typename Compare::is_transparent;
+    };
+
+    // SEE: bst::nothrow_compare
+    template <typename Key>
+    static constexpr bool nothrow_compare =
+        noexcept(std::declval<const Compare&>()(std::declval<const Key&>(),
+                                                std::declval<const T&>()))
+        && noexcept(std::declval<const Compare&>()(std::declval<const T&>(),
+                                                   std::declval<const Key&>()));
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using pointer       = typename AllocTraits::pointer;
+    using const_pointer = typename AllocTraits::const_pointer;
+
+    using const_iterator         = ConstPathIterator;
+    using iterator               = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator       = const_reverse_iterator;
+
+    using version_view = VersionView;
+
+  private:
+    struct Node {
+        template <typename... Args>
+        explicit Node(std::in_place_t /*tag*/, Args&&... args)
+            : data(std::forward<Args>(args)...)
+        {
+        }
+
+        // NOTE: the copy refers to the same children; the caller takes the
+        // extra references to them
+        Node(const Node& that)
+            : data{that.data}
+            , left{that.left}
+            , right{that.right}
+            , height{that.height}
+        {
+        }
+
+        Node& operator=(const Node&) = delete;
+
+        T data;
+
+        Node* left{nullptr};
+        Node* right{nullptr};
+
+        // the versions and parents referring to this node
+        std::atomic<std::uint32_t> refs{1};
+
+        // of the subtree at this node; a leaf has height 1
+        std::uint8_t height{1};
+    };
+
+    /* iterators keep the path from the root to their node (the path is empty
+     * for end()); so an increment is amortized O(1) without parent links
+     *
+     * the path is kept inline; an AVL tree of height h has at least
+     * F(h + 2) - 1 nodes (F being the Fibonacci numbers), which is more than
+     * fit in memory long before h reaches max_height
+     *
+     * NOTE: an update of a version invalidates all of its iterators (the nodes
+     * on their paths may have been copied or rotated); iterators of the other
+     * versions stay valid */
+    class ConstPathIterator
+    {
+        friend class persistent_tree;
+
+      private:
+        using Self = ConstPathIterator;
+
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        ConstPathIterator() = default;
+
+        // NOTE: only the used part of the path is copied
+        ConstPathIterator(const ConstPathIterator& that) noexcept
+            : root_{that.root_}
+            , depth_{that.depth_}
+        {
+            std::copy_n(that.path_.begin(), depth_, path_.begin());
+        }
+
+        ConstPathIterator& operator=(const Self& that) noexcept
+        {
+            root_  = that.root_;
+            depth_ = that.depth_;
+            std::copy_n(that.path_.begin(), depth_, path_.begin());
+            return *this;
+        }
+
+        const T& operator*() const noexcept { return node()->data; }
+
+        const T* operator->() const noexcept
+        {
+            return std::addressof(node()->data);
+        }
+
+        Self& operator++() noexcept
+        {
+            // end() is a ring position; SEE: bst::ConstBstNodeIterator
+            if (depth_ == 0) [[unlikely]] {
+                push_leftmost(root_);
+                return *this;
+            }
+
+            const Node* node = this->node();
+
+            if (node->right != nullptr) {
+                push_leftmost(node->right);
+                return *this;
+            }
+
+            // go up until we come from a left child; its parent is next
+            const Node* child{nullptr};
+            do {
+                child = path_[--depth_];
+            } while (depth_ > 0 && path_[depth_ - 1]->right == child);
+
+            return *this;
+        }
+
+        Self operator++(int) noexcept
+        {
+            Self tmp{*this};
+            ++*this;
+            return tmp;
+        }
+
+        Self& operator--() noexcept
+        {
+            // SEE: the notes in operator++; this is symmetric
+            if (depth_ == 0) [[unlikely]] {
+                push_rightmost(root_);
+                return *this;
+            }
+
+            const Node* node = this->node();
+
+            if (node->left != nullptr) {
+                push_rightmost(node->left);
+                return *this;
+            }
+
+            const Node* child{nullptr};
+            do {
+                child = path_[--depth_];
+            } while (depth_ > 0 && path_[depth_ - 1]->left == child);
+
+            return *this;
+        }
+
+        Self operator--(int) noexcept
+        {
+            Self tmp{*this};
+            --*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.node() == rhs.node();
+        }
+
+        friend bool operator!=(const Self& lhs, const Self& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+      private:
+        static constexpr size_t max_height{96};
+
+        const Node* root_{nullptr};
+        size_t      depth_{0};
+
+        std::array<const Node*, max_height> path_; // NOLINT
+
+        explicit ConstPathIterator(const Node* root) noexcept
+            : root_{root}
+        {
+        }
+
+        const Node* node() const noexcept
+        {
+            return depth_ == 0 ? nullptr : path_[depth_ - 1];
+        }
+
+        void push(const Node* node) noexcept { path_[depth_++] = node; }
+
+        void push_leftmost(const Node* node) noexcept
+        {
+            for (; node != nullptr; node = node->left) push(node);
+        }
+
+        void push_rightmost(const Node* node) noexcept
+        {
+            for (; node != nullptr; node = node->right) push(node);
+        }
+    };
+
+    /* a version read without being owned
+     *
+     * a view holds no references to the nodes of the version it was taken
+     * from; so taking one writes to no shared memory at all, but it is only
+     * valid for as long as that version is neither updated nor destroyed
+     * (SEE: concurrent_tree, whose readers keep versions alive by other
+     * means)
+     *
+     * the lookups of persistent_tree are those of its view */
+    class VersionView
+    {
+        friend class persistent_tree;
+
+      public:
+        [[nodiscard]] bool   empty() const noexcept { return size_ == 0; }
+        [[nodiscard]] size_t size() const noexcept { return size_; }
+
+        iterator find(const T& data) const noexcept(nothrow_compare<T>)
+        {
+            return find_of(data);
+        }
+
+        template <typename Key>
+            requires transparent
+        iterator find(const Key& key) const noexcept(nothrow_compare<Key>)
+        {
+            return find_of(key);
+        }
+
+        // the first element not less than data
+        iterator lower_bound(const T& data) const noexcept(nothrow_compare<T>)
+        {
+            return lower_bound_of(data);
+        }
+
+        template <typename Key>
+            requires transparent
+        iterator lower_bound(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            return lower_bound_of(key);
+        }
+
+        // the first element greater than data
+        iterator upper_bound(const T& data) const noexcept(nothrow_compare<T>)
+        {
+            return upper_bound_of(data);
+        }
+
+        template <typename Key>
+            requires transparent
+        iterator upper_bound(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            return upper_bound_of(key);
+        }
+
+        std::pair<iterator, iterator> equal_range(const T& data) const
+            noexcept(nothrow_compare<T>)
+        {
+            return {lower_bound(data), upper_bound(data)};
+        }
+
+        template <typename Key>
+            requires transparent
+        std::pair<iterator, iterator> equal_range(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            return {lower_bound(key), upper_bound(key)};
+        }
+
+        // NOTE: the equivalent elements are stepped over one at a time
+        size_type count(const T& data) const noexcept(nothrow_compare<T>)
+        {
+            auto [first, last] = equal_range(data);
+            return static_cast<size_type>(std::distance(first, last));
+        }
+
+        template <typename Key>
+            requires transparent
+        size_type count(const Key& key) const noexcept(nothrow_compare<Key>)
+        {
+            auto [first, last] = equal_range(key);
+            return static_cast<size_type>(std::distance(first, last));
+        }
+
+        const_iterator cbegin() const noexcept
+        {
+            const_iterator it{root_};
+            it.push_leftmost(root_);
+            return it;
+        }
+
+        const_iterator begin() const noexcept { return cbegin(); }
+
+        const_iterator cend() const noexcept { return const_iterator{root_}; }
+        const_iterator end() const noexcept { return cend(); }
+
+        const_reverse_iterator rbegin() const noexcept
+        {
+            return std::make_reverse_iterator(cend());
+        }
+
+        const_reverse_iterator rend() const noexcept
+        {
+            return std::make_reverse_iterator(cbegin());
+        }
+
+      private:
+        const Node*    root_;
+        size_t         size_;
+        const Compare* compare_;
+
+        VersionView(const Node*    root,
+                    size_t         size,
+                    const Compare& compare) noexcept
+            : root_{root}
+            , size_{size}
+            , compare_{std::addressof(compare)}
+        {
+        }
+
+        template <typename Key>
+        iterator find_of(const Key& key) const noexcept(nothrow_compare<Key>)
+        {
+            iterator it = lower_bound_of(key);
+            if (it != end() && (*compare_)(key, *it)) return end();
+            return it;
+        }
+
+        // the bound is on the search path; the path is cut back to it at the
+        // end
+        template <typename Key>
+        iterator lower_bound_of(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            const_iterator it{root_};
+            size_t         depth{0};
+
+            for (const Node* node = root_; node != nullptr;) {
+                it.push(node);
+
+                if ((*compare_)(node->data, key)) {
+                    node = node->right;
+                } else {
+                    depth = it.depth_;
+                    node  = node->left;
+                }
+            }
+
+            it.depth_ = depth;
+            return it;
+        }
+
+        template <typename Key>
+        iterator upper_bound_of(const Key& key) const
+            noexcept(nothrow_compare<Key>)
+        {
+            const_iterator it{root_};
+            size_t         depth{0};
+
+            for (const Node* node = root_; node != nullptr;) {
+                it.push(node);
+
+                if ((*compare_)(key, node->data)) {
+                    depth = it.depth_;
+                    node  = node->left;
+                } else {
+                    node = node->right;
+                }
+            }
+
+            it.depth_ = depth;
+            return it;
+        }
+    };
+
+  public:
+    persistent_tree()
+        : persistent_tree{Compare{}}
+    {
+    }
+
+    explicit persistent_tree(const Compare& compare)
+        : compare_{compare}
+    {
+    }
+
+    // O(1); the copy shares every node with that
+    persistent_tree(const persistent_tree& that) noexcept
+        : root_{retain(that.root_)}
+        , size_{that.size_}
+        , compare_{that.compare_}
+        , alloc_{that.alloc_}
+    {
+    }
+
+    persistent_tree(persistent_tree&& that) noexcept
+        : root_{std::exchange(that.root_, nullptr)}
+        , size_{std::exchange(that.size_, 0)}
+        , compare_{that.compare_}
+        , alloc_{that.alloc_}
+    {
+    }
+
+    ~persistent_tree() { release(root_); }
+
+    persistent_tree& operator=(const persistent_tree& that) noexcept
+    {
+        // NOTE: retained first; that may share the root with this
+        Node* root = retain(that.root_);
+        release(root_);
+
+        root_    = root;
+        size_    = that.size_;
+        compare_ = that.compare_;
+
+        return *this;
+    }
+
+    persistent_tree& operator=(persistent_tree&& that) noexcept
+    {
+        if (this != &that) {
+            release(root_);
+
+            root_    = std::exchange(that.root_, nullptr);
+            size_    = std::exchange(that.size_, 0);
+            compare_ = that.compare_;
+        }
+
+        return *this;
+    }
+
+    /* a point-in-time view of the tree, in O(1)
+     *
+     * the snapshot is just another version: later updates of this tree do not
+     * show in it (and vice versa), and it may be handed to other threads while
+     * this tree goes on being updated */
+    persistent_tree snapshot() const noexcept { return *this; }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type{alloc_};
+    }
+
+    value_compare value_comp() const { return compare_; }
+
+    [[nodiscard]] bool   empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+
+    [[nodiscard]] size_t height() const noexcept
+    {
+        return root_ != nullptr ? root_->height - size_t{1} : 0;
+    }
+
+    void clear() noexcept
+    {
+        release(root_);
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+    iterator insert(const T& data) { return emplace(data); }
+
+    iterator insert(T&& data) { return emplace(std::move(data)); }
+
+    // NOTE: as in bst, equivalent elements are kept in insertion order
+    template <typename... Args>
+    iterator emplace(Args&&... args)
+    {
+        Node* fresh = make_node(std::in_place, std::forward<Args>(args)...);
+
+        try {
+            insert_at(root_, fresh);
+        } catch (...) {
+            // NOTE: nothing throws once the node is linked
+            dispose(fresh);
+            throw;
+        }
+
+        ++size_;
+
+        return iterator_to(fresh);
+    }
+
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last)
+    {
+        for (; first != last; ++first) emplace(*first);
+    }
+
+    void insert(std::initializer_list<T> init)
+    {
+        insert(init.begin(), init.end());
+    }
+
+    // SEE: bst::assign_sorted
+    template <typename ForwardIterator>
+    void assign_sorted(ForwardIterator first, ForwardIterator last)
+    {
+        clear();
+
+        auto n = static_cast<size_t>(std::distance(first, last));
+
+        root_ = build_sorted(first, n);
+        size_ = n;
+    }
+
+    // SEE: bst::assign
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        std::vector<T, Allocator> values(first, last);
+        std::stable_sort(values.begin(), values.end(), compare_);
+        assign_sorted(values.begin(), values.end());
+    }
+
+    /* NOTE: unlike bst::erase this returns nothing; the update invalidates
+     * every iterator of this tree
+     *
+     * if T throws while the path is copied the tree is left as it was; the
+     * element is removed before any rotation, so a throw during rebalancing
+     * only leaves the tree less balanced */
+    void erase(const_iterator pos) { erase_at(root_, pos, 0); }
+
+    iterator modify(const_iterator pos, const T& data)
+    {
+        return replace(pos, data);
+    }
+
+    iterator modify(const_iterator pos, T&& data)
+    {
+        return replace(pos, std::move(data));
+    }
+
+    // a view of this version; SEE: version_view
+    version_view view() const noexcept
+    {
+        return version_view{root_, size_, compare_};
+    }
+
+    iterator find(const T& data) const { return view().find(data); }
+
+    template <typename Key>
+        requires transparent
+    iterator find(const Key& key) const
+    {
+        return view().find(key);
+    }
+
+    // the first element not less than data
+    iterator lower_bound(const T& data) const
+    {
+        return view().lower_bound(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator lower_bound(const Key& key) const
+    {
+        return view().lower_bound(key);
+    }
+
+    // the first element greater than data
+    iterator upper_bound(const T& data) const
+    {
+        return view().upper_bound(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    iterator upper_bound(const Key& key) const
+    {
+        return view().upper_bound(key);
+    }
+
+    std::pair<iterator, iterator> equal_range(const T& data) const
+    {
+        return view().equal_range(data);
+    }
+
+    template <typename Key>
+        requires transparent
+    std::pair<iterator, iterator> equal_range(const Key& key) const
+    {
+        return view().equal_range(key);
+    }
+
+    // NOTE: the equivalent elements are stepped over one at a time
+    size_type count(const T& data) const { return view().count(data); }
+
+    template <typename Key>
+        requires transparent
+    size_type count(const Key& key) const
+    {
+        return view().count(key);
+    }
+
+    const_iterator cbegin() const noexcept { return view().cbegin(); }
+    const_iterator begin() const noexcept { return cbegin(); }
+
+    const_iterator cend() const noexcept { return view().cend(); }
+    const_iterator end() const noexcept { return cend(); }
+
+    const_reverse_iterator crbegin() const noexcept
+    {
+        return std::make_reverse_iterator(cend());
+    }
+
+    const_reverse_iterator rbegin() const noexcept { return crbegin(); }
+
+    const_reverse_iterator crend() const noexcept
+    {
+        return std::make_reverse_iterator(cbegin());
+    }
+
+    const_reverse_iterator rend() const noexcept { return crend(); }
+
+  private:
+    Node*  root_{nullptr};
+    size_t size_{0};
+
+    [[no_unique_address]] Compare       compare_;
+    [[no_unique_address]] NodeAllocator alloc_;
+
+    template <typename... Args>
+    Node* make_node(Args&&... args)
+    {
+        Node* node = NodeTraits::allocate(alloc_, 1);
+        try {
+            NodeTraits::construct(alloc_, node, std::forward<Args>(args)...);
+        } catch (...) {
+            NodeTraits::deallocate(alloc_, node, 1);
+            throw;
+        }
+        return node;
+    }
+
+    // NOTE: the references node holds to its children are not dropped
+    void dispose(Node* node) noexcept
+    {
+        NodeTraits::destroy(alloc_, node);
+        NodeTraits::deallocate(alloc_, node, 1);
+    }
+
+    static Node* retain(Node* node) noexcept
+    {
+        if (node != nullptr) node->refs.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    /* drops a reference to node; the last one destroys it, dropping its
+     * references to its children in turn
+     *
+     * the recursion goes left only; so its depth is bounded by the height */
+    void release(Node* node) noexcept
+    {
+        while (node != nullptr
+               && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+
+            Node* right = node->right;
+            dispose(node);
+            node = right;
+        }
+    }
+
+    /* makes slot refer to a node that only this version refers to; a shared
+     * node is replaced by a copy of it
+     *
+     * the node a slot refers to is only ever owned after its parent is; a
+     * copied parent shares its children, which are copied in turn if they are
+     * reached; so a count of one is enough to tell that no other version can
+     * reach the node
+     *
+     * NOTE: slot is left alone if the copy throws */
+    void own(Node*& slot)
+    {
+        if (slot->refs.load(std::memory_order_acquire) == 1) return;
+
+        Node* copy = make_node(std::as_const(*slot));
+        retain(copy->left);
+        retain(copy->right);
+
+        release(slot);
+        slot = copy;
+    }
+
+    static size_t height_of(const Node* node) noexcept
+    {
+        return node != nullptr ? node->height : 0;
+    }
+
+    static void update_height(Node* node) noexcept
+    {
+        node->height = static_cast<std::uint8_t>(
+            1 + std::max(height_of(node->left), height_of(node->right)));
+    }
+
+    // SEE: balanced_bst::left_rotate; slot has to be owned already
+    void left_rotate(Node*& slot)
+    {
+        own(slot->right);
+
+        Node* node  = slot;
+        Node* child = node->right;
+
+        node->right = child->left;
+        child->left = node;
+
+        update_height(node);
+        update_height(child);
+
+        slot = child;
+    }
+
+    // SEE: balanced_bst::right_rotate; slot has to be owned already
+    void right_rotate(Node*& slot)
+    {
+        own(slot->left);
+
+        Node* node  = slot;
+        Node* child = node->left;
+
+        node->left   = child->right;
+        child->right = node;
+
+        update_height(node);
+        update_height(child);
+
+        slot = child;
+    }
+
+    /* brings the heights of the subtrees at the owned node at slot back within
+     * one of each other, after one of them has changed by one
+     *
+     * NOTE: after an insertion the rotated nodes are all on the path, so this
+     * does not throw then */
+    void rebalance(Node*& slot)
+    {
+        Node* node  = slot;
+        auto  left  = height_of(node->left);
+        auto  right = height_of(node->right);
+
+        if (left > right + 1) {
+            Node* child = node->left;
+            if (height_of(child->left) < height_of(child->right)) {
+                own(node->left);
+                left_rotate(node->left);
+            }
+            right_rotate(slot);
+        } else if (right > left + 1) {
+            Node* child = node->right;
+            if (height_of(child->right) < height_of(child->left)) {
+                own(node->right);
+                right_rotate(node->right);
+            }
+            left_rotate(slot);
+        } else {
+            update_height(node);
+        }
+    }
+
+    void insert_at(Node*& slot, Node* fresh)
+    {
+        if (slot == nullptr) {
+            slot = fresh;
+            return;
+        }
+
+        own(slot);
+
+        Node* node = slot;
+        insert_at(compare_(fresh->data, node->data) ? node->left : node->right,
+                  fresh);
+
+        rebalance(slot);
+    }
+
+    // SEE: erase
+    void erase_at(Node*& slot, const const_iterator& pos, size_t depth)
+    {
+        Node* node = slot;
+        bool  last = depth + 1 == pos.depth_;
+
+        // a node with a single child (or none) is replaced by that child; it
+        // is not worth a copy when it is shared
+        if (last && (node->left == nullptr || node->right == nullptr)) {
+            slot = retain(node->left != nullptr ? node->left : node->right);
+            release(node);
+            --size_;
+            return;
+        }
+
+        own(slot);
+        node = slot;
+
+        if (!last) {
+            // NOTE: a copy has the same children as the node on the path
+            erase_at(pos.path_[depth + 1] == node->left ? node->left
+                                                        : node->right,
+                     pos,
+                     depth + 1);
+        } else {
+            // the node keeps its place and takes over the data of its
+            // successor, whose node is removed instead
+            take_min(node->right, node->data);
+        }
+
+        rebalance(slot);
+    }
+
+    // moves the minimum of the subtree at slot into data and removes its node
+    void take_min(Node*& slot, T& data)
+    {
+        own(slot);
+
+        Node* node = slot;
+
+        if (node->left != nullptr) {
+            take_min(node->left, data);
+            rebalance(slot);
+            return;
+        }
+
+        data = std::move(node->data);
+
+        slot = node->right;
+        dispose(node);
+        --size_;
+    }
+
+    // SEE: modify
+    template <typename Data>
+    iterator replace(const_iterator pos, Data&& data)
+    {
+        const T& current = *pos;
+
+        if (compare_(current, data) || compare_(data, current)) {
+            // NOTE: data may refer to the element being erased
+            T value(std::forward<Data>(data));
+            erase(pos);
+            return emplace(std::move(value));
+        }
+
+        // the element keeps its place; only the nodes on its path are owned
+        const_iterator it{root_};
+
+        Node** slot = &root_;
+        for (size_t depth = 0; depth < pos.depth_; ++depth) {
+            own(*slot);
+
+            Node* node = *slot;
+            it.push(node);
+
+            if (depth + 1 < pos.depth_) {
+                slot = pos.path_[depth + 1] == node->left ? &node->left
+                                                          : &node->right;
+            }
+        }
+
+        (*slot)->data = std::forward<Data>(data);
+
+        it.root_ = root_;
+        return it;
+    }
+
+    template <typename ForwardIterator>
+    Node* build_sorted(ForwardIterator& it, size_t n)
+    {
+        if (n == 0) return nullptr;
+
+        // SEE: bst::build_sorted; the heights of the halves differ by one at
+        // most, which is all an AVL tree asks for
+        size_t left_n = (n - 1) / 2;
+
+        Node* left = build_sorted(it, left_n);
+        Node* node{nullptr};
+
+        try {
+            node = make_node(std::in_place, *it);
+        } catch (...) {
+            release(left);
+            throw;
+        }
+
+        node->left = left;
+        ++it;
+
+        try {
+            node->right = build_sorted(it, n - left_n - 1);
+        } catch (...) {
+            release(node);
+            throw;
+        }
+
+        update_height(node);
+
+        return node;
+    }
+
+    /* the iterator to a node of this version
+     *
+     * node is the last of its equivalent elements (SEE: emplace); the last
+     * element not greater than some key is always on the path a search for
+     * the upper bound of that key takes */
+    iterator iterator_to(const Node* node) const
+    {
+        const_iterator it{root_};
+
+        const Node* cursor = root_;
+        while (true) {
+            it.push(cursor);
+            if (cursor == node) break;
+            cursor = compare_(node->data, cursor->data) ? cursor->left
+                                                        : cursor->right;
+        }
+
+        return it;
+    }
+};
+
+#endif // PERSISTENT_TREE_H
@@ -2,24 +2,35 @@
 #define RB_TREE_H
 
 #include "balanced_bst.h"
+#include "work_stealing_pool.h"
 
+#include <algorithm>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <initializer_list>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template <typename T,
           typename Compare   = std::less<T>,
-          typename Allocator = std::allocator<T>>
-class rb_tree : public balanced_bst<T, Compare, Allocator>
+          typename Allocator = std::allocator<T>,
+          typename Augment   = void>
+class rb_tree : public balanced_bst<T, Compare, Allocator, Augment>
 {
   private:
     using AllocTraits = std::allocator_traits<Allocator>;
 
-    using bst          = bst<T, Compare, Allocator>;
-    using balanced_bst = balanced_bst<T, Compare, Allocator>;
+    using bst          = ::bst<T, Compare, Allocator, Augment>;
+    using balanced_bst = ::balanced_bst<T, Compare, Allocator, Augment>;
     using Sentinel     = typename bst::Sentinel;
 
     using BstNode         = typename bst::BstNode;
     using BalancedBstNode = typename balanced_bst::BalancedBstNode;
+    using DataFactory     = typename bst::DataFactory;
 
     using NodeColor = bool;
     static constexpr NodeColor red{false};  // NOLINT
@@ -27,23 +38,37 @@ class rb_tree : public balanced_bst<T, Compare, Allocator>
 
     struct RedBlackNode : public BalancedBstNode { // NOLINT
         RedBlackNode() = default;
-        RedBlackNode(const T&  data,
-                     Sentinel* owner) noexcept(noexcept(BalancedBstNode{data,
-                                                                        owner}))
-            : BalancedBstNode{data, owner}
+
+        explicit RedBlackNode(const DataFactory& data)
+            : BalancedBstNode{data}
         {
         }
 
-        RedBlackNode(const RedBlackNode& that,
-                     Sentinel* owner) noexcept(noexcept(BalancedBstNode{that,
-                                                                        owner}))
-            : BalancedBstNode{that, owner}
+        RedBlackNode(const RedBlackNode& that) noexcept(
+            noexcept(BalancedBstNode{that}))
+            : BalancedBstNode{that}
         {
+            set_color(that.color());
         }
 
-        NodeColor color{red};
+        // the color is kept in the tag bit of the parent link; red is the
+        // untagged state, so new nodes start out red
+        [[nodiscard]] NodeColor color() const noexcept
+        {
+            return this->parent.tag();
+        }
+
+        void set_color(NodeColor color) noexcept
+        {
+            this->parent.set_tag(color);
+        }
     };
 
+    static RedBlackNode* parent_of(BstNode* node) noexcept
+    {
+        return static_cast<RedBlackNode*>(node->parent.get());
+    }
+
     template <typename NodeAllocator>
     using BstAllocator = typename bst::template BstAllocator<NodeAllocator>;
 
@@ -53,93 +78,947 @@ class rb_tree : public balanced_bst<T, Compare, Allocator>
 
   public:
     rb_tree()
-        : balanced_bst{new RedBlackNodeAllocator{}}
+        : rb_tree{Compare{}}
+    {
+    }
+
+    explicit rb_tree(const Compare& compare)
+        : balanced_bst{new RedBlackNodeAllocator{compare}}
     {
     }
 
     rb_tree(const rb_tree& that)
-        : rb_tree{}
+        requires std::is_copy_constructible_v<T>
+        : rb_tree{that.value_comp()}
     {
         this->sentinel_->copy(that.sentinel_);
     }
 
-    rb_tree(rb_tree&& that) noexcept;
+    rb_tree(rb_tree&& that) noexcept
+        : balanced_bst{std::move(that)}
+    {
+    }
+
     virtual ~rb_tree() = default;
 
+    rb_tree& operator=(const rb_tree&)     = default;
+    rb_tree& operator=(rb_tree&&) noexcept = default;
+
+    // SEE: bst::swap
+    void swap(rb_tree& that) noexcept { bst::swap(that); }
+
+    friend void swap(rb_tree& lhs, rb_tree& rhs) noexcept { lhs.swap(rhs); }
+
+    /* moves the elements that are not less than key into a new tree; this
+     * tree keeps the ones that are less
+     *
+     * the nodes are not copied; the tree is cut along the path to key and the
+     * pieces are joined back together (SEE: join), which takes O(log n) in
+     * total. unless the tree keeps order_statistics the sizes of the parts
+     * are counted as well, which adds O(min(k, n - k)) for k elements less
+     * than key (SEE: count_less) */
+    rb_tree split(const T& key) { return split_at(key); }
+
+    template <typename Key>
+        requires bst::transparent
+    rb_tree split(const Key& key)
+    {
+        return split_at(key);
+    }
+
+    /* the tree holding the elements of left, then pivot and then the elements
+     * of right; no element of left may be greater than pivot, and no element
+     * of right less than it
+     *
+     * the nodes of both trees are reused; left and right are left empty, and
+     * may be used on. the shorter tree is hung into the taller one at the
+     * matching black height, so this takes O(log n) */
+    static rb_tree join(rb_tree&& left, T pivot, rb_tree&& right)
+    {
+        // whatever may throw is done before a node moves; SEE: join_with
+        left.own_sentinel();
+        right.own_sentinel();
+        rb_tree joined{left.value_comp()};
+        left.sentinel_->adopt_storage(*right.sentinel_);
+        BstNode* node = left.sentinel_->emplace_node(std::move(pivot));
+
+        std::swap(joined.sentinel_, left.sentinel_);
+        joined.join_with(node, right);
+        return joined;
+    }
+
+    // as join, but without a pivot; the maximum of left is used instead
+    static rb_tree concat(rb_tree&& left, rb_tree&& right)
+    {
+        if (right.empty()) return take(left);
+        if (left.empty()) return take(right);
+
+        rb_tree joined{left.value_comp()};
+        left.sentinel_->adopt_storage(*right.sentinel_);
+
+        std::swap(joined.sentinel_, left.sentinel_);
+        Sentinel* sentinel = joined.sentinel_;
+
+        auto* pivot = static_cast<BstNode*>(sentinel->max);
+        joined.unlink(pivot);
+        --sentinel->size;
+
+        joined.join_with(pivot, right);
+        return joined;
+    }
+
+    /* the set operations combine the elements of two trees ordered alike;
+     * like the std:: algorithms of the same name they treat the trees as
+     * multisets (e.g., the union holds an element as often as the tree
+     * holding it more often does)
+     *
+     * the nodes of both trees are reused (lhs and rhs are left empty, and
+     * may be used on); the ones left out are destroyed. one tree is split
+     * around the root of the other and the halves are combined recursively
+     * and then joined (SEE: join); so the work is O(m log(n / m + 1)) for
+     * trees of m <= n elements
+     *
+     * given a pool, halves with an (estimated) total of at least grain
+     * elements are combined in parallel
+     *
+     * if the comparator throws (or memory runs out) the elements of both
+     * trees are destroyed, and lhs and rhs are left empty */
+    using bst::default_grain;
+
+    static rb_tree set_union(rb_tree&& lhs, rb_tree&& rhs)
+    {
+        return combine<SetOperation::unite>(
+            std::move(lhs), std::move(rhs), nullptr, 0);
+    }
+
+    static rb_tree set_union(rb_tree&&           lhs,
+                             rb_tree&&           rhs,
+                             work_stealing_pool& pool,
+                             size_t              grain = default_grain)
+    {
+        return combine<SetOperation::unite>(
+            std::move(lhs), std::move(rhs), &pool, grain);
+    }
+
+    static rb_tree set_intersection(rb_tree&& lhs, rb_tree&& rhs)
+    {
+        return combine<SetOperation::intersect>(
+            std::move(lhs), std::move(rhs), nullptr, 0);
+    }
+
+    static rb_tree set_intersection(rb_tree&&           lhs,
+                                    rb_tree&&           rhs,
+                                    work_stealing_pool& pool,
+                                    size_t              grain = default_grain)
+    {
+        return combine<SetOperation::intersect>(
+            std::move(lhs), std::move(rhs), &pool, grain);
+    }
+
+    // the elements of lhs that are not in rhs
+    static rb_tree set_difference(rb_tree&& lhs, rb_tree&& rhs)
+    {
+        return combine<SetOperation::subtract>(
+            std::move(lhs), std::move(rhs), nullptr, 0);
+    }
+
+    static rb_tree set_difference(rb_tree&&           lhs,
+                                  rb_tree&&           rhs,
+                                  work_stealing_pool& pool,
+                                  size_t              grain = default_grain)
+    {
+        return combine<SetOperation::subtract>(
+            std::move(lhs), std::move(rhs), &pool, grain);
+    }
+
+    /* true if the tree is a valid red-black tree: every child links back to
+     * its parent, the root is black, no red node has a red child, every path
+     * from the root down to a leaf passes as many black nodes, what Augment
+     * keeps is up to date at every node, and the elements are in order; and
+     * the minimum, maximum and size are the ones of the nodes
+     *
+     * NOTE: this walks the whole tree; it is meant for tests */
+    [[nodiscard]] bool verify() const
+    {
+        const Sentinel* sentinel = this->sentinel_;
+        const BstNode*  root     = sentinel->root;
+
+        if (root == nullptr) {
+            return sentinel->min == sentinel && sentinel->max == sentinel
+                   && this->size() == 0;
+        }
+
+        if (root->parent != nullptr
+            || static_cast<const RedBlackNode*>(root)->color() != black) {
+            return false;
+        }
+
+        size_t count = 0;
+        if (!verify_subtree(root, count).has_value()) return false;
+
+        // const_cast is OK; Node(s) are never actually declared const
+        auto* top = const_cast<BstNode*>(root);
+
+        return count == this->size() && sentinel->min == top->min()
+               && sentinel->max == top->max()
+               && std::is_sorted(this->begin(), this->end(), sentinel->compare);
+    }
+
+  protected:
+    Sentinel* make_sentinel(const Compare& compare) const override
+    {
+        return new RedBlackNodeAllocator{compare};
+    }
+
   private:
-    void base_insert(BstNode* node) override
+    // a detached red-black subtree with a black root; or an empty one
+    struct Subtree {
+        BstNode* root{nullptr};
+        size_t   black_height{0};
+    };
+
+    enum class SetOperation { unite, intersect, subtract };
+
+    // subtrees left out of a set operation; chained through their parent
+    // links so that they can be collected from parallel tasks for free
+    struct Discarded {
+        BstNode* head{nullptr};
+        BstNode* tail{nullptr};
+
+        void push(BstNode* root) noexcept
+        {
+            root->parent = nullptr;
+            if (tail == nullptr) {
+                head = root;
+            } else {
+                tail->parent = root;
+            }
+            tail = root;
+        }
+
+        void append(const Discarded& that) noexcept
+        {
+            if (that.head == nullptr) return;
+            if (tail == nullptr) {
+                head = that.head;
+            } else {
+                tail->parent = that.head;
+            }
+            tail = that.tail;
+        }
+    };
+
+    struct SetResult {
+        Subtree   tree;
+        Discarded discarded;
+    };
+
+    struct SetContext {
+        const Compare&      compare;
+        work_stealing_pool* pool;
+        size_t              grain;
+    };
+
+    template <SetOperation Operation>
+    static rb_tree combine(rb_tree&&           lhs,
+                           rb_tree&&           rhs,
+                           work_stealing_pool* pool,
+                           size_t              grain)
+    {
+        lhs.own_sentinel();
+        rhs.own_sentinel();
+
+        rb_tree   result   = take(lhs);
+        Sentinel* sentinel = result.sentinel_;
+        Sentinel* other    = rhs.sentinel_;
+
+        sentinel->adopt_storage(*other);
+
+        Subtree first{sentinel->root, black_height(sentinel->root)};
+        Subtree second{other->root, black_height(other->root)};
+
+        size_t size = sentinel->size + other->size;
+
+        // the nodes of rhs belong to the result now; and neither tree holds
+        // on to its nodes while they are cut
+        set_root(other, nullptr, 0);
+        set_root(sentinel, nullptr, 0);
+
+        // every node left out is destroyed (and counted out of size)
+        auto dispose = [sentinel, &size](const Discarded& discarded) noexcept {
+            for (BstNode* root = discarded.head; root != nullptr;) {
+                BstNode* next = root->parent;
+                root->parent  = nullptr;
+
+                Sentinel::teardown(root, [sentinel, &size](BstNode* node) {
+                    sentinel->destroy_node(node);
+                    --size;
+                });
+
+                root = next;
+            }
+        };
+
+        Discarded lost;
+        SetResult combined;
+        try {
+            combined = set_operation<Operation>(
+                first,
+                second,
+                SetContext{sentinel->compare, pool, grain},
+                lost);
+        } catch (...) {
+            dispose(lost);
+            throw;
+        }
+
+        dispose(combined.discarded);
+        set_root(sentinel, combined.tree.root, size);
+        return result;
+    }
+
+    // a lower bound on the number of elements of a subtree
+    static size_t estimated_size(Subtree tree) noexcept
+    {
+        if (tree.root == nullptr) return 0;
+        if constexpr (bst::augmented) {
+            return bst::subtree_size(tree.root);
+        } else {
+            return size_t{1} << std::min<size_t>(tree.black_height, 48);
+        }
+    }
+
+    /* NOTE: if anything throws every node of lhs and rhs is pushed onto
+     * lost (the ones the frames below had taken included); so the caller
+     * can destroy them */
+    template <SetOperation Operation>
+    static SetResult set_operation(Subtree           lhs,
+                                   Subtree           rhs,
+                                   const SetContext& context,
+                                   Discarded&        lost)
+    {
+        SetResult result;
+
+        if (lhs.root == nullptr || rhs.root == nullptr) {
+            Subtree kept = Operation == SetOperation::unite
+                               ? (lhs.root != nullptr ? lhs : rhs)
+                           : Operation == SetOperation::subtract ? lhs
+                                                                 : Subtree{};
+
+            if (lhs.root != nullptr && lhs.root != kept.root) {
+                result.discarded.push(lhs.root);
+            }
+            if (rhs.root != nullptr && rhs.root != kept.root) {
+                result.discarded.push(rhs.root);
+            }
+
+            result.tree = kept;
+            return result;
+        }
+
+        // both trees are cut into the elements less than, equivalent to and
+        // greater than the root of rhs
+        const Compare& compare = context.compare;
+        const T&       key     = rhs.root->data;
+
+        auto less        = [&](const T& data) { return compare(data, key); };
+        auto not_greater = [&](const T& data) { return !compare(key, data); };
+
+        size_t estimate = estimated_size(lhs) + estimated_size(rhs);
+
+        // every piece is held by exactly one of these at any time (or has
+        // been handed on to a frame below); so whatever is still held when
+        // something throws is what has to be pushed onto lost
+        Subtree lhs_less;
+        Subtree lhs_equal;
+        Subtree lhs_more;
+        Subtree rhs_less;
+        Subtree rhs_equal;
+        Subtree rhs_more;
+
+        SetResult below;
+        SetResult above;
+        Discarded below_lost;
+        Discarded above_lost;
+
+        std::vector<BstNode*> first;
+        std::vector<BstNode*> second;
+        std::vector<BstNode*> kept;
+
+        try {
+            // a piece is only cleared once it has been cut (SEE: split_by)
+            std::tie(lhs_less, lhs_more) = split_by(lhs, less);
+            lhs                          = {};
+            std::tie(lhs_equal, lhs_more) = split_by(lhs_more, not_greater);
+            std::tie(rhs_less, rhs_more)  = split_by(rhs, less);
+            rhs                           = {};
+            std::tie(rhs_equal, rhs_more) = split_by(rhs_more, not_greater);
+
+            auto combine_below = [&] {
+                Subtree left  = std::exchange(lhs_less, Subtree{});
+                Subtree right = std::exchange(rhs_less, Subtree{});
+                below =
+                    set_operation<Operation>(left, right, context, below_lost);
+            };
+            auto combine_above = [&] {
+                Subtree left  = std::exchange(lhs_more, Subtree{});
+                Subtree right = std::exchange(rhs_more, Subtree{});
+                above =
+                    set_operation<Operation>(left, right, context, above_lost);
+            };
+
+            if (context.pool != nullptr && estimate >= context.grain) {
+                context.pool->fork_join(combine_below, combine_above);
+            } else {
+                combine_below();
+                combine_above();
+            }
+
+            first     = flatten(lhs_equal.root);
+            lhs_equal = {};
+            second    = flatten(rhs_equal.root);
+            rhs_equal = {};
+
+            // so that nothing below allocates
+            kept.reserve(first.size() + second.size());
+        } catch (...) {
+            for (Subtree piece : {lhs,
+                                  rhs,
+                                  lhs_less,
+                                  lhs_equal,
+                                  lhs_more,
+                                  rhs_less,
+                                  rhs_equal,
+                                  rhs_more,
+                                  below.tree,
+                                  above.tree}) {
+                if (piece.root != nullptr) lost.push(piece.root);
+            }
+            for (BstNode* node : first) lost.push(node);
+            for (BstNode* node : second) lost.push(node);
+
+            lost.append(below.discarded);
+            lost.append(above.discarded);
+            lost.append(below_lost);
+            lost.append(above_lost);
+            throw;
+        }
+
+        // the equivalent elements are kept (and left out) as std::set_union,
+        // std::set_intersection and std::set_difference would
+        size_t m = first.size();
+        size_t n = second.size();
+
+        auto keep = [&kept](auto from, auto to) {
+            kept.insert(kept.end(), from, to);
+        };
+        auto discard = [&result](auto from, auto to) {
+            for (; from != to; ++from) result.discarded.push(*from);
+        };
+
+        if constexpr (Operation == SetOperation::unite) {
+            keep(first.begin(), first.end());
+            if (n > m) {
+                discard(second.begin(), second.begin() + m);
+                keep(second.begin() + m, second.end());
+            } else {
+                discard(second.begin(), second.end());
+            }
+        } else if constexpr (Operation == SetOperation::intersect) {
+            size_t common = std::min(m, n);
+            keep(first.begin(), first.begin() + common);
+            discard(first.begin() + common, first.end());
+            discard(second.begin(), second.end());
+        } else {
+            size_t common = std::min(m, n);
+            discard(first.begin(), first.begin() + common);
+            keep(first.begin() + common, first.end());
+            discard(second.begin(), second.end());
+        }
+
+        Subtree tree = above.tree;
+        if (kept.empty()) {
+            tree = join_subtrees(below.tree, tree);
+        } else {
+            for (size_t i = kept.size(); i-- > 1;) {
+                tree = join_subtrees(Subtree{}, kept[i], tree);
+            }
+            tree = join_subtrees(below.tree, kept.front(), tree);
+        }
+
+        result.tree = tree;
+        result.discarded.append(below.discarded);
+        result.discarded.append(above.discarded);
+        return result;
+    }
+
+    // the nodes of a detached subtree in order, each detached on its own
+    static std::vector<BstNode*> flatten(BstNode* root)
+    {
+        std::vector<BstNode*> nodes;
+        if (root == nullptr) return nodes;
+
+        bst::inorder_visit(root, [&nodes](BstNode* node) {
+            nodes.push_back(node);
+        });
+
+        for (BstNode* node : nodes) node->reset();
+        return nodes;
+    }
+
+    // joins two detached subtrees without a pivot; the maximum of lhs is used
+    static Subtree join_subtrees(Subtree lhs, Subtree rhs)
+    {
+        if (lhs.root == nullptr) return rhs;
+        if (rhs.root == nullptr) return lhs;
+
+        auto [rest, last] = split_last(lhs);
+        return join_subtrees(rest, last, rhs);
+    }
+
+    // cuts the maximum off a detached subtree
+    static std::pair<Subtree, BstNode*> split_last(Subtree tree)
+    {
+        auto*  node   = static_cast<RedBlackNode*>(tree.root);
+        size_t height = tree.black_height - (node->color() == black ? 1 : 0);
+
+        Subtree lhs = detach(node->left, height);
+        Subtree rhs = detach(node->right, height);
+
+        if (rhs.root == nullptr) return {lhs, node};
+
+        auto [rest, last] = split_last(rhs);
+        return {join_subtrees(lhs, node, rest), last};
+    }
+
+    /* the black height of the subtree at node (SEE: verify); or nothing if
+     * the subtree is not valid. count is increased by the number of its
+     * nodes */
+    static std::optional<size_t> verify_subtree(const BstNode* node,
+                                                size_t&        count)
+    {
+        if (node == nullptr) return 0;
+        ++count;
+
+        NodeColor color = static_cast<const RedBlackNode*>(node)->color();
+
+        for (const BstNode* child : {node->left, node->right}) {
+            if (child == nullptr) continue;
+            if (child->parent.get() != node) return std::nullopt;
+            if (color == red
+                && static_cast<const RedBlackNode*>(child)->color() == red) {
+                return std::nullopt;
+            }
+        }
+
+        if constexpr (bst::augmented) {
+            if (node->subtree_size
+                != 1 + bst::subtree_size(node->left)
+                       + bst::subtree_size(node->right)) {
+                return std::nullopt;
+            }
+        }
+
+        if constexpr (bst::aggregated) {
+            if (!(node->aggregate == bst::combined_aggregate(node))) {
+                return std::nullopt;
+            }
+        }
+
+        auto left  = verify_subtree(node->left, count);
+        auto right = verify_subtree(node->right, count);
+
+        if (!left.has_value() || !right.has_value() || *left != *right) {
+            return std::nullopt;
+        }
+
+        return *left + (color == black ? 1 : 0);
+    }
+
+    // the number of black nodes on every path from node down to a leaf
+    static size_t black_height(BstNode* node) noexcept
+    {
+        size_t height = 0;
+        for (; node != nullptr; node = node->left) {
+            if (static_cast<RedBlackNode*>(node)->color() == black) ++height;
+        }
+        return height;
+    }
+
+    // cuts node off from its parent; a red root is made black
+    static Subtree detach(BstNode* node, size_t height) noexcept
+    {
+        if (node == nullptr) return {nullptr, 0};
+
+        node->parent = nullptr;
+
+        auto* root = static_cast<RedBlackNode*>(node);
+        if (root->color() == red) {
+            root->set_color(black);
+            ++height;
+        }
+
+        return {node, height};
+    }
+
+    static void set_root(Sentinel* sentinel, BstNode* root, size_t size)
+    {
+        sentinel->reset();
+        sentinel->size = size;
+
+        if (root == nullptr) return;
+
+        root->parent   = nullptr;
+        sentinel->root = root;
+        sentinel->min  = root->min();
+        sentinel->max  = root->max();
+    }
+
+    /* moves the nodes of right (and pivot) into this tree; SEE: join
+     *
+     * NOTE: this tree has to share the storage of right already; so nothing
+     * here allocates, and join and concat leave both trees as they were if
+     * they throw */
+    void join_with(BstNode* pivot, rb_tree& right)
+    {
+        Sentinel* sentinel = this->sentinel_;
+        Sentinel* other    = right.sentinel_;
+
+        Subtree lhs{sentinel->root, black_height(sentinel->root)};
+        Subtree rhs{other->root, black_height(other->root)};
+
+        size_t size = sentinel->size + 1 + other->size;
+
+        // the nodes of right belong to this tree now
+        set_root(other, nullptr, 0);
+
+        Subtree joined = join_subtrees(lhs, pivot, rhs);
+        set_root(sentinel, joined.root, size);
+    }
+
+    // the nodes of tree, in a tree of their own; tree is left empty
+    static rb_tree take(rb_tree& tree)
+    {
+        rb_tree taken{tree.value_comp()};
+        std::swap(taken.sentinel_, tree.sentinel_);
+        return taken;
+    }
+
+    // SEE: split
+    template <typename Key>
+    rb_tree split_at(const Key& key)
+    {
+        Sentinel* sentinel = this->sentinel_;
+
+        rb_tree right{this->value_comp()};
+        if (sentinel->root == nullptr) return right;
+
+        right.sentinel_->adopt_storage(*sentinel);
+
+        // every comparison is made while the tree is still whole; so a
+        // comparator that throws leaves it as it was
+        const BstNode* bound = sentinel->lower_bound(key);
+
+        // the parts are counted while the tree is still whole
+        size_t less_size{0};
+        if constexpr (!bst::augmented) less_size = count_less(bound);
+
+        // the tree is cut along the path from the root to bound, and then
+        // down the left subtree of bound (which is all less than key); at
+        // each node of the path the cut goes to the right iff bound is right
+        // of it
+        std::vector<bool> path;
+        if (bound != nullptr) {
+            path.push_back(false);
+            for (const BstNode* node = bound; node->parent != nullptr;
+                 node                = node->parent) {
+                path.push_back(node == node->parent->right);
+            }
+            std::reverse(path.begin(), path.end());
+        }
+
+        Subtree whole{sentinel->root, black_height(sentinel->root)};
+        auto [less, not_less] = split_along(whole, path);
+
+        if constexpr (bst::augmented) {
+            set_root(sentinel, less.root, bst::subtree_size(less.root));
+            set_root(right.sentinel_,
+                     not_less.root,
+                     bst::subtree_size(not_less.root));
+        } else {
+            size_t size = sentinel->size;
+            set_root(sentinel, less.root, less_size);
+            set_root(right.sentinel_, not_less.root, size - less_size);
+        }
+
+        return right;
+    }
+
+    /* the number of elements before bound (all of them for null); they are
+     * counted from the minimum up and the others from the maximum down at
+     * the same time, so it takes O(log n + min(k, n - k)) for k of them */
+    size_t count_less(const BstNode* bound) const noexcept
+    {
+        const Sentinel* sentinel = this->sentinel_;
+
+        if (bound == nullptr) return sentinel->size;
+
+        // the last element before bound; the walk down ends there
+        const BstNode* last = bound->predecessor();
+
+        auto* up   = static_cast<const BstNode*>(sentinel->min);
+        auto* down = static_cast<const BstNode*>(sentinel->max);
+
+        for (size_t less = 0, rest = 0;; ++less, ++rest) {
+            if (up == bound) return less;
+            if (down == last) return sentinel->size - rest;
+
+            up   = up->successor();
+            down = down->predecessor();
+        }
+    }
+
+    /* joins two detached subtrees with pivot in between; the elements of lhs
+     * precede pivot and those of rhs follow it
+     *
+     * pivot is added (red) in place of the black node on the inner spine of
+     * the taller subtree that has the black height of the shorter one; so
+     * every path keeps its black height and only the usual insert fixup is
+     * needed
+     *
+     * NOTE: only the nodes of lhs, rhs and pivot are touched; so disjoint
+     * subtrees can be joined in parallel */
+    static Subtree join_subtrees(Subtree lhs, BstNode* pivot, Subtree rhs)
     {
-        bst::base_insert(node);
+        auto* node = static_cast<RedBlackNode*>(pivot);
+        node->reset();
+        node->set_color(red);
+
+        auto col = [](BstNode* node) -> NodeColor {
+            return static_cast<RedBlackNode*>(node)->color();
+        };
+
+        BstNode* root{nullptr};
+        BstNode* parent{nullptr};
+
+        if (lhs.black_height >= rhs.black_height) {
+            BstNode* cursor = lhs.root;
+            size_t   height = lhs.black_height;
+
+            while (cursor != nullptr
+                   && (height > rhs.black_height || col(cursor) == red)) {
+                if (col(cursor) == black) --height;
+                parent = cursor;
+                cursor = cursor->right;
+            }
+
+            node->left  = cursor;
+            node->right = rhs.root;
+
+            if (parent != nullptr) {
+                parent->right = node;
+                root          = lhs.root;
+            } else {
+                root = node;
+            }
+        } else {
+            BstNode* cursor = rhs.root;
+            size_t   height = rhs.black_height;
+
+            while (cursor != nullptr
+                   && (height > lhs.black_height || col(cursor) == red)) {
+                if (col(cursor) == black) --height;
+                parent = cursor;
+                cursor = cursor->left;
+            }
+
+            node->left  = lhs.root;
+            node->right = cursor;
+
+            if (parent != nullptr) {
+                parent->left = node;
+                root         = rhs.root;
+            } else {
+                root = node;
+            }
+        }
+
+        node->parent = parent;
+        if (node->left != nullptr) node->left->parent = node;
+        if (node->right != nullptr) node->right->parent = node;
+
+        bst::update_augment_path(node);
+        insert_fixup(node, root);
+
+        auto*  top    = static_cast<RedBlackNode*>(root);
+        size_t height = std::max(lhs.black_height, rhs.black_height);
+
+        if (top->color() == red) {
+            top->set_color(black);
+            ++height;
+        }
+
+        return {top, height};
+    }
+
+    /* splits a detached subtree into the elements for which goes_left holds
+     * and the rest; goes_left has to hold for a prefix of the elements (e.g.,
+     * "less than key")
+     *
+     * goes_left is called once per level, from the root down, and only for
+     * the nodes the cut passes
+     *
+     * NOTE: the subtree is cut before goes_left is called; if it throws the
+     * nodes are left in pieces */
+    template <typename GoesLeft>
+    static std::pair<Subtree, Subtree> split_subtree(Subtree    tree,
+                                                     GoesLeft&& goes_left)
+    {
+        if (tree.root == nullptr) return {tree, tree};
+
+        auto*  node   = static_cast<RedBlackNode*>(tree.root);
+        size_t height = tree.black_height - (node->color() == black ? 1 : 0);
+
+        Subtree lhs = detach(node->left, height);
+        Subtree rhs = detach(node->right, height);
+
+        if (goes_left(std::as_const(node->data))) {
+            auto [left, right] = split_subtree(rhs, goes_left);
+            return {join_subtrees(lhs, node, left), right};
+        }
+
+        auto [left, right] = split_subtree(lhs, goes_left);
+        return {left, join_subtrees(right, node, rhs)};
+    }
+
+    /* as split_subtree, but goes_left is called for every node on the way
+     * down before anything is cut; so if it throws (or memory runs out) the
+     * subtree is left whole */
+    template <typename GoesLeft>
+    static std::pair<Subtree, Subtree> split_by(Subtree    tree,
+                                                GoesLeft&& goes_left)
+    {
+        std::vector<bool> path;
+        for (const BstNode* node = tree.root; node != nullptr;) {
+            bool left = goes_left(std::as_const(node->data));
+            path.push_back(left);
+            node = left ? node->right : node->left;
+        }
+
+        return split_along(tree, path);
+    }
+
+    // splits at every level from the root down as path says; past its end
+    // everything goes left
+    static std::pair<Subtree, Subtree>
+    split_along(Subtree tree, const std::vector<bool>& path)
+    {
+        return split_subtree(
+            tree, [&path, depth = size_t{0}](const T&) mutable noexcept {
+                return depth < path.size() ? path[depth++] : true;
+            });
+    }
+
+    void base_insert(BstNode* node, typename bst::Slot slot) override
+    {
+        // nodes are re-inserted by modify so they may still carry a color
+        static_cast<RedBlackNode*>(node)->set_color(red);
+
+        bst::base_insert(node, slot);
         post_insert(static_cast<BalancedBstNode*>(node));
     }
 
+    void post_build(BstNode* node, size_t depth, size_t height) override
+    {
+        // every path from the root passes through all levels above the
+        // deepest one; so only the deepest (possibly partial) level may be red
+        static_cast<RedBlackNode*>(node)->set_color(
+            depth == height && depth != 0 ? red : black);
+    }
+
     void post_insert(BalancedBstNode* node) override
+    {
+        insert_fixup(node, this->sentinel_->root);
+        static_cast<RedBlackNode*>(this->sentinel_->root)->set_color(black);
+    }
+
+    // restores the red-black properties below root after node was made red;
+    // root itself may be left red
+    static void insert_fixup(BstNode* node, BstNode*& root)
     {
         auto col = [](RedBlackNode* node) -> NodeColor {
-            return node != nullptr ? node->color : black;
+            return node != nullptr ? node->color() : black;
         };
 
-        while (col(static_cast<RedBlackNode*>(node->parent)) == red) {
-            auto* parent      = static_cast<RedBlackNode*>(node->parent);
-            auto* grandparent = static_cast<RedBlackNode*>(parent->parent);
+        while (col(parent_of(node)) == red) {
+            auto* parent      = parent_of(node);
+            auto* grandparent = parent_of(parent);
 
             if (parent == grandparent->left) {
                 auto* uncle = static_cast<RedBlackNode*>(grandparent->right);
 
                 if (col(uncle) == red) {
-                    parent->color      = black;
-                    uncle->color       = black;
-                    grandparent->color = red;
-                    node               = grandparent;
+                    parent->set_color(black);
+                    uncle->set_color(black);
+                    grandparent->set_color(red);
+                    node = grandparent;
                 } else {
                     if (node == parent->right) {
+                        // after the rotation the old parent is the lower of
+                        // the two red nodes; continue from there
                         node = parent;
-                        node->left_rotate();
+                        balanced_bst::left_rotate(node, root);
+                        parent = parent_of(node);
                     }
 
-                    parent->color      = black;
-                    grandparent->color = red;
+                    parent->set_color(black);
+                    grandparent->set_color(red);
 
-                    grandparent->right_rotate();
+                    balanced_bst::right_rotate(grandparent, root);
                 }
             } else {
                 auto* uncle = static_cast<RedBlackNode*>(grandparent->left);
 
                 if (col(uncle) == red) {
-                    parent->color      = black;
-                    uncle->color       = black;
-                    grandparent->color = red;
-                    node               = grandparent;
+                    parent->set_color(black);
+                    uncle->set_color(black);
+                    grandparent->set_color(red);
+                    node = grandparent;
                 } else {
                     if (node == parent->left) {
                         node = parent;
-                        node->right_rotate();
+                        balanced_bst::right_rotate(node, root);
+                        parent = parent_of(node);
                     }
 
-                    parent->color      = black;
-                    grandparent->color = red;
+                    parent->set_color(black);
+                    grandparent->set_color(red);
 
-                    grandparent->left_rotate();
+                    balanced_bst::left_rotate(grandparent, root);
                 }
             }
         }
-
-        static_cast<RedBlackNode*>(this->sentinel_->root)->color = black;
     }
 
     void single_child_or_leaf_node_erase(BstNode* node, BstNode* rep) override
     {
+        // rep may be null, so its parent has to be tracked separately
+        auto* parent = static_cast<BalancedBstNode*>(node->parent.get());
+
         bst::single_child_or_leaf_node_erase(node, rep);
-        if (static_cast<RedBlackNode*>(node)->color == black) {
-            post_erase(static_cast<RedBlackNode*>(rep));
+
+        if (static_cast<RedBlackNode*>(node)->color() == black) {
+            post_erase(static_cast<BalancedBstNode*>(rep), parent);
         }
     }
 
     void double_child_node_erase(BstNode* node, BstNode* rep) override
     {
-        auto* fixme = static_cast<BalancedBstNode*>(rep->right);
-
-        if (rep->parent == node && fixme != nullptr) fixme->parent = rep;
+        // rep is the minimum of the right subtree; so it has no left child and
+        // its right child (if any) moves up to take its place
+        auto* fixme  = static_cast<BalancedBstNode*>(rep->right);
+        auto* parent = static_cast<BalancedBstNode*>(
+            rep->parent == node ? rep : rep->parent.get());
 
         bst::double_child_node_erase(node, rep);
 
@@ -147,33 +1026,34 @@ class rb_tree : public balanced_bst<T, Compare, Allocator>
         auto* rep_rb  = static_cast<RedBlackNode*>(rep);
 
         // have already assumed that rep is not null
-        NodeColor color = rep_rb->color;
-        rep_rb->color   = node_rb->color;
+        NodeColor color = rep_rb->color();
+        rep_rb->set_color(node_rb->color());
 
-        if (color == black && fixme != nullptr) post_erase(fixme);
+        if (color == black) post_erase(fixme, parent);
     }
 
     // just the way it is
     // NOLINTNEXTLINE(readability-function-cognitive-complexity)
-    void post_erase(BalancedBstNode* fixme) override
+    void post_erase(BalancedBstNode* fixme, BalancedBstNode* up) override
     {
         auto col = [](RedBlackNode* node) -> NodeColor {
-            return node != nullptr ? node->color : black;
+            return node != nullptr ? node->color() : black;
         };
 
-        auto* node = static_cast<RedBlackNode*>(fixme);
-
-        while (node->color == black && node != this->sentinel_->root) {
+        // NOTE: node may be null (i.e., the removed node had no children), so
+        // its parent is carried alongside it
+        auto* node   = static_cast<RedBlackNode*>(fixme);
+        auto* parent = static_cast<RedBlackNode*>(up);
 
-            auto* parent = static_cast<RedBlackNode*>(node->parent);
+        while (node != this->sentinel_->root && col(node) == black) {
 
             if (node == parent->left) {
                 auto* uncle = static_cast<RedBlackNode*>(parent->right);
 
                 if (col(uncle) == red) {
-                    uncle->color  = black;
-                    parent->color = red;
-                    parent->left_rotate();
+                    uncle->set_color(black);
+                    parent->set_color(red);
+                    this->left_rotate(parent);
                     uncle = static_cast<RedBlackNode*>(parent->right);
                 }
 
@@ -181,29 +1061,30 @@ class rb_tree : public balanced_bst<T, Compare, Allocator>
                 auto* cousin_right = static_cast<RedBlackNode*>(uncle->right);
 
                 if (col(cousin_left) == black && col(cousin_right) == black) {
-                    uncle->color = red;
-                    node         = parent;
+                    uncle->set_color(red);
+                    node   = parent;
+                    parent = parent_of(node);
                 } else {
                     if (col(cousin_right) == black) {
-                        cousin_left->color = black;
-                        uncle->color       = red;
-                        uncle->right_rotate();
+                        cousin_left->set_color(black);
+                        uncle->set_color(red);
+                        this->right_rotate(uncle);
                         uncle = static_cast<RedBlackNode*>(parent->right);
                     }
 
-                    uncle->color  = parent->color;
-                    parent->color = black;
-                    static_cast<RedBlackNode*>(uncle->right)->color = black;
-                    parent->left_rotate();
+                    uncle->set_color(parent->color());
+                    parent->set_color(black);
+                    static_cast<RedBlackNode*>(uncle->right)->set_color(black);
+                    this->left_rotate(parent);
                     node = static_cast<RedBlackNode*>(this->sentinel_->root);
                 }
             } else {
                 auto* uncle = static_cast<RedBlackNode*>(parent->left);
 
                 if (col(uncle) == red) {
-                    uncle->color  = black;
-                    parent->color = red;
-                    parent->right_rotate();
+                    uncle->set_color(black);
+                    parent->set_color(red);
+                    this->right_rotate(parent);
                     uncle = static_cast<RedBlackNode*>(parent->left);
                 }
 
@@ -211,26 +1092,27 @@ class rb_tree : public balanced_bst<T, Compare, Allocator>
                 auto* cousin_right = static_cast<RedBlackNode*>(uncle->right);
 
                 if (col(cousin_left) == black && col(cousin_right) == black) {
-                    uncle->color = red;
-                    node         = parent;
+                    uncle->set_color(red);
+                    node   = parent;
+                    parent = parent_of(node);
                 } else {
                     if (col(cousin_left) == black) {
-                        cousin_right->color = black;
-                        uncle->color        = red;
-                        uncle->left_rotate();
+                        cousin_right->set_color(black);
+                        uncle->set_color(red);
+                        this->left_rotate(uncle);
                         uncle = static_cast<RedBlackNode*>(parent->left);
                     }
 
-                    uncle->color  = parent->color;
-                    parent->color = black;
-                    static_cast<RedBlackNode*>(uncle->left)->color = black;
-                    parent->right_rotate();
+                    uncle->set_color(parent->color());
+                    parent->set_color(black);
+                    static_cast<RedBlackNode*>(uncle->left)->set_color(black);
+                    this->right_rotate(parent);
                     node = static_cast<RedBlackNode*>(this->sentinel_->root);
                 }
             }
         }
 
-        node->color = black;
+        if (node != nullptr) node->set_color(black);
     }
 };
 
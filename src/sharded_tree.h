@@ -0,0 +1,566 @@
+#ifndef SHARDED_TREE_H
+#define SHARDED_TREE_H
+
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+/* an ordered multiset split by key ranges into N rb_trees, each behind a lock
+ * of its own
+ *
+ * the N - 1 boundaries route every key to a shard: shard i holds the keys that
+ * are not less than boundary i - 1 and less than boundary i; so writers to
+ * different ranges do not contend, and the shards concatenated in order are
+ * the whole tree in order
+ *
+ * the boundaries are guarded by a lock of their own; every operation holds it
+ * shared while it works on the shards, and rebalance holds it exclusively
+ * (SEE: rebalance); the locks are always taken in that order, and the shard
+ * locks in the order of the shards
+ *
+ * until the first rebalance (unless boundaries are given) every key goes to
+ * the first shard */
+template <typename T,
+          typename Compare   = std::less<T>,
+          typename Allocator = std::allocator<T>,
+          size_t N           = 16>
+class sharded_tree
+{
+    static_assert(N > 0);
+
+    // the shards keep order_statistics; so rebalance can split them by rank
+    using Tree = rb_tree<T, Compare, Allocator, order_statistics>;
+
+    // NOTE: 64 rather than std::hardware_destructive_interference_size;
+    // SEE: epoch_domain::Record
+    struct alignas(64) Shard {
+        explicit Shard(const Compare& compare)
+            : tree{compare}
+        {
+        }
+
+        mutable std::shared_mutex mutex;
+        Tree                      tree;
+
+        // tree.size() for readers not holding mutex (SEE: rebalance_if_skewed)
+        std::atomic<size_t> size{0};
+
+        // the updates since the skew was last checked; guarded by mutex
+        size_t writes{0};
+    };
+
+    class ConstShardedIterator;
+    class LockedView;
+
+  public:
+    using value_type = T;
+
+    using allocator_type  = Allocator;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_compare   = Compare;
+
+    using reference       = const value_type&;
+    using const_reference = reference;
+
+    using const_iterator = ConstShardedIterator;
+    using iterator       = const_iterator;
+
+    using locked_view = LockedView;
+
+    static constexpr size_t shard_count{N};
+
+    // the skew is checked every check_interval updates of a shard
+    static constexpr size_t check_interval{4096};
+
+    // a shard is skewed once it is max_skew times as large as the average
+    static constexpr size_t max_skew{2};
+
+    // the storage arenas per shard that rebalance lets the shards share
+    static constexpr size_t max_arenas{2};
+
+  private:
+    /* iterates over the shards in order
+     *
+     * NOTE: only valid while the locks of the locked_view it was taken from
+     * are held */
+    class ConstShardedIterator
+    {
+        friend class sharded_tree;
+
+      private:
+        using Self          = ConstShardedIterator;
+        using ShardIterator = typename Tree::const_iterator;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        using reference = const T&;
+        using pointer   = const T*;
+
+        const T& operator*() const noexcept { return *it_; }
+        const T* operator->() const noexcept { return std::addressof(*it_); }
+
+        Self& operator++() noexcept
+        {
+            ++it_;
+            skip_exhausted();
+            return *this;
+        }
+
+        Self operator++(int) noexcept
+        {
+            Self tmp{*this};
+            ++*this;
+            return tmp;
+        }
+
+        // NOTE: the shard iterators are only compared within the same shard
+        friend bool operator==(const Self& lhs, const Self& rhs) noexcept
+        {
+            return lhs.shard_ == rhs.shard_
+                   && (lhs.shard_ == N || lhs.it_ == rhs.it_);
+        }
+
+        friend bool operator!=(const Self& lhs, const Self& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+      private:
+        const sharded_tree* tree_;
+        size_t              shard_;
+        ShardIterator       it_;
+
+        ConstShardedIterator(const sharded_tree* tree,
+                             size_t              shard,
+                             ShardIterator       it) noexcept
+            : tree_{tree}
+            , shard_{shard}
+            , it_{it}
+        {
+            skip_exhausted();
+        }
+
+        // moves on to the first element of the next shard that has one
+        void skip_exhausted() noexcept
+        {
+            while (shard_ < N && it_ == tree_->shards_[shard_]->tree.end()) {
+                if (++shard_ < N) it_ = tree_->shards_[shard_]->tree.begin();
+            }
+        }
+    };
+
+    /* the whole tree, read locked
+     *
+     * holds the boundaries and every shard shared until it is destroyed; so
+     * the elements it iterates over are a consistent view of the tree */
+    class LockedView
+    {
+        friend class sharded_tree;
+
+      public:
+        [[nodiscard]] size_t size() const noexcept
+        {
+            size_t n = 0;
+            for (const auto& shard : tree_->shards_) n += shard->tree.size();
+            return n;
+        }
+
+        [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+        const_iterator begin() const noexcept
+        {
+            return const_iterator{tree_, 0, tree_->shards_[0]->tree.begin()};
+        }
+
+        const_iterator end() const noexcept
+        {
+            return const_iterator{tree_, N, tree_->shards_[N - 1]->tree.end()};
+        }
+
+      private:
+        const sharded_tree*                  tree_;
+        std::shared_lock<std::shared_mutex> bounds_lock_;
+
+        std::array<std::shared_lock<std::shared_mutex>, N> shard_locks_;
+
+        explicit LockedView(const sharded_tree& tree)
+            : tree_{&tree}
+            , bounds_lock_{tree.bounds_mutex_}
+        {
+            for (size_t i = 0; i < N; ++i) {
+                shard_locks_[i] =
+                    std::shared_lock<std::shared_mutex>{tree.shards_[i]->mutex};
+            }
+        }
+    };
+
+  public:
+    sharded_tree()
+        : sharded_tree{Compare{}}
+    {
+    }
+
+    explicit sharded_tree(const Compare& compare)
+        : compare_{compare}
+    {
+        for (auto& shard : shards_) shard = std::make_unique<Shard>(compare);
+    }
+
+    /* the boundaries are given up front (e.g., when the key distribution is
+     * known); they have to be sorted, and only the first N - 1 are used (with
+     * fewer, the last shards stay empty)
+     *
+     * NOTE: rebalance still replaces them once the shards become skewed */
+    explicit sharded_tree(std::vector<T, Allocator> bounds,
+                          const Compare&            compare = Compare{})
+        : sharded_tree{compare}
+    {
+        bounds_ = std::move(bounds);
+        if (bounds_.size() >= N) {
+            bounds_.erase(bounds_.begin() + (N - 1), bounds_.end());
+        }
+    }
+
+    sharded_tree(const sharded_tree&)            = delete;
+    sharded_tree& operator=(const sharded_tree&) = delete;
+
+    value_compare value_comp() const { return compare_; }
+
+    // NOTE: the sum of the shard sizes at slightly different times
+    [[nodiscard]] size_t size() const noexcept
+    {
+        size_t n = 0;
+        for (const auto& shard : shards_) {
+            n += shard->size.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    // the sizes of the shards in order; SEE: size
+    std::array<size_t, N> shard_sizes() const noexcept
+    {
+        std::array<size_t, N> sizes{};
+        for (size_t i = 0; i < N; ++i) {
+            sizes[i] = shards_[i]->size.load(std::memory_order_relaxed);
+        }
+        return sizes;
+    }
+
+    void insert(const T& data) { emplace(data); }
+
+    void insert(T&& data) { emplace(std::move(data)); }
+
+    // NOTE: the element is built first; its shard depends on it
+    template <typename... Args>
+    void emplace(Args&&... args)
+    {
+        bool check = false;
+
+        {
+            T data(std::forward<Args>(args)...);
+
+            std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+            Shard&                              shard = route(data);
+            std::unique_lock<std::shared_mutex> lock{shard.mutex};
+
+            shard.tree.insert(std::move(data));
+            check = updated(shard, 1);
+        }
+
+        if (check) rebalance_if_skewed();
+    }
+
+    /* inserts [first, last) in one batch
+     *
+     * the elements are routed to their shards first (with the boundaries held
+     * only once), and then every shard is locked once for all of its
+     * elements */
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last)
+    {
+        using Batch = std::vector<T, Allocator>;
+
+        bool check = false;
+
+        {
+            std::array<Batch, N> batches;
+
+            std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+            for (; first != last; ++first) {
+                T data(*first);
+                batches[index_of(data)].push_back(std::move(data));
+            }
+
+            for (size_t i = 0; i < N; ++i) {
+                if (batches[i].empty()) continue;
+
+                Shard&                              shard = *shards_[i];
+                std::unique_lock<std::shared_mutex> lock{shard.mutex};
+
+                for (T& data : batches[i]) shard.tree.insert(std::move(data));
+                check = updated(shard, batches[i].size()) || check;
+            }
+        }
+
+        if (check) rebalance_if_skewed();
+    }
+
+    void insert(std::initializer_list<T> init)
+    {
+        insert(init.begin(), init.end());
+    }
+
+    // erases every element equivalent to data; returns how many there were
+    size_type erase(const T& data)
+    {
+        size_type erased{0};
+        bool      check = false;
+
+        {
+            std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+            Shard&                              shard = route(data);
+            std::unique_lock<std::shared_mutex> lock{shard.mutex};
+
+            auto [it, last] = shard.tree.equal_range(data);
+            while (it != last) {
+                it = shard.tree.erase(it);
+                ++erased;
+            }
+
+            if (erased > 0) check = updated(shard, erased);
+        }
+
+        if (check) rebalance_if_skewed();
+
+        return erased;
+    }
+
+    void clear()
+    {
+        std::unique_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+        for (auto& shard : shards_) {
+            shard->tree.clear();
+            shard->size.store(0, std::memory_order_relaxed);
+            shard->writes = 0;
+        }
+    }
+
+    [[nodiscard]] bool contains(const T& data) const
+    {
+        std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+        const Shard&                        shard = route(data);
+        std::shared_lock<std::shared_mutex> lock{shard.mutex};
+
+        return shard.tree.find(data) != shard.tree.end();
+    }
+
+    // O(log n); the shards keep order_statistics
+    size_type count(const T& data) const
+    {
+        std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+        const Shard&                        shard = route(data);
+        std::shared_lock<std::shared_mutex> lock{shard.mutex};
+
+        return shard.tree.count(data);
+    }
+
+    /* visits every element in order
+     *
+     * the shards are locked one at a time; so updates of the shards visited
+     * already (or not yet) may go on meanwhile, but no element moves between
+     * shards */
+    template <typename Visitor>
+    void for_each(Visitor&& visit) const
+    {
+        std::shared_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+        for (const auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock{shard->mutex};
+            for (const T& data : shard->tree) visit(data);
+        }
+    }
+
+    // the whole tree, locked for iteration; SEE: locked_view
+    locked_view lock_shared() const { return locked_view{*this}; }
+
+    /* moves the boundaries so that the shards hold (about) as many elements
+     * each, and the elements along with them
+     *
+     * the shards are concatenated into a single tree and then split at the
+     * elements of rank size() * i / N, all without copying a node (SEE:
+     * rb_tree::concat and rb_tree::split); so this takes O(N log n), for
+     * which time every other operation waits
+     *
+     * the shards share the storage of the nodes they took over from each
+     * other; once that adds up to more than max_arenas arenas per shard the
+     * nodes are moved into storage of their own first, which takes O(n)
+     * (SEE: bst::compact)
+     *
+     * NOTE: this is called on its own once the shards are skewed; SEE:
+     * max_skew */
+    void rebalance()
+    {
+        std::unique_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+        rebalance_locked();
+    }
+
+  private:
+    std::array<std::unique_ptr<Shard>, N> shards_;
+
+    std::vector<T, Allocator> bounds_;
+    mutable std::shared_mutex      bounds_mutex_;
+
+    [[no_unique_address]] Compare compare_;
+
+    // NOTE: the caller holds bounds_mutex_
+    size_t index_of(const T& data) const
+    {
+        return static_cast<size_t>(
+            std::upper_bound(bounds_.begin(), bounds_.end(), data, compare_)
+            - bounds_.begin());
+    }
+
+    Shard& route(const T& data) { return *shards_[index_of(data)]; }
+
+    const Shard& route(const T& data) const { return *shards_[index_of(data)]; }
+
+    // records that shard (whose lock the caller holds) has been updated;
+    // true if it is time to check the skew
+    static bool updated(Shard& shard, size_t writes) noexcept
+    {
+        shard.size.store(shard.tree.size(), std::memory_order_relaxed);
+
+        bool check = shard.writes + writes >= check_interval;
+        shard.writes = check ? 0 : shard.writes + writes;
+        return check;
+    }
+
+    // NOTE: the shard sizes are read without the shard locks; rebalance
+    // checks again
+    [[nodiscard]] bool skewed() const noexcept
+    {
+        auto   sizes = shard_sizes();
+        size_t total = 0;
+        size_t most  = 0;
+
+        for (size_t n : sizes) {
+            total += n;
+            most = std::max(most, n);
+        }
+
+        return N > 1 && most > check_interval && most * N > max_skew * total;
+    }
+
+    void rebalance_if_skewed()
+    {
+        if (!skewed()) return;
+
+        std::unique_lock<std::shared_mutex> bounds_lock{bounds_mutex_};
+
+        // another thread may have rebalanced meanwhile
+        if (skewed()) rebalance_locked();
+    }
+
+    /* NOTE: the caller holds bounds_mutex_ exclusively; so no shard lock is
+     * held by anyone else
+     *
+     * the shards are merged into the first one and split off it again one at
+     * a time; every step either completes or throws leaving the shards as
+     * they were, and the boundaries are kept in step with the shards after
+     * each (with fewer of them the last shards are empty). so if anything
+     * throws no element is lost, and the tree is only left less balanced
+     *
+     * the shards themselves stay in place (SEE: shard_sizes); their trees
+     * are swapped along instead, which only exchanges pointers (SEE:
+     * rb_tree::swap)
+     *
+     * NOTE: this relies on moving a T not throwing (the boundaries are moved
+     * along the vector) */
+    void rebalance_locked()
+    {
+        // so that adding the boundaries back does not allocate
+        bounds_.reserve(N - 1);
+
+        try {
+            Tree& whole = shards_[0]->tree;
+
+            while (!bounds_.empty()) {
+                whole = Tree::concat(std::move(whole),
+                                     std::move(shards_[1]->tree));
+
+                // the emptied tree goes last
+                for (size_t i = 1; i + 1 < N; ++i) {
+                    shards_[i]->tree.swap(shards_[i + 1]->tree);
+                }
+                bounds_.erase(bounds_.begin());
+            }
+
+            // the shards gather the arenas of one another: each split hands
+            // all of them to both parts, and every shard adds one of its own
+            // once it allocates again (SEE: rebalance)
+            if constexpr (requires { whole.compact(); }) {
+                if (whole.arena_count() > max_arenas * N) whole.compact();
+            }
+
+            size_t total = whole.size();
+
+            // split off the last shard first; whole keeps the ones before it
+            for (size_t i = N - 1; i > 0 && total > 0; --i) {
+                auto bound = whole.select(total * i / N);
+
+                // equivalent elements never straddle a boundary; if the ones
+                // from here on all went to the shards after this one, this
+                // one is left empty
+                T key = bound != whole.end() ? *bound : bounds_.front();
+
+                Tree rest = whole.split(key);
+
+                // the trees after the first move along; the last is empty
+                for (size_t j = N - 1; j > 1; --j) {
+                    shards_[j]->tree.swap(shards_[j - 1]->tree);
+                }
+                shards_[1]->tree.swap(rest);
+                bounds_.insert(bounds_.begin(), std::move(key));
+            }
+        } catch (...) {
+            refresh_sizes();
+            throw;
+        }
+
+        refresh_sizes();
+    }
+
+    // NOTE: the caller holds bounds_mutex_ exclusively
+    void refresh_sizes() noexcept
+    {
+        for (auto& shard : shards_) {
+            shard->size.store(shard->tree.size(), std::memory_order_relaxed);
+            shard->writes = 0;
+        }
+    }
+};
+
+#endif // SHARDED_TREE_H
@@ -0,0 +1,257 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* a fork-join thread pool
+ *
+ * every worker has a deque of tasks; forked tasks are pushed onto (and taken
+ * back from) the back of the forking worker's deque, while idle workers steal
+ * from the front of the others' deques; so a worker mostly runs the tasks it
+ * forked itself, and thieves take the oldest (i.e., largest) ones
+ *
+ * threads that are not workers of the pool share one more deque; they may
+ * fork as well, and help running tasks while they wait for theirs
+ *
+ * no thread spins: idle workers sleep until a task is pushed, and a thread
+ * waiting for a stolen task sleeps on that task until it has finished once
+ * there is nothing left to help with. pushing a task only takes the lock the
+ * workers sleep under when one of them is asleep; so a busy pool forks and
+ * joins without any lock but the ones of the deques */
+class work_stealing_pool
+{
+  public:
+    explicit work_stealing_pool(
+        size_t threads = std::thread::hardware_concurrency())
+    {
+        // the last queue is the one shared by outside threads
+        for (size_t i = 0; i <= threads; ++i) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    work_stealing_pool(const work_stealing_pool&)            = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex_};
+            stop_.store(true, std::memory_order_relaxed);
+        }
+        wake_.notify_all();
+
+        for (auto& worker : workers_) worker.join();
+    }
+
+    [[nodiscard]] size_t size() const noexcept { return workers_.size(); }
+
+    /* runs left and right, possibly in parallel, and returns once both have
+     * finished; right is the one offered to the other threads
+     *
+     * if either throws, the exception is rethrown here (left's first) after
+     * both have finished */
+    template <typename Left, typename Right>
+    void fork_join(Left&& left, Right&& right)
+    {
+        TaskFor<Right> task{std::forward<Right>(right)};
+
+        size_t self = queue_index();
+        push(self, &task);
+
+        std::exception_ptr error;
+        try {
+            std::forward<Left>(left)();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // help out until right has been run; most of the time it is still
+        // at the back of our own deque
+        Task::State state;
+        while ((state = task.state.load(std::memory_order_acquire))
+               != Task::released) {
+            Task* next = pop(self);
+            if (next == nullptr) next = steal(self);
+
+            if (next != nullptr) {
+                execute(next);
+                continue;
+            }
+
+            // right was stolen; it is either still running, or its thief is
+            // about to let go of it (SEE: execute)
+            if (state == Task::running) {
+                task.state.wait(Task::running, std::memory_order_acquire);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        if (error) std::rethrow_exception(error);
+        if (task.error) std::rethrow_exception(task.error);
+    }
+
+  private:
+    struct Task {
+        explicit Task(void (*invoke)(Task*)) noexcept
+            : invoke{invoke}
+        {
+        }
+
+        // finished: it has run, but its thread is still waking the joiner
+        enum State : unsigned char { running, finished, released };
+
+        void (*invoke)(Task*);
+
+        std::atomic<State> state{running};
+        std::exception_ptr error;
+    };
+
+    template <typename Function>
+    struct TaskFor : public Task {
+        explicit TaskFor(Function&& function)
+            : Task{&TaskFor::run}
+            , function{std::forward<Function>(function)}
+        {
+        }
+
+        static void run(Task* task)
+        {
+            std::forward<Function>(static_cast<TaskFor*>(task)->function)();
+        }
+
+        Function&& function;
+    };
+
+    struct Queue {
+        std::mutex        mutex;
+        std::deque<Task*> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread>            workers_;
+
+    std::atomic<bool>       stop_{false};
+    std::atomic<size_t>     pending_{0};
+    std::atomic<size_t>     sleepers_{0};
+    std::mutex              sleep_mutex_;
+    std::condition_variable wake_;
+
+    // the pool (and worker index) of the calling thread, if it is a worker
+    static inline thread_local const work_stealing_pool* owner_{nullptr};
+    static inline thread_local size_t                    index_{0};
+
+    size_t queue_index() const noexcept
+    {
+        return owner_ == this ? index_ : workers_.size();
+    }
+
+    void work(size_t index)
+    {
+        owner_ = this;
+        index_ = index;
+
+        while (true) {
+            Task* next = pop(index);
+            if (next == nullptr) next = steal(index);
+
+            if (next != nullptr) {
+                execute(next);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{sleep_mutex_};
+            if (stop_.load(std::memory_order_relaxed)) return;
+
+            // NOTE: sleepers_ is raised before pending_ is read, and push
+            // raises pending_ before it reads sleepers_ (all seq_cst); so
+            // either this worker sees the task, or push sees the sleeper
+            sleepers_.fetch_add(1);
+            wake_.wait(lock, [this] {
+                return stop_.load(std::memory_order_relaxed)
+                       || pending_.load() > 0;
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void push(size_t index, Task* task)
+    {
+        {
+            Queue&                      queue = *queues_[index];
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            queue.tasks.push_back(task);
+        }
+
+        // SEE: work; a worker that is about to sleep has checked pending_
+        // under the lock, so taking it once is enough for it not to miss
+        // the notification
+        pending_.fetch_add(1);
+        if (sleepers_.load() == 0) return;
+
+        { std::lock_guard<std::mutex> lock{sleep_mutex_}; }
+        wake_.notify_one();
+    }
+
+    Task* pop(size_t index)
+    {
+        Queue&                      queue = *queues_[index];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+
+        if (queue.tasks.empty()) return nullptr;
+
+        Task* task = queue.tasks.back();
+        queue.tasks.pop_back();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+
+    Task* steal(size_t thief)
+    {
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            Queue& queue = *queues_[(thief + i) % queues_.size()];
+
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            if (queue.tasks.empty()) continue;
+
+            Task* task = queue.tasks.front();
+            queue.tasks.pop_front();
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+
+        return nullptr;
+    }
+
+    void execute(Task* task) noexcept
+    {
+        try {
+            task->invoke(task);
+        } catch (...) {
+            task->error = std::current_exception();
+        }
+
+        // NOTE: the joiner waits for released to let go of task; so task is
+        // still there to be notified, and is not touched afterwards
+        task->state.store(Task::finished, std::memory_order_release);
+        task->state.notify_all();
+        task->state.store(Task::released, std::memory_order_release);
+    }
+};
+
+#endif // WORK_STEALING_POOL_H
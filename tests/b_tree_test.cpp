@@ -0,0 +1,143 @@
+/* b_tree against std::multiset: splits and merges of its nodes, lookups,
+ * and bulk loading */
+
+#include "check.h"
+
+#include "b_tree.h"
+
+#include <iterator>
+#include <string>
+
+namespace {
+
+constexpr long key_range{500};
+
+template <typename Tree>
+void churn()
+{
+    Tree  tree;
+    Model model;
+    check_churn(tree, model, key_range);
+
+    Tree copy;
+    copy.assign_sorted(model.begin(), model.end());
+    CHECK(copy.verify());
+    CHECK(same_elements(copy, model));
+
+    tree.clear();
+    CHECK(tree.empty());
+    CHECK(tree.begin() == tree.end());
+}
+
+// an element that is not trivially copyable
+void strings()
+{
+    b_tree<std::string>        tree;
+    std::multiset<std::string> model;
+    KeySource                  keys{key_range};
+
+    for (int i = 0; i < 5000; ++i) {
+        std::string key = "key " + std::to_string(keys());
+        if (keys.chance(60)) {
+            tree.insert(key);
+            model.insert(key);
+        } else if (auto it = tree.find(key); it != tree.end()) {
+            tree.erase(it);
+            model.erase(model.find(key));
+        }
+    }
+
+    CHECK(tree.verify());
+    CHECK(same_elements(tree, model));
+}
+
+// the value goes right before the hint where it fits there, and where it
+// belongs otherwise
+template <typename Tree>
+void hinted()
+{
+    Tree  tree;
+    Model model;
+
+    // appending at end(), with runs of equivalent values
+    for (long i = 0; i < 3000; ++i) {
+        auto it = tree.emplace_hint(tree.end(), i / 3);
+        CHECK(*it == i / 3 && std::next(it) == tree.end());
+        model.insert(i / 3);
+    }
+
+    // descending, each right before the one inserted last
+    auto hint = tree.begin();
+    for (long key = -1; key > -3000; --key) {
+        hint = tree.insert(hint, key);
+        CHECK(*hint == key && hint == tree.begin());
+        model.insert(key);
+    }
+
+    CHECK(tree.size() == model.size());
+    CHECK(same_elements(tree, model));
+
+    // next to an equivalent, wherever in the tree that is (in a full leaf
+    // the value goes after its equivalents instead)
+    for (long key = -2999; key < 1000; key += 7) {
+        auto it = tree.insert(tree.find(key), key);
+        CHECK(*it == key);
+        CHECK(it == tree.lower_bound(key) || *std::prev(it) == key);
+        model.insert(key);
+    }
+
+    // hints that are off
+    KeySource keys{key_range};
+    for (int i = 0; i < 3000; ++i) {
+        long key = keys();
+        auto at  = keys.chance(50) ? tree.begin() : tree.end();
+        hint     = tree.insert(at, key);
+        CHECK(*hint == key);
+        model.insert(key);
+    }
+
+    CHECK(tree.verify());
+    CHECK(tree.size() == model.size());
+    CHECK(same_elements(tree, model));
+    check_lookups(tree, model, key_range);
+}
+
+// appending at end() compares with the last element alone, but where the
+// rightmost leaf is full
+void hinted_append()
+{
+    size_t compares = 0;
+    auto   less     = [&compares](long lhs, long rhs) {
+        ++compares;
+        return lhs < rhs;
+    };
+
+    b_tree<long, decltype(less)> tree{less};
+    for (long i = 0; i < 10000; ++i) tree.emplace_hint(tree.end(), i);
+
+    CHECK(tree.size() == 10000);
+    CHECK(compares < 2 * tree.size());
+    CHECK(tree.verify());
+}
+
+// the lookups pass on what the comparator throws
+void throwing_compare()
+{
+    b_tree<long, ThrowingLess> tree;
+    for (long i = 0; i < 10; ++i) tree.insert(i);
+
+    check_throwing_lookups(tree);
+    CHECK(tree.size() == 10);
+}
+
+} // namespace
+
+int main()
+{
+    churn<b_tree<long>>();
+    strings();
+    hinted<b_tree<long>>();
+    hinted_append();
+    throwing_compare();
+    return 0;
+}
@@ -0,0 +1,174 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+/* what the tests check with
+ *
+ * unlike assert, CHECK is kept when NDEBUG is defined (the tests are built
+ * like everything else, as Release by default); a failed check reports where
+ * it failed and aborts the test
+ *
+ * the containers are checked against a std::multiset fed the same updates */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+
+#define CHECK(condition)                                                      \
+    ((condition) ? void(0) : check_failed(#condition, __FILE__, __LINE__))
+
+[[noreturn]] inline void check_failed(const char* condition,
+                                      const char* file,
+                                      int         line)
+{
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+    std::abort();
+}
+
+using Model = std::multiset<long>;
+
+// true if lhs and rhs hold equal elements in the same order
+template <typename Lhs, typename Rhs>
+bool same_elements(const Lhs& lhs, const Rhs& rhs)
+{
+    auto it = lhs.begin();
+    for (const auto& data : rhs) {
+        if (it == lhs.end() || !(*it == data)) return false;
+        ++it;
+    }
+    return it == lhs.end();
+}
+
+// the keys are drawn from a small range; so there are duplicates aplenty
+class KeySource
+{
+  public:
+    explicit KeySource(std::size_t range, unsigned seed = 42)
+        : engine_{seed}
+        , keys_{0, static_cast<long>(range) - 1}
+    {
+    }
+
+    long operator()() { return keys_(engine_); }
+
+    // true with a probability of percent / 100
+    bool chance(unsigned percent) { return engine_() % 100 < percent; }
+
+  private:
+    std::mt19937_64                     engine_;
+    std::uniform_int_distribution<long> keys_;
+};
+
+/* checks the lookups of tree (which holds the same elements as model) for
+ * every key in [-1, range]
+ *
+ * NOTE: tree has to provide find, lower_bound, upper_bound and count */
+template <typename Tree>
+void check_lookups(const Tree& tree, const Model& model, long range)
+{
+    for (long key = -1; key <= range; ++key) {
+        CHECK(tree.count(key) == model.count(key));
+        CHECK((tree.find(key) == tree.end()) == (model.count(key) == 0));
+
+        auto lower = tree.lower_bound(key);
+        auto upper = tree.upper_bound(key);
+        auto below = model.lower_bound(key);
+        auto above = model.upper_bound(key);
+
+        CHECK((lower == tree.end()) == (below == model.end()));
+        CHECK(lower == tree.end() || *lower == *below);
+        CHECK((upper == tree.end()) == (above == model.end()));
+        CHECK(upper == tree.end() || *upper == *above);
+    }
+}
+
+/* updates tree and model alike with random inserts and erases of keys in
+ * [0, range) (an erase takes out one element it finds), and calls visit()
+ * after every update (e.g., to take snapshots); then the contents and the
+ * lookups of tree are checked
+ *
+ * the invariants of tree are verified along the way where it can check them
+ * (i.e., has verify()); and where erase returns the next iterator it has to
+ * be the one std::multiset::erase returns
+ *
+ * NOTE: tree has to provide insert, find, lower_bound, erase and size */
+template <typename Tree, typename Visitor>
+void check_churn(Tree& tree, Model& model, long range, Visitor&& visit)
+{
+    constexpr bool verified = requires { tree.verify(); };
+
+    KeySource keys{static_cast<std::size_t>(range)};
+
+    for (int i = 0; i < 20000; ++i) {
+        long key = keys();
+        if (keys.chance(60)) {
+            tree.insert(key);
+            model.insert(key);
+        } else if (auto it = tree.find(key); it != tree.end()) {
+            // find may hit any of the equivalent elements; so the model
+            // erases the one of the same rank among them
+            auto rank  = std::distance(tree.lower_bound(key), it);
+            auto after = model.erase(std::next(model.lower_bound(key), rank));
+
+            if constexpr (std::is_void_v<decltype(tree.erase(it))>) {
+                tree.erase(it);
+            } else {
+                auto next = tree.erase(it);
+                CHECK((next == tree.end()) == (after == model.end()));
+                CHECK(next == tree.end() || *next == *after);
+            }
+        }
+
+        visit();
+
+        if constexpr (verified) {
+            if (i % 100 == 0) CHECK(tree.verify());
+        }
+    }
+
+    if constexpr (verified) CHECK(tree.verify());
+
+    CHECK(tree.size() == model.size());
+    CHECK(same_elements(tree, model));
+    check_lookups(tree, model, range);
+}
+
+template <typename Tree>
+void check_churn(Tree& tree, Model& model, long range)
+{
+    check_churn(tree, model, range, [] {});
+}
+
+// throws on the key 13; SEE: check_throwing_lookups
+struct ThrowingLess {
+    bool operator()(long lhs, long rhs) const
+    {
+        if (lhs == 13 || rhs == 13) throw std::runtime_error{"13"};
+        return lhs < rhs;
+    }
+};
+
+/* checks that the lookups of tree (ordered by ThrowingLess, and holding the
+ * keys 0 to 9) pass on what the comparator throws, and leave tree as it was
+ *
+ * NOTE: tree has to provide find and lower_bound */
+template <typename Tree>
+void check_throwing_lookups(const Tree& tree)
+{
+    static_assert(!noexcept(tree.find(1)));
+
+    bool thrown = false;
+    try {
+        static_cast<void>(tree.lower_bound(13));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(tree.find(5) != tree.end());
+}
+
+#endif // CHECK_H
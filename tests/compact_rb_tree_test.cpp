@@ -0,0 +1,108 @@
+/* compact_rb_tree against std::multiset; erasing moves the last node into
+ * the freed index, which every link to it has to follow */
+
+#include "check.h"
+
+#include "compact_rb_tree.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = compact_rb_tree<long>;
+
+void churn()
+{
+    Tree  tree;
+    Model model;
+    check_churn(tree, model, key_range);
+
+    Tree copy;
+    copy.assign_sorted(model.begin(), model.end());
+    CHECK(copy.verify());
+    CHECK(same_elements(copy, model));
+
+    tree.shrink_to_fit();
+    CHECK(same_elements(tree, model));
+
+    tree.clear();
+    CHECK(tree.empty());
+}
+
+// every walk visits each element of the subtree once, where its order says
+void visitors()
+{
+    Tree      tree;
+    Model     model;
+    KeySource keys{key_range};
+
+    for (int i = 0; i < 3000; ++i) {
+        long key = keys();
+        tree.insert(key);
+        model.insert(key);
+    }
+
+    auto collect = [](long data, std::vector<long>& out) {
+        out.push_back(data);
+    };
+
+    std::vector<long> pre;
+    std::vector<long> in;
+    std::vector<long> post;
+    tree.preorder_from(tree.root(), collect, pre);
+    tree.inorder_from(tree.root(), collect, in);
+    tree.postorder_from(tree.root(), collect, post);
+
+    CHECK(same_elements(in, model));
+    CHECK(pre.front() == *tree.root() && post.back() == *tree.root());
+    CHECK(std::is_permutation(pre.begin(), pre.end(), in.begin(), in.end()));
+    CHECK(std::is_permutation(post.begin(), post.end(), in.begin(), in.end()));
+
+    // a subtree holds a run of the elements in order
+    for (auto it = tree.begin(); it != tree.end(); std::advance(it, 97)) {
+        std::vector<long> run;
+        tree.inorder_from(it, collect, run);
+        CHECK(std::is_sorted(run.begin(), run.end()));
+        CHECK(std::count(run.begin(), run.end(), *it) > 0);
+
+        std::vector<long> order;
+        tree.preorder_from(it, collect, order);
+        CHECK(order.front() == *it);
+        CHECK(std::is_permutation(
+            order.begin(), order.end(), run.begin(), run.end()));
+
+        order.clear();
+        tree.postorder_from(it, collect, order);
+        CHECK(order.back() == *it);
+        CHECK(order.size() == run.size());
+
+        if (std::distance(it, tree.end()) <= 97) break;
+    }
+
+    tree.clear();
+    tree.inorder_from(tree.root(), collect, in);
+    CHECK(same_elements(in, model));
+}
+
+// the lookups pass on what the comparator throws
+void throwing_compare()
+{
+    compact_rb_tree<long, ThrowingLess> tree;
+    for (long i = 0; i < 10; ++i) tree.insert(i);
+
+    check_throwing_lookups(tree);
+    CHECK(tree.size() == 10);
+}
+
+} // namespace
+
+int main()
+{
+    churn();
+    visitors();
+    throwing_compare();
+    return 0;
+}
@@ -0,0 +1,96 @@
+/* concurrent_tree against std::multiset; a read_guard has to keep the
+ * version it pinned while the writers go on
+ *
+ * SEE: stress_test for concurrent readers and writers */
+
+#include "check.h"
+
+#include "concurrent_tree.h"
+
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = concurrent_tree<long>;
+
+void churn()
+{
+    Tree      tree;
+    Model     model;
+    KeySource keys{key_range};
+
+    auto reader = tree.make_reader();
+
+    for (int i = 0; i < 5000; ++i) {
+        long key = keys();
+        if (keys.chance(60)) {
+            tree.insert(key);
+            model.insert(key);
+        } else {
+            CHECK(tree.erase(key) == model.erase(key));
+        }
+    }
+
+    {
+        auto  guard = reader.read();
+        Model pinned{model};
+
+        std::vector<long> batch;
+        for (int i = 0; i < 100; ++i) batch.push_back(keys());
+
+        tree.update([&batch](auto& version) {
+            for (long key : batch) version.insert(key);
+        });
+        model.insert(batch.begin(), batch.end());
+        tree.collect();
+
+        CHECK(guard.size() == pinned.size());
+        CHECK(same_elements(guard, pinned));
+        check_lookups(guard, pinned, key_range);
+    }
+
+    auto guard = reader.read();
+    CHECK(same_elements(guard, model));
+    CHECK(same_elements(tree.snapshot(), model));
+
+    tree.clear();
+    CHECK(tree.snapshot().empty());
+}
+
+// a guard held across many updates keeps every version retired meanwhile;
+// retiring has to stay cheap while they pile up
+void long_guard()
+{
+    Tree  tree;
+    Model model;
+
+    auto reader = tree.make_reader();
+
+    {
+        auto guard = reader.read();
+
+        for (long key = 0; key < 50000; ++key) {
+            tree.insert(key);
+            model.insert(key);
+        }
+
+        CHECK(guard.empty());
+    }
+
+    tree.collect();
+
+    auto guard = reader.read();
+    CHECK(guard.size() == model.size());
+    CHECK(same_elements(guard, model));
+}
+
+} // namespace
+
+int main()
+{
+    churn();
+    long_guard();
+    return 0;
+}
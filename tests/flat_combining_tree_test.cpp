@@ -0,0 +1,113 @@
+/* flat_combining_tree against std::multiset, with a single writer; and a
+ * batch of two writers whose sort throws
+ *
+ * SEE: stress_test for several writers */
+
+#include "check.h"
+
+#include "flat_combining_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = flat_combining_tree<long>;
+
+void churn()
+{
+    Tree      tree;
+    Model     model;
+    KeySource keys{key_range};
+
+    auto writer = tree.make_writer();
+
+    for (int i = 0; i < 20000; ++i) {
+        long key = keys();
+        if (keys.chance(60)) {
+            writer.insert(key);
+            model.insert(key);
+        } else {
+            CHECK(writer.erase(key) == model.erase(key));
+        }
+    }
+
+    CHECK(tree.size() == model.size());
+    tree.read([&model](const Tree::tree_type& contents) {
+        CHECK(same_elements(contents, model));
+        check_lookups(contents, model, key_range);
+    });
+
+    tree.update([](Tree::tree_type& contents) { contents.clear(); });
+    CHECK(tree.empty());
+}
+
+// the first comparison of 13 with 14 throws, wherever it happens
+std::atomic<bool> armed{true};
+
+struct OnceThrowingLess {
+    bool operator()(long lhs, long rhs) const
+    {
+        if (std::min(lhs, rhs) == 13 && std::max(lhs, rhs) == 14
+            && armed.exchange(false)) {
+            throw std::runtime_error{"compare"};
+        }
+        return lhs < rhs;
+    }
+};
+
+/* two writers post 13 and 14 while the lock is held, so that (most likely)
+ * they are combined in one batch; then sorting the batch throws, and both
+ * are applied unsorted. otherwise the second one to be applied throws, and
+ * its writer is told so; either way every update is done */
+void throwing_sort()
+{
+    using ThrowingTree = flat_combining_tree<long, OnceThrowingLess>;
+
+    ThrowingTree        tree;
+    std::atomic<size_t> started{0};
+    std::atomic<size_t> failed{0};
+
+    std::vector<std::thread> writers;
+    tree.read([&](const ThrowingTree::tree_type&) {
+        for (long key : {13, 14}) {
+            writers.emplace_back([&tree, &started, &failed, key] {
+                auto writer = tree.make_writer();
+                started.fetch_add(1);
+                try {
+                    writer.insert(key);
+                } catch (const std::runtime_error&) {
+                    failed.fetch_add(1);
+                }
+            });
+        }
+
+        while (started.load() < 2) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    });
+
+    for (auto& writer : writers) writer.join();
+
+    CHECK(!armed.load());
+    CHECK(failed.load() <= 1);
+    CHECK(tree.size() == 2 - failed.load());
+    tree.read([&tree](const ThrowingTree::tree_type& contents) {
+        CHECK(contents.size() == tree.size());
+        CHECK(contents.verify());
+    });
+}
+
+} // namespace
+
+int main()
+{
+    churn();
+    throwing_sort();
+    return 0;
+}
@@ -0,0 +1,55 @@
+/* frozen_tree against std::multiset, for sizes around the boundaries of the
+ * Eytzinger layout */
+
+#include "check.h"
+
+#include "frozen_tree.h"
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = frozen_tree<long>;
+
+void lookups()
+{
+    KeySource keys{key_range};
+
+    for (size_t n : {0, 1, 2, 3, 7, 8, 9, 100, 1023, 1024, 1025, 5000}) {
+        Model model;
+        for (size_t i = 0; i < n; ++i) model.insert(keys());
+
+        Tree tree{model.begin(), model.end()};
+        CHECK(tree.size() == model.size());
+        CHECK(same_elements(tree, model));
+        CHECK(std::equal(tree.rbegin(), tree.rend(), model.rbegin()));
+        check_lookups(tree, model, key_range);
+
+        rb_tree<long> source;
+        source.assign_sorted(model.begin(), model.end());
+        CHECK(same_elements(Tree{source}, model));
+    }
+}
+
+// the lookups pass on what the comparator throws
+void throwing_compare()
+{
+    std::vector<long> sorted{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    frozen_tree<long, ThrowingLess> tree{sorted.begin(), sorted.end()};
+
+    check_throwing_lookups(tree);
+}
+
+} // namespace
+
+int main()
+{
+    lookups();
+    throwing_compare();
+    return 0;
+}
@@ -0,0 +1,60 @@
+/* persistent_tree against std::multiset; every snapshot taken along the way
+ * has to keep the contents it was taken with */
+
+#include "check.h"
+
+#include "persistent_tree.h"
+
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = persistent_tree<long>;
+
+void churn()
+{
+    Tree  tree;
+    Model model;
+
+    std::vector<std::pair<Tree, Model>> snapshots;
+
+    int updates = 0;
+    check_churn(tree, model, key_range, [&] {
+        if (updates++ % 1000 == 0) {
+            snapshots.emplace_back(tree.snapshot(), model);
+        }
+    });
+
+    for (const auto& [snapshot, contents] : snapshots) {
+        CHECK(snapshot.size() == contents.size());
+        CHECK(same_elements(snapshot, contents));
+    }
+
+    Tree copy{tree};
+    tree.clear();
+    CHECK(tree.empty());
+    CHECK(same_elements(copy, model));
+}
+
+// the lookups pass on what the comparator throws
+void throwing_compare()
+{
+    persistent_tree<long, ThrowingLess> tree;
+    for (long i = 0; i < 10; ++i) tree.insert(i);
+
+    // the view is the one whose lookups may be noexcept
+    check_throwing_lookups(tree.view());
+    CHECK(tree.size() == 10);
+}
+
+} // namespace
+
+int main()
+{
+    churn();
+    throwing_compare();
+    return 0;
+}
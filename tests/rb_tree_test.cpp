@@ -0,0 +1,1332 @@
+/* bst and rb_tree against std::multiset; every feature of the trees is
+ * checked by a function of its own, and the red-black trees are verified
+ * along the way */
+
+#include "check.h"
+
+#include "rb_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+template <typename Augment>
+using RbTree = rb_tree<long, std::less<long>, std::allocator<long>, Augment>;
+
+// the contents, and the invariants of the tree where it can check them (SEE:
+// rb_tree::verify)
+template <typename Tree>
+void check_tree(const Tree& tree, const Model& model)
+{
+    if constexpr (requires { tree.verify(); }) CHECK(tree.verify());
+
+    CHECK(tree.size() == model.size());
+    CHECK(tree.empty() == model.empty());
+    CHECK(same_elements(tree, model));
+}
+
+template <typename Tree>
+struct AugmentOf {
+    using type = void;
+};
+
+template <typename Compare, typename Allocator, typename Augment>
+struct AugmentOf<rb_tree<long, Compare, Allocator, Augment>> {
+    using type = Augment;
+};
+
+// what the tree keeps for its Augment
+template <typename Tree>
+void check_augment(const Tree& tree, const Model& model)
+{
+    using Augment = typename AugmentOf<Tree>::type;
+
+    if constexpr (std::is_same_v<Augment, order_statistics>) {
+        size_t k = 0;
+        for (auto it = model.begin(); it != model.end(); ++it, ++k) {
+            auto at = tree.select(k);
+            CHECK(*at == *it);
+            CHECK(tree.rank(at) == k);
+            if (it == model.begin() || *std::prev(it) != *it) {
+                CHECK(tree.rank(*it) == k);
+            }
+        }
+
+        CHECK(tree.select(model.size()) == tree.end());
+        CHECK(tree.rank(tree.end()) == model.size());
+        CHECK(tree.distance(tree.begin(), tree.end())
+              == static_cast<std::ptrdiff_t>(model.size()));
+    } else if constexpr (!std::is_void_v<Augment>) {
+        long sum = 0;
+        for (long data : model) sum += data;
+        CHECK(tree.aggregate() == sum);
+
+        // the ranges between every pair of keys a tenth of the range apart
+        for (long lo = -1; lo <= key_range; lo += key_range / 10) {
+            for (long hi = lo; hi <= key_range; hi += key_range / 10) {
+                long expected = 0;
+                for (auto it = model.lower_bound(lo);
+                     it != model.lower_bound(hi);
+                     ++it) {
+                    expected += *it;
+                }
+
+                CHECK(tree.aggregate(tree.lower_bound(lo), tree.lower_bound(hi))
+                      == expected);
+            }
+        }
+    }
+}
+
+// a full scan, and one from every tenth bound; SEE: bst::scan
+template <typename Tree>
+void check_scans(const Tree& tree, const Model& model)
+{
+    std::vector<long> scanned;
+    for (auto it = tree.scan(); it; ++it) scanned.push_back(*it);
+    CHECK(same_elements(scanned, model));
+
+    for (long key = -1; key <= key_range; key += key_range / 10) {
+        auto it       = tree.scan(tree.lower_bound(key));
+        auto expected = model.lower_bound(key);
+        CHECK(it.current() == tree.lower_bound(key));
+
+        for (; it && expected != model.end(); ++it, ++expected) {
+            CHECK(*it == *expected);
+        }
+        CHECK(!it && expected == model.end());
+        CHECK(it.current() == tree.end());
+    }
+}
+
+template <typename Tree>
+void churn(unsigned seed)
+{
+    Tree      tree;
+    Model     model;
+    KeySource keys{key_range, seed};
+
+    for (int i = 0; i < 20000; ++i) {
+        long key = keys();
+        if (keys.chance(60)) {
+            // every third insert has a hint, which is mostly off
+            if (i % 3 == 0) {
+                CHECK(*tree.insert(tree.end(), key) == key);
+            } else {
+                tree.insert(key);
+            }
+            model.insert(key);
+        } else if (auto it = tree.find(key); it != tree.end()) {
+            tree.erase(it);
+            model.erase(model.find(key));
+        }
+
+        if (i % 1000 == 0) check_tree(tree, model);
+    }
+
+    check_tree(tree, model);
+    check_lookups(tree, model, key_range);
+    check_augment(tree, model);
+    check_scans(tree, model);
+
+    Tree copy{tree};
+    tree.clear();
+    CHECK(tree.empty());
+    check_tree(copy, model);
+    check_augment(copy, model);
+}
+
+// assign_sorted links the sorted input as it is; assign sorts it first
+template <typename Tree>
+void sorted_build(unsigned seed)
+{
+    KeySource keys{key_range, seed};
+
+    for (size_t n : {0, 1, 2, 3, 7, 8, 100, 5000}) {
+        std::vector<long> values;
+        for (size_t i = 0; i < n; ++i) values.push_back(keys());
+        Model model{values.begin(), values.end()};
+
+        // whatever the tree held before is replaced
+        Tree tree;
+        tree.insert(key_range);
+        tree.assign_sorted(model.begin(), model.end());
+        check_tree(tree, model);
+        check_augment(tree, model);
+
+        for (size_t threads : {1, 4}) {
+            Tree unsorted;
+            unsorted.assign(values.begin(), values.end(), threads);
+            check_tree(unsorted, model);
+        }
+
+        // the tree takes further updates like any other
+        for (int i = 0; i < 100; ++i) {
+            long key = keys();
+            tree.insert(key);
+            model.insert(key);
+        }
+        check_tree(tree, model);
+        check_augment(tree, model);
+    }
+}
+
+// a batch much smaller than the tree is merged in, and a larger one rebuilds
+// the tree (SEE: bst::insert_many)
+template <typename Tree>
+void batch_insert(unsigned seed)
+{
+    using Strategy = typename Tree::insert_strategy;
+
+    KeySource keys{key_range, seed};
+
+    for (size_t n : {0, 1, 100, 3000}) {
+        for (size_t m : {0, 1, 50, 5000}) {
+            for (size_t threads : {1, 4}) {
+                Tree  tree;
+                Model model;
+                for (size_t i = 0; i < n; ++i) {
+                    long key = keys();
+                    tree.insert(key);
+                    model.insert(key);
+                }
+
+                std::vector<long> batch;
+                for (size_t i = 0; i < m; ++i) batch.push_back(keys());
+                model.insert(batch.begin(), batch.end());
+
+                Strategy taken =
+                    tree.insert_many(batch.begin(), batch.end(), threads);
+                CHECK(taken == (m < n ? Strategy::merge : Strategy::rebuild));
+                check_tree(tree, model);
+                check_augment(tree, model);
+            }
+        }
+    }
+}
+
+// the parallel walks fold the elements in the order of the sequential ones,
+// from every grain down to single elements
+template <typename Tree>
+void check_parallel_walks(const Tree& tree, work_stealing_pool& pool)
+{
+    using Walk = std::vector<long>;
+
+    auto visit   = [](long data, Walk& walk) { walk.push_back(data); };
+    auto combine = [](Walk lhs, Walk rhs) {
+        lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+        return lhs;
+    };
+
+    for (auto from : {tree.root(), tree.begin(), tree.lower_bound(42)}) {
+        Walk pre;
+        Walk in;
+        Walk post;
+        tree.preorder_from(from, visit, pre);
+        tree.inorder_from(from, visit, in);
+        tree.postorder_from(from, visit, post);
+
+        for (size_t grain : {size_t{1}, size_t{16}, Tree::default_grain}) {
+            CHECK(tree.parallel_preorder_from(
+                      from, pool, Walk{}, visit, combine, grain)
+                  == pre);
+            CHECK(tree.parallel_inorder_from(
+                      from, pool, Walk{}, visit, combine, grain)
+                  == in);
+            CHECK(tree.parallel_postorder_from(
+                      from, pool, Walk{}, visit, combine, grain)
+                  == post);
+        }
+    }
+}
+
+template <typename Tree>
+void parallel_walks(unsigned seed, work_stealing_pool& pool)
+{
+    KeySource keys{key_range, seed};
+
+    for (size_t n : {0, 1, 100, 10000}) {
+        Tree tree;
+        for (size_t i = 0; i < n; ++i) tree.insert(keys());
+        check_parallel_walks(tree, pool);
+    }
+
+    // deeper than the walks fork (SEE: bst::fork_levels)
+    Tree spine;
+    for (long i = 0; i < 200; ++i) spine.insert(i);
+    check_parallel_walks(spine, pool);
+
+    // what visit throws is passed on once the walk is over, and the pool
+    // goes on working
+    auto visit = [](long data, long& sum) {
+        if (data == 13) throw std::runtime_error{"13"};
+        sum += data;
+    };
+
+    bool thrown = false;
+    try {
+        static_cast<void>(spine.parallel_inorder_from(
+            spine.root(), pool, 0L, visit, std::plus<long>{}, 1));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    spine.erase(spine.find(13));
+    CHECK(spine.parallel_inorder_from(
+              spine.root(), pool, 0L, visit, std::plus<long>{}, 1)
+          == 199 * 200 / 2 - 13);
+}
+
+// trees deeper than a cursor keeps ancestors for (SEE: bst::cursor_depth):
+// a left spine, which pushes every node, and a zigzag, which pushes every
+// other one
+void deep_scan()
+{
+    bst<long> spine;
+    Model     model;
+    for (long i = 200; i > 0; --i) {
+        spine.insert(i);
+        model.insert(i);
+    }
+    CHECK(spine.height() >= 100);
+    check_scans(spine, model);
+
+    bst<long> zigzag;
+    model.clear();
+    for (long i = 0; i < 100; ++i) {
+        zigzag.insert(i);
+        zigzag.insert(1000 - i);
+        model.insert(i);
+        model.insert(1000 - i);
+    }
+    CHECK(zigzag.height() >= 100);
+    check_scans(zigzag, model);
+}
+
+template <typename Tree>
+Tree make_tree(const Model& model)
+{
+    Tree tree;
+    tree.assign_sorted(model.begin(), model.end());
+    return tree;
+}
+
+Model make_model(KeySource& keys, size_t n)
+{
+    Model model;
+    for (size_t i = 0; i < n; ++i) model.insert(keys());
+    return model;
+}
+
+// the operands of join and concat are left empty, and may be used on
+template <typename Tree>
+void check_taken(Tree& tree)
+{
+    check_tree(tree, Model{});
+
+    tree.insert(1);
+    check_tree(tree, Model{1});
+}
+
+template <typename Tree>
+void split_and_join(unsigned seed)
+{
+    KeySource keys{key_range, seed};
+
+    for (size_t n : {0, 1, 2, 10, 100, 2000}) {
+        Model model = make_model(keys, n);
+
+        for (long key : {-1L, 0L, key_range / 3, key_range / 2, key_range}) {
+            Tree left  = make_tree<Tree>(model);
+            Tree right = left.split(key);
+
+            Model less{model.begin(), model.lower_bound(key)};
+            Model not_less{model.lower_bound(key), model.end()};
+            check_tree(left, less);
+            check_tree(right, not_less);
+            check_augment(left, less);
+            check_augment(right, not_less);
+
+            // both parts are still trees of their own
+            left.insert(key - 1);
+            less.insert(key - 1);
+            right.insert(key);
+            not_less.insert(key);
+            check_tree(left, less);
+            check_tree(right, not_less);
+
+            Tree joined = Tree::join(std::move(left), key, std::move(right));
+            Model with_pivot{less};
+            with_pivot.insert(not_less.begin(), not_less.end());
+            with_pivot.insert(key);
+            check_tree(joined, with_pivot);
+            check_augment(joined, with_pivot);
+            check_taken(left);
+            check_taken(right);
+
+            Tree rest  = joined.split(key);
+            Tree whole = Tree::concat(std::move(joined), std::move(rest));
+            check_tree(whole, with_pivot);
+            check_augment(whole, with_pivot);
+            check_taken(joined);
+            check_taken(rest);
+        }
+    }
+}
+
+enum class SetOperation { unite, intersect, subtract };
+
+template <typename Tree>
+Tree combine(SetOperation        operation,
+             Tree&&              lhs,
+             Tree&&              rhs,
+             work_stealing_pool* pool)
+{
+    switch (operation) {
+    case SetOperation::unite:
+        return pool != nullptr
+                   ? Tree::set_union(std::move(lhs), std::move(rhs), *pool, 64)
+                   : Tree::set_union(std::move(lhs), std::move(rhs));
+    case SetOperation::intersect:
+        return pool != nullptr ? Tree::set_intersection(std::move(lhs),
+                                                        std::move(rhs),
+                                                        *pool,
+                                                        64)
+                               : Tree::set_intersection(std::move(lhs),
+                                                        std::move(rhs));
+    case SetOperation::subtract:
+        break;
+    }
+    return pool != nullptr
+               ? Tree::set_difference(std::move(lhs), std::move(rhs), *pool, 64)
+               : Tree::set_difference(std::move(lhs), std::move(rhs));
+}
+
+Model expected_of(SetOperation operation, const Model& lhs, const Model& rhs)
+{
+    Model expected;
+    auto  out = std::inserter(expected, expected.end());
+
+    switch (operation) {
+    case SetOperation::unite:
+        std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+        break;
+    case SetOperation::intersect:
+        std::set_intersection(
+            lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+        break;
+    case SetOperation::subtract:
+        std::set_difference(
+            lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+        break;
+    }
+
+    return expected;
+}
+
+template <typename Tree>
+void set_operations(unsigned seed, work_stealing_pool* pool)
+{
+    KeySource keys{key_range, seed};
+
+    for (size_t n : {0, 1, 50, 3000}) {
+        for (size_t m : {0, 1, 50, 3000}) {
+            Model lhs = make_model(keys, n);
+            Model rhs = make_model(keys, m);
+
+            for (auto operation : {SetOperation::unite,
+                                   SetOperation::intersect,
+                                   SetOperation::subtract}) {
+                Model expected = expected_of(operation, lhs, rhs);
+
+                Tree first  = make_tree<Tree>(lhs);
+                Tree second = make_tree<Tree>(rhs);
+                Tree result  = combine(
+                    operation, std::move(first), std::move(second), pool);
+                check_tree(result, expected);
+                check_augment(result, expected);
+                check_taken(first);
+                check_taken(second);
+            }
+        }
+    }
+}
+
+// looked up by its id alone; nothing in the lookups can build a Record
+struct Record {
+    long id;
+    long payload;
+};
+
+struct ById {
+    using is_transparent = void;
+
+    bool operator()(const Record& lhs, const Record& rhs) const noexcept
+    {
+        return lhs.id < rhs.id;
+    }
+
+    bool operator()(const Record& lhs, long rhs) const noexcept
+    {
+        return lhs.id < rhs;
+    }
+
+    bool operator()(long lhs, const Record& rhs) const noexcept
+    {
+        return lhs < rhs.id;
+    }
+};
+
+template <typename Tree>
+void transparent_lookup()
+{
+    Tree tree;
+    for (long i = 0; i < 100; ++i) tree.insert(Record{2 * i, i});
+
+    for (long id = -1; id <= 200; ++id) {
+        auto it = tree.find(id);
+        if (id % 2 == 0 && id < 200) {
+            CHECK(it != tree.end() && it->id == id && it->payload == id / 2);
+        } else {
+            CHECK(it == tree.end());
+        }
+    }
+
+    CHECK(tree.lower_bound(41L)->id == 42);
+    CHECK(tree.lower_bound(42L)->id == 42);
+    CHECK(tree.upper_bound(42L)->id == 44);
+    CHECK(tree.upper_bound(198L) == tree.end());
+    CHECK(tree.count(42L) == 1 && tree.count(43L) == 0);
+
+    auto [first, last] = tree.equal_range(42L);
+    CHECK(first == tree.find(42L) && last == tree.upper_bound(42L));
+
+    // position_of finds the element to replace the same way
+    tree.position_of(42L) = Record{42, -1};
+    CHECK(tree.find(42L)->payload == -1);
+    CHECK(tree.size() == 100);
+
+    if constexpr (requires { tree.split(42L); }) {
+        Tree right = tree.split(42L);
+        CHECK(tree.size() == 21 && tree.rbegin()->id == 40);
+        CHECK(right.size() == 79 && right.begin()->id == 42);
+    }
+}
+
+// equivalent elements end up as insert would leave them, whichever way the
+// batch goes in
+template <typename Tree>
+void batch_order()
+{
+    for (long m : {2, 20}) {
+        Tree tree;
+        for (long i = 0; i < 10; ++i) tree.insert(Record{i, 0});
+
+        std::vector<Record> batch;
+        for (long i = 1; i <= m; ++i) batch.push_back(Record{5, i});
+        tree.insert_many(batch.begin(), batch.end());
+        CHECK(tree.size() == static_cast<size_t>(10 + m));
+
+        long payload = 0;
+        for (auto [it, last] = tree.equal_range(5L); it != last; ++it) {
+            CHECK(it->payload == payload++);
+        }
+        CHECK(payload == m + 1);
+    }
+}
+
+// once armed, every comparison throws; a lookup has to pass that on
+bool compare_throws{false};
+
+// if not negative, the comparator throws once this many more calls are made;
+// atomic, as the parallel set operations compare from several threads
+std::atomic<long> compares_left{-1};
+
+struct ArmedLess {
+    bool operator()(long lhs, long rhs) const
+    {
+        long left = compares_left.load();
+        while (left > 0
+               && !compares_left.compare_exchange_weak(left, left - 1)) {
+        }
+
+        if (compare_throws || left == 0) throw std::runtime_error{"compare"};
+        return lhs < rhs;
+    }
+};
+
+template <typename Tree, typename Lookup>
+void check_throws(const Tree& tree, Lookup&& lookup)
+{
+    compare_throws = true;
+
+    bool thrown = false;
+    try {
+        lookup(tree);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    compare_throws = false;
+    CHECK(thrown);
+}
+
+template <typename Tree>
+void throwing_compare()
+{
+    Tree tree;
+    for (long i = 0; i < 100; ++i) tree.insert(i);
+
+    check_throws(tree, [](const Tree& tree) { return tree.find(7); });
+    check_throws(tree, [](const Tree& tree) { return tree.lower_bound(7); });
+    check_throws(tree, [](const Tree& tree) { return tree.upper_bound(7); });
+    check_throws(tree, [](const Tree& tree) { return tree.equal_range(7); });
+    check_throws(tree, [](const Tree& tree) { return tree.count(7); });
+
+    // the tree is left as it was
+    CHECK(tree.size() == 100);
+    CHECK(*tree.find(7) == 7);
+}
+
+// a split whose comparator throws part of the way leaves the tree whole
+template <typename Tree>
+void throwing_split()
+{
+    for (long calls = 0; calls < 16; ++calls) {
+        Tree tree;
+        for (long i = 0; i < 100; ++i) tree.insert(i);
+
+        compares_left = calls;
+
+        bool thrown = false;
+        try {
+            Tree right = tree.split(50L);
+            compares_left = -1;
+
+            CHECK(tree.verify() && right.verify());
+            CHECK(tree.size() == 50 && right.size() == 50);
+            CHECK(*right.begin() == 50);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        compares_left = -1;
+
+        if (!thrown) continue;
+
+        CHECK(tree.verify());
+        CHECK(tree.size() == 100);
+        CHECK(std::distance(tree.begin(), tree.end()) == 100);
+    }
+}
+
+// the elements alive; a node that is lost keeps its element alive
+long alive{0};
+
+struct Alive {
+    long key;
+
+    explicit Alive(long key) noexcept
+        : key{key}
+    {
+        ++alive;
+    }
+
+    Alive(const Alive& that) noexcept
+        : key{that.key}
+    {
+        ++alive;
+    }
+
+    Alive& operator=(const Alive&) noexcept = default;
+
+    ~Alive() { --alive; }
+};
+
+// as ArmedLess; SEE: compares_left
+struct ArmedAliveLess {
+    bool operator()(const Alive& lhs, const Alive& rhs) const
+    {
+        return ArmedLess{}(lhs.key, rhs.key);
+    }
+};
+
+/* a set operation whose comparator throws part of the way destroys the
+ * elements of both trees, and leaves them empty
+ *
+ * the trees are checked through alive; so a node that is lost (rather than
+ * destroyed) shows up after they are gone */
+template <typename Tree>
+void throwing_set_operations(work_stealing_pool* pool)
+{
+    enum { unite, intersect, subtract };
+
+    auto operate = [pool](int operation, Tree&& lhs, Tree&& rhs) {
+        constexpr size_t grain{8};
+
+        switch (operation) {
+        case unite:
+            return pool == nullptr
+                       ? Tree::set_union(std::move(lhs), std::move(rhs))
+                       : Tree::set_union(
+                             std::move(lhs), std::move(rhs), *pool, grain);
+        case intersect:
+            return pool == nullptr
+                       ? Tree::set_intersection(std::move(lhs), std::move(rhs))
+                       : Tree::set_intersection(
+                             std::move(lhs), std::move(rhs), *pool, grain);
+        default:
+            return pool == nullptr
+                       ? Tree::set_difference(std::move(lhs), std::move(rhs))
+                       : Tree::set_difference(
+                             std::move(lhs), std::move(rhs), *pool, grain);
+        }
+    };
+
+    for (int operation : {unite, intersect, subtract}) {
+        for (long calls = 0; calls < 400; calls += 13) {
+            {
+                Tree lhs;
+                Tree rhs;
+                for (long i = 0; i < 200; ++i) {
+                    lhs.emplace(i % 150);
+                    rhs.emplace(i % 120 + 50);
+                }
+
+                compares_left = calls;
+
+                bool thrown = false;
+                try {
+                    Tree result =
+                        operate(operation, std::move(lhs), std::move(rhs));
+                    compares_left = -1;
+                    CHECK(result.verify());
+                } catch (const std::runtime_error&) {
+                    thrown = true;
+                }
+                compares_left = -1;
+
+                CHECK(lhs.empty() && rhs.empty());
+                if (thrown) CHECK(alive == 0);
+            }
+
+            CHECK(alive == 0);
+        }
+    }
+}
+
+// comparing the two keys of poison (in either order) throws; so an update
+// can be made to fail once it has found its way into the tree
+std::pair<long, long> poison{-1, -1};
+
+struct PoisonedLess {
+    bool operator()(const Alive& lhs, const Alive& rhs) const
+    {
+        auto [low, high] = std::minmax(lhs.key, rhs.key);
+        if (low == poison.first && high == poison.second) {
+            throw std::runtime_error{"compare"};
+        }
+        return lhs.key < rhs.key;
+    }
+};
+
+// the keys of a tree in order, and its invariants where it can check them
+template <typename Tree>
+bool holds(const Tree& tree, const std::vector<long>& keys)
+{
+    if constexpr (requires { tree.verify(); }) {
+        if (!tree.verify()) return false;
+    }
+
+    std::vector<long> in_order;
+    for (const Alive& value : tree) in_order.push_back(value.key);
+
+    return tree.size() == keys.size() && in_order == keys;
+}
+
+template <typename Tree, typename Update>
+void check_fails(Tree& tree, Update&& update)
+{
+    bool thrown = false;
+    try {
+        update(tree);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    poison = {-1, -1};
+    CHECK(thrown);
+}
+
+// an update whose comparison throws leaves no element behind
+template <typename Tree>
+void throwing_update()
+{
+    std::vector<long> keys;
+    {
+        Tree tree;
+        for (long i = 0; i < 100; ++i) {
+            tree.emplace(i);
+            keys.push_back(i);
+        }
+
+        // past the maximum, the first comparison is the one with 99
+        poison = {99, 150};
+        check_fails(tree, [](Tree& tree) { tree.emplace(150); });
+        CHECK(holds(tree, keys));
+        CHECK(alive == 100);
+
+        // right before end() the hint costs the same single comparison
+        poison = {99, 150};
+        check_fails(tree,
+                    [](Tree& tree) { tree.emplace_hint(tree.end(), 150); });
+        CHECK(holds(tree, keys));
+        CHECK(alive == 100);
+
+        // a hint that is off searches from it (SEE: finger_slot); that
+        // search ends with the comparison with 99 as well
+        poison = {99, 150};
+        check_fails(tree, [](Tree& tree) {
+            tree.emplace_hint(tree.find(Alive{10}), 150);
+        });
+        CHECK(holds(tree, keys));
+        CHECK(alive == 100);
+
+        // the element is moved: it is unlinked before its new place is
+        // found, so it is erased
+        auto pos = tree.find(Alive{7});
+        poison   = {99, 150};
+        check_fails(tree, [&pos](Tree& tree) { tree.modify(pos, Alive{150}); });
+        keys.erase(keys.begin() + 7);
+        CHECK(holds(tree, keys));
+        CHECK(alive == 99);
+
+        // an equivalent value fails before anything changes
+        pos    = tree.find(Alive{8});
+        poison = {8, 8};
+        check_fails(tree, [&pos](Tree& tree) { tree.modify(pos, Alive{8}); });
+        CHECK(holds(tree, keys));
+        CHECK(alive == 99);
+
+        tree.emplace(200);
+        keys.push_back(200);
+        CHECK(holds(tree, keys));
+
+        // a batch this small is merged: 120 goes in, and 150 fails, as it
+        // has to be compared with 200 to be placed
+        poison = {150, 200};
+        check_fails(tree, [](Tree& tree) {
+            std::vector<Alive> batch{Alive{150}, Alive{120}};
+            tree.insert_many(batch.begin(), batch.end());
+        });
+        keys.insert(keys.end() - 1, 120);
+        CHECK(holds(tree, keys));
+        CHECK(alive == 101);
+    }
+    CHECK(alive == 0);
+}
+
+// counts the comparisons; compare makes the search three-way (SEE:
+// bst::custom_three_way)
+size_t comparisons{0};
+
+struct CountingThreeWay {
+    bool operator()(long lhs, long rhs) const noexcept
+    {
+        ++comparisons;
+        return lhs < rhs;
+    }
+
+    std::strong_ordering compare(long lhs, long rhs) const noexcept
+    {
+        ++comparisons;
+        return lhs <=> rhs;
+    }
+};
+
+template <typename Tree>
+void three_way_search()
+{
+    std::vector<long> values;
+    for (long i = 0; i < 1023; ++i) values.push_back(2 * i);
+
+    Tree tree;
+    tree.assign_sorted(values.begin(), values.end());
+
+    // the search stops at the first equal element; for the root that takes
+    // a single comparison
+    comparisons = 0;
+    CHECK(tree.find(*tree.root()) == tree.root());
+    CHECK(comparisons == 1);
+
+    // and never more than one per level
+    for (long key = -1; key <= 2 * 1023; ++key) {
+        comparisons = 0;
+        auto it     = tree.find(key);
+        CHECK(comparisons <= tree.height() + 1);
+        CHECK(key % 2 == 0 && key < 2 * 1023 ? *it == key : it == tree.end());
+    }
+}
+
+// a hint that fits costs a comparison with either neighbour at most, however
+// large the tree; one that is off is searched from (SEE: bst::emplace_hint)
+template <typename Tree>
+void hinted_insert()
+{
+    Tree  tree;
+    Model model;
+
+    // appending, with runs of equivalent values
+    for (long i = 0; i < 3000; ++i) {
+        comparisons = 0;
+        auto it     = tree.emplace_hint(tree.end(), i / 3);
+        CHECK(comparisons <= 2);
+        CHECK(*it == i / 3 && std::next(it) == tree.end());
+        model.insert(i / 3);
+    }
+
+    // descending, each right before the one inserted last
+    auto hint = tree.begin();
+    for (long key = -1; key > -3000; --key) {
+        comparisons = 0;
+        hint        = tree.insert(hint, key);
+        CHECK(comparisons <= 2);
+        CHECK(*hint == key && hint == tree.begin());
+        model.insert(key);
+    }
+
+    check_tree(tree, model);
+
+    // hints that are off
+    KeySource keys{key_range, 21};
+    for (int i = 0; i < 3000; ++i) {
+        long key = keys();
+        auto at  = keys.chance(50) ? tree.begin() : tree.end();
+        auto it  = tree.insert(at, key);
+        CHECK(*it == key);
+        model.insert(key);
+    }
+
+    check_tree(tree, model);
+    check_lookups(tree, model, key_range);
+}
+
+// the order is the comparator's own state; so it has to go along with the
+// elements wherever they go
+struct Ordered {
+    bool descending;
+
+    bool operator()(long lhs, long rhs) const noexcept
+    {
+        return descending ? rhs < lhs : lhs < rhs;
+    }
+};
+
+template <typename Tree>
+bool ordered_by(const Tree& tree, bool descending, size_t size)
+{
+    auto less = [descending](long lhs, long rhs) {
+        return descending ? rhs < lhs : lhs < rhs;
+    };
+
+    return tree.value_comp().descending == descending && tree.size() == size
+           && std::is_sorted(tree.begin(), tree.end(), less);
+}
+
+template <typename Tree>
+void stateful_compare()
+{
+    KeySource keys{key_range};
+
+    Tree down{Ordered{true}};
+    Tree up{Ordered{false}};
+    for (int i = 0; i < 1000; ++i) {
+        down.insert(keys());
+        up.insert(keys());
+    }
+    CHECK(ordered_by(down, true, 1000));
+    CHECK(ordered_by(up, false, 1000));
+
+    Tree copy{down};
+    CHECK(ordered_by(copy, true, 1000));
+
+    Tree moved{std::move(copy)};
+    moved.insert(keys());
+    CHECK(ordered_by(moved, true, 1001));
+
+    std::swap(down, up);
+    down.insert(keys());
+    up.insert(keys());
+    CHECK(ordered_by(down, false, 1001));
+    CHECK(ordered_by(up, true, 1001));
+
+    // assignment brings the comparator of the other tree along
+    moved = down;
+    moved.insert(keys());
+    CHECK(ordered_by(moved, false, 1002));
+
+    moved = std::move(up);
+    moved.insert(keys());
+    CHECK(ordered_by(moved, true, 1002));
+}
+
+// counts how often it is copied and moved
+size_t copies{0};
+size_t moves{0};
+
+struct Tracked {
+    long key;
+
+    explicit Tracked(long key) noexcept
+        : key{key}
+    {
+    }
+
+    Tracked(long key, long scale) noexcept
+        : key{key * scale}
+    {
+    }
+
+    Tracked(const Tracked& that) noexcept
+        : key{that.key}
+    {
+        ++copies;
+    }
+
+    Tracked(Tracked&& that) noexcept
+        : key{that.key}
+    {
+        ++moves;
+    }
+
+    Tracked& operator=(const Tracked& that) noexcept
+    {
+        key = that.key;
+        ++copies;
+        return *this;
+    }
+
+    Tracked& operator=(Tracked&& that) noexcept
+    {
+        key = that.key;
+        ++moves;
+        return *this;
+    }
+
+    friend bool operator<(const Tracked& lhs, const Tracked& rhs) noexcept
+    {
+        return lhs.key < rhs.key;
+    }
+};
+
+// emplace builds the element inside its node; insert copies or moves it
+template <typename Tree>
+void emplace_in_place()
+{
+    Tree tree;
+    copies = 0;
+    moves  = 0;
+
+    for (long i = 0; i < 100; ++i) tree.emplace(i, 2);
+    tree.emplace_hint(tree.end(), 1000);
+    CHECK(copies == 0 && moves == 0);
+
+    Tracked moved{7};
+    tree.insert(std::move(moved));
+    CHECK(copies == 0 && moves == 1);
+
+    Tracked copied{9};
+    tree.insert(copied);
+    CHECK(copies == 1 && moves == 1);
+
+    CHECK(tree.size() == 103);
+    CHECK(std::is_sorted(tree.begin(), tree.end()));
+}
+
+struct PointeeLess {
+    using is_transparent = void;
+
+    bool operator()(const std::unique_ptr<long>& lhs,
+                    const std::unique_ptr<long>& rhs) const noexcept
+    {
+        return *lhs < *rhs;
+    }
+
+    bool operator()(const std::unique_ptr<long>& lhs, long rhs) const noexcept
+    {
+        return *lhs < rhs;
+    }
+
+    bool operator()(long lhs, const std::unique_ptr<long>& rhs) const noexcept
+    {
+        return lhs < *rhs;
+    }
+};
+
+// a tree of a move-only type is moved, never copied
+template <typename Tree>
+void move_only()
+{
+    static_assert(!std::is_copy_constructible_v<Tree>);
+    static_assert(!std::is_copy_assignable_v<Tree>);
+
+    Tree tree;
+    for (long i = 0; i < 100; i += 2) tree.emplace(new long{i});
+    for (long i = 1; i < 100; i += 2) tree.insert(std::make_unique<long>(i));
+    tree.emplace_hint(tree.end(), std::make_unique<long>(100));
+
+    Tree moved{std::move(tree)};
+    CHECK(moved.size() == 101);
+
+    long expected = 0;
+    for (const auto& data : moved) CHECK(*data == expected++);
+
+    moved.erase(moved.find(50L));
+    CHECK(moved.find(50L) == moved.end());
+    CHECK(moved.size() == 100);
+
+    tree = std::move(moved);
+    CHECK(tree.size() == 100 && **tree.begin() == 0);
+}
+
+// a moved-from tree is empty; it can be used and assigned to like any other
+template <typename Tree>
+void assign_after_move()
+{
+    Model model{3, 1, 4, 1, 5};
+    Tree  tree;
+    tree.insert(model.begin(), model.end());
+
+    Tree moved{std::move(tree)};
+    check_tree(tree, Model{});
+    tree.insert(2);
+    check_tree(tree, Model{2});
+
+    tree = moved;
+    check_tree(tree, model);
+    check_tree(moved, model);
+
+    Tree taken{std::move(moved)};
+    moved = std::move(taken);
+    check_tree(moved, model);
+    check_tree(taken, Model{});
+
+    taken = tree;
+    taken.insert(9);
+    model.insert(9);
+    check_tree(taken, model);
+
+    // swapping exchanges the Sentinels; iterators follow their elements
+    Tree other{std::move(tree)};
+    auto first = taken.begin();
+    swap(taken, tree);
+    CHECK(first == tree.begin());
+    check_tree(tree, model);
+    check_tree(taken, Model{});
+
+    taken.swap(other);
+    CHECK(taken.size() == 5 && other.empty());
+
+    // a moved-from tree takes part in the operations of rb_tree like an
+    // empty one
+    if constexpr (requires { Tree::concat(std::move(tree), Tree{}); }) {
+        Tree moved_from{std::move(taken)};
+        Tree joined = Tree::concat(std::move(taken), std::move(tree));
+        check_tree(joined, model);
+
+        Tree right = taken.split(4);
+        check_tree(taken, Model{});
+        check_tree(right, Model{});
+
+        Tree united = Tree::set_union(std::move(right), std::move(joined));
+        check_tree(united, model);
+    }
+}
+
+// the bytes handed out by every CountingAllocator that are still in use
+size_t live_bytes{0};
+size_t allocations{0};
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& /*that*/) noexcept // NOLINT
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        T* data = std::allocator<T>{}.allocate(n);
+        live_bytes += n * sizeof(T);
+        ++allocations;
+        return data;
+    }
+
+    void deallocate(T* data, size_t n) noexcept
+    {
+        live_bytes -= n * sizeof(T);
+        std::allocator<T>{}.deallocate(data, n);
+    }
+
+    friend bool operator==(const CountingAllocator&,
+                           const CountingAllocator&) = default;
+};
+
+using CountedTree = rb_tree<long, std::less<long>, CountingAllocator<long>>;
+
+// erased nodes are reused before a slab is bumped, and clear gives the slabs
+// back all at once
+void slab_reuse()
+{
+    {
+        CountedTree tree;
+        for (long i = 0; i < 1000; ++i) tree.insert(i);
+
+        size_t allocated = allocations;
+        for (long i = 0; i < 1000; ++i) tree.erase(tree.find(i));
+        for (long i = 0; i < 1000; ++i) tree.insert(i);
+        CHECK(allocations == allocated);
+
+        // not even the smallest slab is left
+        tree.clear();
+        CHECK(live_bytes < 32 * sizeof(long));
+
+        tree.insert(1);
+        CHECK(tree.size() == 1);
+    }
+
+    CHECK(live_bytes == 0);
+}
+
+// the parts of a split tree share its slabs; whichever is destroyed last
+// gives them back
+void storage_adoption()
+{
+    {
+        CountedTree right;
+        {
+            CountedTree left;
+            for (long i = 0; i < 1000; ++i) left.insert(i);
+            right = left.split(500);
+        }
+
+        CHECK(live_bytes > 0);
+        CHECK(right.size() == 500 && *right.begin() == 500);
+        right.erase(right.find(500));
+        right.insert(500);
+
+        CountedTree more;
+        for (long i = 1000; i < 2000; ++i) more.insert(i);
+
+        CountedTree joined =
+            CountedTree::join(std::move(right), 1000, std::move(more));
+        CHECK(joined.verify());
+        CHECK(joined.size() == 1501);
+        CHECK(*joined.begin() == 500 && *joined.rbegin() == 1999);
+
+        // the nodes move into one arena; the ones shared are let go of
+        CHECK(joined.arena_count() >= 2);
+        joined.compact();
+        CHECK(joined.arena_count() == 1);
+        CHECK(joined.verify());
+        CHECK(joined.size() == 1501);
+        CHECK(*joined.begin() == 500 && *joined.rbegin() == 1999);
+        CHECK(std::is_sorted(joined.begin(), joined.end()));
+
+        joined.clear();
+        joined.compact();
+        CHECK(joined.arena_count() == 0);
+    }
+
+    CHECK(live_bytes == 0);
+}
+
+} // namespace
+
+int main()
+{
+    churn<bst<long>>(1);
+    churn<RbTree<void>>(2);
+    churn<RbTree<order_statistics>>(11);
+    churn<RbTree<sum_aggregate<long>>>(13);
+
+    sorted_build<bst<long>>(3);
+    sorted_build<RbTree<void>>(4);
+    sorted_build<RbTree<order_statistics>>(12);
+    sorted_build<RbTree<sum_aggregate<long>>>(14);
+
+    batch_insert<bst<long>>(19);
+    batch_insert<RbTree<void>>(20);
+    batch_insert<RbTree<order_statistics>>(21);
+    batch_insert<RbTree<sum_aggregate<long>>>(22);
+
+    deep_scan();
+
+    split_and_join<RbTree<void>>(5);
+    split_and_join<RbTree<order_statistics>>(15);
+    split_and_join<RbTree<sum_aggregate<long>>>(16);
+
+    work_stealing_pool pool{2};
+    set_operations<RbTree<void>>(6, nullptr);
+    set_operations<RbTree<void>>(7, &pool);
+    set_operations<RbTree<order_statistics>>(17, &pool);
+    set_operations<RbTree<sum_aggregate<long>>>(18, &pool);
+
+    parallel_walks<bst<long>>(23, pool);
+    parallel_walks<RbTree<void>>(24, pool);
+    parallel_walks<RbTree<order_statistics>>(25, pool);
+
+    transparent_lookup<bst<Record, ById>>();
+    transparent_lookup<rb_tree<Record, ById>>();
+    batch_order<bst<Record, ById>>();
+    batch_order<rb_tree<Record, ById>>();
+
+    throwing_compare<bst<long, ArmedLess>>();
+    throwing_compare<rb_tree<long, ArmedLess>>();
+    throwing_split<rb_tree<long, ArmedLess>>();
+    throwing_split<
+        rb_tree<long, ArmedLess, std::allocator<long>, order_statistics>>();
+    throwing_update<bst<Alive, PoisonedLess>>();
+    throwing_update<rb_tree<Alive, PoisonedLess>>();
+    throwing_set_operations<rb_tree<Alive, ArmedAliveLess>>(nullptr);
+    throwing_set_operations<rb_tree<Alive, ArmedAliveLess>>(&pool);
+
+    three_way_search<bst<long, CountingThreeWay>>();
+    three_way_search<rb_tree<long, CountingThreeWay>>();
+
+    hinted_insert<bst<long, CountingThreeWay>>();
+    hinted_insert<rb_tree<long, CountingThreeWay>>();
+
+    stateful_compare<bst<long, Ordered>>();
+    stateful_compare<rb_tree<long, Ordered>>();
+
+    emplace_in_place<bst<Tracked>>();
+    emplace_in_place<rb_tree<Tracked>>();
+
+    move_only<bst<std::unique_ptr<long>, PointeeLess>>();
+    move_only<rb_tree<std::unique_ptr<long>, PointeeLess>>();
+
+    assign_after_move<bst<long>>();
+    assign_after_move<RbTree<void>>();
+
+    slab_reuse();
+    storage_adoption();
+
+    return 0;
+}
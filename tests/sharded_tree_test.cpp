@@ -0,0 +1,154 @@
+/* sharded_tree against std::multiset; the keys drift upwards, so the shards
+ * become skewed and are rebalanced along the way
+ *
+ * SEE: stress_test for concurrent updates */
+
+#include "check.h"
+
+#include "sharded_tree.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr long key_range{500};
+
+using Tree = sharded_tree<long, std::less<long>, std::allocator<long>, 8>;
+
+template <typename Tree>
+void check_tree(const Tree& tree, const Model& model)
+{
+    CHECK(tree.size() == model.size());
+
+    std::vector<long> visited;
+    tree.for_each([&visited](long data) { visited.push_back(data); });
+    CHECK(same_elements(visited, model));
+
+    auto view = tree.lock_shared();
+    CHECK(same_elements(view, model));
+}
+
+void churn()
+{
+    Tree      tree;
+    Model     model;
+    KeySource keys{key_range};
+
+    for (long i = 0; i < 100000; ++i) {
+        long key = i / 4 + keys();
+        if (keys.chance(60)) {
+            tree.insert(key);
+            model.insert(key);
+        } else {
+            CHECK(tree.erase(key) == model.erase(key));
+        }
+    }
+
+    check_tree(tree, model);
+
+    for (long key = -1; key <= 100000 / 4 + key_range; key += 7) {
+        CHECK(tree.count(key) == model.count(key));
+        CHECK(tree.contains(key) == (model.count(key) > 0));
+    }
+
+    // rebalanced evenly
+    tree.rebalance();
+    check_tree(tree, model);
+    for (size_t n : tree.shard_sizes()) {
+        CHECK(n <= 2 * model.size() / Tree::shard_count + key_range);
+    }
+
+    // keys all over the range add an arena to every shard each round; so
+    // the storage the shards share is compacted along the way (SEE:
+    // sharded_tree::rebalance)
+    for (int round = 0; round < 8; ++round) {
+        for (long i = 0; i < 200; ++i) {
+            long key = i * 100000 / 4 / 200 + keys();
+            tree.insert(key);
+            model.insert(key);
+        }
+        tree.rebalance();
+        check_tree(tree, model);
+    }
+
+    std::vector<long> batch;
+    for (int i = 0; i < 5000; ++i) batch.push_back(keys());
+    tree.insert(batch.begin(), batch.end());
+    model.insert(batch.begin(), batch.end());
+    check_tree(tree, model);
+
+    tree.clear();
+    CHECK(tree.empty());
+    check_tree(tree, Model{});
+}
+
+void bounds()
+{
+    Tree  tree{std::vector<long>{100, 200, 300}};
+    Model model;
+
+    for (long key = 0; key < 400; ++key) {
+        tree.insert(key);
+        model.insert(key);
+    }
+
+    auto sizes = tree.shard_sizes();
+    CHECK(sizes[0] == 100 && sizes[1] == 100 && sizes[2] == 100);
+    CHECK(sizes[3] == 100 && sizes[4] == 0);
+    check_tree(tree, model);
+}
+
+// if not negative, the comparator throws once this many more calls are made
+long compares_left{-1};
+
+struct ArmedLess {
+    bool operator()(long lhs, long rhs) const
+    {
+        if (compares_left == 0) throw std::runtime_error{"compare"};
+        if (compares_left > 0) --compares_left;
+        return lhs < rhs;
+    }
+};
+
+// a rebalance that throws part of the way loses no element, and every key
+// is still routed to the shard holding it
+void throwing_rebalance()
+{
+    using ArmedTree = sharded_tree<long, ArmedLess, std::allocator<long>, 8>;
+
+    for (long calls = 0; calls < 100; calls += 3) {
+        ArmedTree tree{std::vector<long>{100, 200, 300}};
+        Model     model;
+
+        for (long key = 0; key < 1000; ++key) {
+            tree.insert(key % 400);
+            model.insert(key % 400);
+        }
+
+        compares_left = calls;
+        try {
+            tree.rebalance();
+        } catch (const std::runtime_error&) {
+        }
+        compares_left = -1;
+
+        check_tree(tree, model);
+        for (long key = -1; key <= 400; ++key) {
+            CHECK(tree.count(key) == model.count(key));
+        }
+
+        tree.rebalance();
+        check_tree(tree, model);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    churn();
+    bounds();
+    throwing_rebalance();
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* the concurrent containers under several threads at once
+ *
+ * every writing thread inserts keys of its own and erases most of them again;
+ * the keys of different threads never collide, so the contents at the end
+ * are known and checked against a std::multiset. readers run meanwhile and
+ * check what they see is ordered
+ *
+ * this is built a second time with -fsanitize=thread where the compiler
+ * supports it (SEE: tests/CMakeLists.txt) */
+
+#include "check.h"
+
+#include "concurrent_tree.h"
+#include "flat_combining_tree.h"
+#include "sharded_tree.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t writers{4};
+constexpr std::size_t readers{2};
+constexpr long        ops{20000}; // per writer
+
+// the keys of a writer end in its tag; they drift upwards as it goes
+constexpr long make_key(long i, std::size_t tag) noexcept
+{
+    return i * static_cast<long>(writers) + static_cast<long>(tag);
+}
+
+// every fourth key stays in the tree
+constexpr bool kept(long i) noexcept { return i % 4 == 0; }
+
+Model expected()
+{
+    Model model;
+    for (std::size_t tag = 0; tag < writers; ++tag) {
+        for (long i = 0; i < ops; ++i) {
+            if (kept(i)) model.insert(make_key(i, tag));
+        }
+    }
+    return model;
+}
+
+template <typename Range>
+bool ordered(const Range& range)
+{
+    const long* previous = nullptr;
+    for (const long& data : range) {
+        if (previous != nullptr && data < *previous) return false;
+        previous = &data;
+    }
+    return true;
+}
+
+/* runs write(tag) on every writer thread and read() over and over on every
+ * reader thread until the writers are done */
+void run(const std::function<void(std::size_t)>& write,
+         const std::function<void()>&            read)
+{
+    std::atomic<bool>        done{false};
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < readers; ++i) {
+        // the readers give way between reads; the locks of sharded_tree and
+        // flat_combining_tree may prefer readers, and with fewer cores than
+        // threads back to back reads could keep the writers out for good
+        threads.emplace_back([&done, &read] {
+            while (!done.load(std::memory_order_acquire)) {
+                read();
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<std::thread> writing;
+    for (std::size_t tag = 0; tag < writers; ++tag) {
+        writing.emplace_back(write, tag);
+    }
+
+    for (auto& thread : writing) thread.join();
+    done.store(true, std::memory_order_release);
+    for (auto& thread : threads) thread.join();
+}
+
+void concurrent()
+{
+    concurrent_tree<long> tree;
+
+    run(
+        [&tree](std::size_t tag) {
+            for (long i = 0; i < ops; ++i) {
+                tree.insert(make_key(i, tag));
+                if (i > 0 && !kept(i - 1)) {
+                    CHECK(tree.erase(make_key(i - 1, tag)) == 1);
+                }
+            }
+            if (!kept(ops - 1)) tree.erase(make_key(ops - 1, tag));
+        },
+        [&tree] {
+            auto reader = tree.make_reader();
+            for (int i = 0; i < 100; ++i) {
+                auto guard = reader.read();
+                CHECK(ordered(guard));
+            }
+        });
+
+    CHECK(same_elements(tree.snapshot(), expected()));
+}
+
+void sharded()
+{
+    sharded_tree<long, std::less<long>, std::allocator<long>, 8> tree;
+
+    run(
+        [&tree](std::size_t tag) {
+            for (long i = 0; i < ops; ++i) {
+                tree.insert(make_key(i, tag));
+                if (i > 0 && !kept(i - 1)) {
+                    CHECK(tree.erase(make_key(i - 1, tag)) == 1);
+                }
+            }
+            if (!kept(ops - 1)) tree.erase(make_key(ops - 1, tag));
+        },
+        [&tree] {
+            std::vector<long> visited;
+            tree.for_each([&visited](long data) { visited.push_back(data); });
+            CHECK(ordered(visited));
+            CHECK(ordered(tree.lock_shared()));
+            (void)tree.count(make_key(ops / 2, 0));
+        });
+
+    CHECK(same_elements(tree.lock_shared(), expected()));
+}
+
+void flat_combining()
+{
+    flat_combining_tree<long> tree;
+
+    run(
+        [&tree](std::size_t tag) {
+            auto writer = tree.make_writer();
+            for (long i = 0; i < ops; ++i) {
+                writer.insert(make_key(i, tag));
+                if (i > 0 && !kept(i - 1)) {
+                    CHECK(writer.erase(make_key(i - 1, tag)) == 1);
+                }
+            }
+            if (!kept(ops - 1)) writer.erase(make_key(ops - 1, tag));
+        },
+        [&tree] {
+            tree.read([](const auto& contents) { CHECK(ordered(contents)); });
+            (void)tree.size();
+        });
+
+    tree.read([](const auto& contents) {
+        CHECK(same_elements(contents, expected()));
+    });
+}
+
+} // namespace
+
+int main()
+{
+    concurrent();
+    sharded();
+    flat_combining();
+    return 0;
+}